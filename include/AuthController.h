@@ -2,7 +2,6 @@
 #define AUTHCONTROLLER_H
 
 #include <QObject>
-#include <QTimer>
 #include <memory>
 #include "NetworkManager.h"
 #include "Message.h"
@@ -11,6 +10,8 @@
  * @brief 认证控制器
  * 处理登录、注册、验证码等认证相关功能
  * 与NetworkManager协作，提供高级的认证API
+ * 每个操作通过NetworkManager::request()发出，按reqId匹配响应，多个操作可以同时进行
+ * 登录响应带有会话令牌时，断线自动重连期间保持登录状态，由NetworkManager恢复会话
  */
 class AuthController : public QObject
 {
@@ -65,6 +66,8 @@ signals:
     
     // 用户状态信号
     void userLoggedIn(const QString &userId);
+    void sessionResumed();
+    void sessionExpired(const QString &reason);
     
     // 连接状态信号
     void connected();
@@ -76,10 +79,8 @@ private slots:
     void onNetworkConnected();
     void onNetworkDisconnected();
     void onNetworkError(const QString &error);
-    void onMessageReceived(const Message *message);
-    
-    // 超时处理
-    void onOperationTimeout();
+    void onSessionResumed();
+    void onSessionResumeFailed(const QString &reason);
 
 private:
     // 网络管理器
@@ -91,27 +92,14 @@ private:
     QString m_currentUserId;
     QString m_currentUsername;
     
-    // 操作状态
-    enum class PendingOperation {
-        None,
-        Login,
-        Logout,
-        Register,
-        VerifyCode
-    };
-    PendingOperation m_pendingOperation;
-    std::unique_ptr<QTimer> m_operationTimer;
+    static constexpr int kOperationTimeoutMs = 10000;
     
     // 私有方法
-    void initializeComponents();
-    void handleLoginResponse(const Message *message);
-    void handleLogoutResponse(const Message *message);
-    void handleRegisterResponse(const Message *message);
-    void handleVerifyCodeResponse(const Message *message);
+    void handleLoginResponse(const NetMessage &message);
+    void handleLogoutResponse(const NetMessage &message);
+    void handleRegisterResponse(const NetMessage &message);
+    void handleVerifyCodeResponse(const NetMessage &message);
     void resetUserState();
-    void startOperationTimer(int timeoutMs = 10000); // 默认10秒超时
-    void stopOperationTimer();
-    void setPendingOperation(PendingOperation operation);
 };
 
 #endif // AUTHCONTROLLER_H
\ No newline at end of file
@@ -5,13 +5,40 @@
 #include <QJsonArray>
 #include <QJsonDocument>
 #include <QString>
+#include <QHash>
+#include <QTimer>
 #include <QVariantList>
 #include <QVariantMap>
 #include <qqml.h>
+#include <memory>
+#include "NetMessage.h"
+#include "MessageListModel.h"
+#include "ContactListModel.h"
+#include "UserDirectoryCache.h"
 
 class NetworkManager;
-class Message;
 class ChatHistoryManager;
+class MessageDispatcher;
+struct ChatRecord;
+struct LoginResponsePayload;
+struct ErrorPayload;
+struct PrivateChatPayload;
+struct GroupChatPayload;
+struct AddFriendResponsePayload;
+struct FriendRequestPayload;
+struct FriendAcceptedPayload;
+struct FriendRejectedPayload;
+struct FriendListPayload;
+struct UserListPayload;
+struct GroupListPayload;
+struct GroupCreatedPayload;
+struct GroupJoinedPayload;
+struct GroupLeftPayload;
+struct GroupMembersPayload;
+struct ChatHistoryPayload;
+struct MessageRecalledPayload;
+struct MessageReadPayload;
+struct ListSyncInfo;
 
 /**
  * @brief 聊天控制器类
@@ -25,6 +52,12 @@ class ChatController : public QObject
     Q_PROPERTY(QVariantList friendsList READ friendsList NOTIFY friendsListChanged)
     Q_PROPERTY(QVariantList groupsList READ groupsList NOTIFY groupsListChanged)
     Q_PROPERTY(QVariantList usersList READ usersList NOTIFY usersListChanged)
+    Q_PROPERTY(MessageListModel* messageModel READ messageModel CONSTANT)
+    Q_PROPERTY(ContactListModel* friendsModel READ friendsModel CONSTANT)
+    Q_PROPERTY(ContactListModel* groupsModel READ groupsModel CONSTANT)
+    Q_PROPERTY(ContactListModel* usersModel READ usersModel CONSTANT)
+    Q_PROPERTY(ContactListModel* userSearchModel READ userSearchModel CONSTANT)
+    Q_PROPERTY(QString userSearchCursor READ userSearchCursor NOTIFY userSearchResultsChanged)
 
 public:
     explicit ChatController(QObject *parent = nullptr);
@@ -33,9 +66,15 @@ public:
     void setChatHistoryManager(ChatHistoryManager *manager);
     
     bool isConnected() const;
-    QVariantList friendsList() const { return m_friendsList; }
-    QVariantList groupsList() const { return m_groupsList; }
-    QVariantList usersList() const { return m_usersList; }
+    QVariantList friendsList() const { return m_friendsModel->contacts(); }
+    QVariantList groupsList() const { return m_groupsModel->contacts(); }
+    QVariantList usersList() const { return m_usersModel->contacts(); }
+    ContactListModel *friendsModel() const { return m_friendsModel; }
+    ContactListModel *groupsModel() const { return m_groupsModel; }
+    ContactListModel *usersModel() const { return m_usersModel; }
+    ContactListModel *userSearchModel() const { return m_userSearchModel; }
+    QString userSearchCursor() const { return m_userSearchCursor; }
+    MessageListModel *messageModel() const { return m_messageModel; }
 
 public slots:
     // 消息发送
@@ -48,6 +87,8 @@ public slots:
     void acceptFriendRequest(const QString &fromUserId);
     void rejectFriendRequest(const QString &fromUserId);
     void getFriendRequests();
+    // 在线状态变化，只更新对应的一行
+    void setUserOnline(const QString &userId, bool online);
     
     // 群组管理
     void getGroupsList();
@@ -55,12 +96,21 @@ public slots:
     void joinGroup(const QString &groupId);
     void leaveGroup(const QString &groupId);
     void getGroupMembers(const QString &groupId);
+    // 并行请求所有已加入群的成员列表
+    void prefetchGroupMembers();
     
-    // 用户列表
+    // 用户列表(完整列表，用户量大时应使用searchUsers)
     void getUsersList();
+    // 按用户名前缀分页搜索，cursor为空时从头开始，结果写入userSearchModel
+    // 传入userSearchCursor继续读取下一页
+    void searchUsers(const QString &prefix, int limit = 50, const QString &cursor = QString());
       // 聊天历史
+    // 切换messageModel显示的会话，之后本地历史和新消息直接写入模型
+    void openChat(const QString &type, const QString &targetId);
     void getChatHistory(const QString &type, const QString &targetId, int count = 20);
     void loadLocalChatHistory(const QString &type, const QString &targetId, int count = 50);
+    void loadOlderChatHistory(const QString &type, const QString &targetId,
+                              const QString &beforeMessageId, int count = 50);
     void clearChatHistory(const QString &type, const QString &targetId);
       // 离线消息处理
     void processOfflineMessages();
@@ -101,9 +151,12 @@ signals:
     
     // 用户列表信号
     void usersListChanged();
+    void userSearchResultsChanged(const QString &prefix);
       // 聊天历史信号
     void chatHistoryReceived(const QString &type, const QString &targetId, const QVariantList &messages);
-    void localChatHistoryLoaded(const QString &type, const QString &targetId, const QVariantList &messages);
+    // 记录已写入messageModel，只通知数量
+    void localChatHistoryLoaded(const QString &type, const QString &targetId, int count);
+    void olderChatHistoryLoaded(const QString &type, const QString &targetId, int count, bool hasMore);
     void offlineMessagesProcessed(int count);
     
     // 消息状态信号
@@ -114,19 +167,65 @@ signals:
     void errorOccurred(const QString &error);
 
 private slots:
-    void handleNetworkMessage(const Message *message);
     void handleNetworkConnected();
     void handleNetworkDisconnected();
 
 private:
-    void parseMessage(int messageType, const QVariantMap &data);
+    // 服务器推送处理，由NetworkManager的分发表按消息类型调用
+    void subscribeMessages(MessageDispatcher &dispatcher);
+    void handleLoginResponse(const LoginResponsePayload &payload);
+    void handleError(const ErrorPayload &payload);
+    void handlePrivateChat(const PrivateChatPayload &payload);
+    void handleGroupChat(const GroupChatPayload &payload);
+    void handleAddFriendResponse(const AddFriendResponsePayload &payload);
+    void handleFriendRequest(const FriendRequestPayload &payload);
+    void handleFriendAccepted(const FriendAcceptedPayload &payload);
+    void handleFriendRejected(const FriendRejectedPayload &payload);
+    void handleFriendList(const FriendListPayload &payload);
+    void handleGroupList(const GroupListPayload &payload);
+    void handleGroupCreated(const GroupCreatedPayload &payload);
+    void handleGroupJoined(const GroupJoinedPayload &payload);
+    void handleGroupLeft(const GroupLeftPayload &payload);
+    void handleGroupMembers(const GroupMembersPayload &payload);
+    void handleUserList(const UserListPayload &payload);
+    void handleChatHistory(const ChatHistoryPayload &payload);
+    void handleMessageRecalled(const MessageRecalledPayload &payload);
+    void handleMessageRead(const MessageReadPayload &payload);
+    
     QVariantMap parseMessageContent(const QString &content);
+    // 列表增量同步，listName为"friends"、"groups"、"users"
+    void requestList(MessageType type, const QString &listName);
+    void applyListSync(const QString &listName, ContactListModel *model,
+                       const QVariantList &items, const ListSyncInfo &sync);
+    void loadSavedContactLists();
+    QVariantList withUnreadCounts(const QVariantList &friends) const;
+    void updateUnreadCount(const QString &chatId, bool isGroup, int unreadCount);
+    void refreshUnreadCounts();
+    void saveDirtyContactLists();
+    void emitListChanged(const QString &listName);
+    void showUserSearchResults(const QString &prefix, const QVariantList &users,
+                               const QString &nextCursor, bool append);
     void initializeChatHistory(const QString &userId);
+    QString nextLocalMessageId(qint64 timestamp);
     
     NetworkManager *m_networkManager;
     ChatHistoryManager *m_chatHistoryManager;
     QString m_currentUserId; // 当前用户ID
-    QVariantList m_friendsList;
-    QVariantList m_groupsList;
-    QVariantList m_usersList;
+    MessageListModel *m_messageModel;
+    // 列表更新时按key比较，只通知变化的行
+    ContactListModel *m_friendsModel;
+    ContactListModel *m_groupsModel;
+    ContactListModel *m_usersModel;
+    QHash<QString, qint64> m_listRevisions; // 各列表最后同步的版本号
+    // 等待保存的列表，定时器到期后一次写入
+    QHash<QString, ContactListModel *> m_dirtyLists;
+    std::unique_ptr<QTimer> m_listSaveTimer;
+    static constexpr int kListSaveDelayMs = 2000;
+
+    // 用户目录搜索，本地缓存已见过的用户，完整返回过的前缀不再请求服务器
+    ContactListModel *m_userSearchModel;
+    UserDirectoryCache m_userDirectory;
+    QString m_userSearchPrefix;
+    QString m_userSearchCursor;     // 服务器游标，或"@"开头的本地排序键
+    quint32 m_localMessageSeq;      // 本地消息ID的序号部分
 };
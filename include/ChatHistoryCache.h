@@ -0,0 +1,72 @@
+#ifndef CHATHISTORYCACHE_H
+#define CHATHISTORYCACHE_H
+
+#include <QString>
+#include <QList>
+#include <QHash>
+#include <list>
+#include "ChatLogStore.h"
+
+/**
+ * @brief 最近会话消息窗口的LRU缓存
+ * 为最近使用的会话保留最新的若干条消息，总内存受预算限制，
+ * 超出预算时淘汰最久未使用的会话
+ * 只在ChatHistoryManager所在的界面线程中使用，不做加锁
+ */
+class ChatHistoryCache
+{
+public:
+    explicit ChatHistoryCache(int windowSize = 200, qint64 memoryBudget = 8 * 1024 * 1024);
+
+    // 配置
+    void setLimits(int windowSize, qint64 memoryBudget);
+    int windowSize() const { return m_windowSize; }
+    qint64 memoryBudget() const { return m_memoryBudget; }
+
+    // 查询最近count条(从末尾跳过offset条)，缓存能完整满足时返回true
+    bool lookup(const QString &chatKey, int count, int offset, QList<ChatRecord> *records);
+
+    // 查询游标之前的一页，游标不在窗口中或窗口不够时返回false
+    bool lookupPage(const QString &chatKey, const HistoryCursor &cursor, int count, HistoryPage *page);
+
+    // 从磁盘读到会话末尾的一页后放入缓存，complete表示已包含会话的全部历史
+    void store(const QString &chatKey, const QList<ChatRecord> &records, bool complete);
+
+    // 保存路径同步更新已缓存的会话
+    void append(const QString &chatKey, const ChatRecord &record);
+    void updateFlags(const QString &chatKey, const QString &messageId, quint8 flags);
+
+    // 失效
+    void remove(const QString &chatKey);
+    void clear();
+
+    // 统计
+    quint64 hitCount() const { return m_hits; }
+    quint64 missCount() const { return m_misses; }
+    int chatCount() const { return m_entries.size(); }
+    qint64 memoryUsage() const { return m_memoryUsage; }
+
+private:
+    struct Entry {
+        QList<ChatRecord> records;      // 按时间顺序的最新消息窗口
+        bool complete = false;          // 窗口是否从会话第一条消息开始
+        qint64 bytes = 0;
+        std::list<QString>::iterator lruPosition;
+    };
+
+    int m_windowSize;
+    qint64 m_memoryBudget;
+    qint64 m_memoryUsage;
+    quint64 m_hits;
+    quint64 m_misses;
+
+    QHash<QString, Entry> m_entries;
+    std::list<QString> m_lru;           // 表头为最近使用的会话
+
+    void touch(Entry &entry);
+    void trimWindow(Entry &entry);
+    void evictOverBudget();
+    static qint64 recordBytes(const ChatRecord &record);
+};
+
+#endif // CHATHISTORYCACHE_H
@@ -8,13 +8,25 @@
 #include <QDir>
 #include <QStandardPaths>
 #include <QDateTime>
+#include <QThread>
+#include <QFuture>
+#include <QTimer>
 #include <memory>
 #include "Message.h"
+#include "ChatLogStore.h"
+#include "ChatHistoryCache.h"
+#include "RecentChatsIndex.h"
+
+class ChatHistoryWorker;
 
 /**
  * @brief 聊天历史管理器
- * 负责聊天记录的本地JSON文件存储和读取
+ * 负责聊天记录的本地存储和读取，消息写入追加式分段日志(ChatLogStore)
  * 支持私聊和群聊记录的分别管理
+ * 所有磁盘I/O都在专用工作线程(ChatHistoryWorker)中执行，写入为异步排队，
+ * 读取通过fetch*系列方法返回QFuture
+ * 最近使用会话的最新消息保存在LRU缓存中，命中时不访问磁盘
+ * 最近聊天列表和未读数在内存中增量维护，变化后延迟批量写入磁盘
  */
 class ChatHistoryManager : public QObject
 {
@@ -30,31 +42,65 @@ public:
     void setCurrentUserId(const QString &userId);
     Q_INVOKABLE QString getCurrentUserId() const { return m_currentUserId; }
 
+    // 异步读取，结果在工作线程读取完成后通过QFuture返回
+    QFuture<QList<ChatRecord>> fetchPrivateMessages(const QString &otherUserId, int count = 50, int offset = 0);
+    QFuture<QList<ChatRecord>> fetchGroupMessages(const QString &groupId, int count = 50, int offset = 0);
+    // 游标分页，从cursor指向的消息向前读取一页，空游标读取最新一页
+    QFuture<HistoryPage> fetchPrivatePage(const QString &otherUserId, const HistoryCursor &cursor, int count = 50);
+    QFuture<HistoryPage> fetchGroupPage(const QString &groupId, const HistoryCursor &cursor, int count = 50);
+    QFuture<QVariantList> fetchSearchResults(const QString &query, int limit = 50);
+    QFuture<QJsonArray> fetchOfflineMessages();
+    QFuture<QJsonArray> fetchRecentChats(int count = 20);
+    // 联系人列表快照，格式为{revision, items}，没有保存过时为空对象
+    QFuture<QJsonObject> fetchContactList(const QString &listName);
+    void saveContactList(const QString &listName, const QJsonObject &list);
+
+    // 未读计数
+    Q_INVOKABLE int unreadCount(const QString &chatId, bool isGroup = false) const;
+    Q_INVOKABLE int totalUnreadCount() const { return m_recentChats.totalUnreadCount(); }
+    Q_INVOKABLE void markChatAsRead(const QString &chatId, bool isGroup = false);
+
+    // 全文搜索所有会话，结果通过searchResultsReady返回
+    // 空格分隔的词须同时出现，"..."为短语，词*为前缀
+    Q_INVOKABLE void searchMessages(const QString &query, int limit = 50);
+
+    // 消息窗口缓存
+    Q_INVOKABLE void setCacheLimits(int windowSize, qint64 memoryBudgetBytes);
+    Q_INVOKABLE QVariantMap cacheStatistics() const;
+    quint64 cacheHitCount() const { return m_cache.hitCount(); }
+    quint64 cacheMissCount() const { return m_cache.missCount(); }
+
+    // 存储格式，"binary"(默认)或"json"，只影响之后新建的分段
+    Q_INVOKABLE bool setStorageFormat(const QString &format);
+    Q_INVOKABLE QString storageFormat() const;
+    // 将已有历史全部转换为指定格式，完成后发出historyConverted
+    Q_INVOKABLE bool convertHistory(const QString &format);
+
 public slots:
     // 消息存储
-    void savePrivateMessage(const QString &fromUserId, const QString &toUserId, 
+    void savePrivateMessage(const QString &fromUserId, const QString &toUserId,
                           const QString &content, const QString &messageId = "",
                           qint64 timestamp = 0);
     void saveGroupMessage(const QString &groupId, const QString &fromUserId,
                          const QString &content, const QString &messageId = "",
                          qint64 timestamp = 0);
-    
-    // 消息读取
+
+    // 消息读取（同步版本，会阻塞调用线程直到读取完成，界面代码应使用fetch*）
     QJsonArray getPrivateMessages(const QString &otherUserId, int count = 50, int offset = 0);
     QJsonArray getGroupMessages(const QString &groupId, int count = 50, int offset = 0);
-    
+
     // 消息操作
     void markMessageAsRead(const QString &messageId, const QString &chatId, bool isGroup = false);
     void recallMessage(const QString &messageId, const QString &chatId, bool isGroup = false);
-    
+
     // 离线消息处理
     void saveOfflineMessage(const QJsonObject &messageData);
     QJsonArray getOfflineMessages();
     void clearOfflineMessages();
-    
+
     // 获取聊天列表
     QJsonArray getRecentChats(int count = 20);
-    
+
     // 清理操作
     void clearChatHistory(const QString &chatId, bool isGroup = false);
     void clearAllHistory();
@@ -63,30 +109,61 @@ signals:
     void messagesSaved();
     void messagesLoaded(const QJsonArray &messages);
     void offlineMessagesAvailable(int count);
+    void historyConverted(int chatCount);
+    void searchResultsReady(const QString &query, const QVariantList &results);
+
+    // 最近聊天列表
+    void recentChatUpdated(const QString &chatId, bool isGroup, const QString &lastMessage, int unreadCount);
+    void unreadCountChanged(const QString &chatId, bool isGroup, int unreadCount);
+    void recentChatsChanged();
 
 private:
     QString m_currentUserId;
     QString m_dataDir;
     QString m_userDataDir;
-    
+
+    // 工作线程
+    QThread m_workerThread;
+    ChatHistoryWorker *m_worker;
+
+    // 消息窗口缓存，以及用于丢弃过期读取结果的会话版本号
+    ChatHistoryCache m_cache;
+    QHash<QString, quint64> m_chatVersions;
+    quint64 m_cacheGeneration;
+    ChatLogStore::RecordFormat m_storageFormat;
+
+    // 最近聊天列表，修改后在m_recentChatsTimer到期时写入磁盘
+    RecentChatsIndex m_recentChats;
+    QTimer m_recentChatsTimer;
+    bool m_recentChatsDirty;
+
+    static constexpr int kRecentChatsFlushMs = 2000;
+
     // 文件路径管理
-    QString getPrivateChatFilePath(const QString &otherUserId) const;
-    QString getGroupChatFilePath(const QString &groupId) const;
-    QString getOfflineMessagesFilePath() const;
-    QString getRecentChatsFilePath() const;
-    
-    // JSON文件操作
-    QJsonArray loadJsonArray(const QString &filePath) const;
-    bool saveJsonArray(const QString &filePath, const QJsonArray &array);
-    QJsonObject loadJsonObject(const QString &filePath) const;
-    bool saveJsonObject(const QString &filePath, const QJsonObject &object);
-    
+    QString getPrivateChatKey(const QString &otherUserId) const;
+    QString getGroupChatKey(const QString &groupId) const;
+
+    // 消息读取
+    QFuture<QList<ChatRecord>> fetchMessages(const QString &chatKey, int count, int offset);
+    QFuture<HistoryPage> fetchPage(const QString &chatKey, const HistoryCursor &cursor, int count);
+    QList<ChatRecord> readMessagesBlocking(const QString &chatKey, int count, int offset);
+    void bumpChatVersion(const QString &chatKey);
+    void touchRecentChat(const QString &chatId, bool isGroup, const ChatRecord &record);
+    void scheduleRecentChatsFlush();
+    void flushRecentChats();
+    static bool parseStorageFormat(const QString &format, ChatLogStore::RecordFormat *result);
+
     // 消息处理
-    QJsonObject createMessageObject(const QString &fromUserId, const QString &content,
-                                  const QString &messageId, qint64 timestamp) const;
-    void updateRecentChats(const QString &chatId, const QString &chatName, 
-                          const QString &lastMessage, bool isGroup = false);
-    
+    ChatRecord createMessageRecord(const QString &fromUserId, const QString &content,
+                                   const QString &messageId, qint64 timestamp) const;
+    QJsonArray recordsToJsonArray(const QList<ChatRecord> &records) const;
+
+    // 在工作线程中执行操作
+    template <typename Function>
+    void postToWorker(Function function);
+    template <typename T, typename Function>
+    QFuture<T> runOnWorker(Function function);
+
     // 文件系统操作
     bool ensureDirectoryExists(const QString &dirPath);
     void initializeDataDirectory();
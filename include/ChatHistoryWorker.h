@@ -0,0 +1,126 @@
+#ifndef CHATHISTORYWORKER_H
+#define CHATHISTORYWORKER_H
+
+#include <QObject>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QHash>
+#include <QVariantList>
+#include <QTimer>
+#include <memory>
+#include "ChatLogStore.h"
+#include "ChatJournal.h"
+#include "ChatSearchIndex.h"
+
+/**
+ * @brief 聊天历史后台工作对象
+ * 运行在ChatHistoryManager的专用线程中，负责全部磁盘I/O
+ * 短时间内对同一会话的多次追加会合并为一次写入
+ * 追加的消息先写入预写日志，再按组提交间隔统一同步到磁盘，
+ * 初始化时清理中断的写入并重放预写日志
+ * 写入的消息同时加入全文索引(ChatSearchIndex)
+ * 除构造函数外，所有方法都只能在工作线程中调用
+ */
+class ChatHistoryWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ChatHistoryWorker(QObject *parent = nullptr);
+    ~ChatHistoryWorker();
+
+    // 初始化用户数据目录并迁移旧数据，返回离线消息数量，失败返回-1
+    int initialize(const QString &userDataDir);
+
+    // 消息存储
+    void appendRecord(const QString &chatKey, const QString &chatId, const ChatRecord &record);
+
+    // 消息读取
+    QList<ChatRecord> readMessages(const QString &chatKey, int count, int offset);
+    HistoryPage readPage(const QString &chatKey, const HistoryCursor &cursor, int count);
+
+    // 全文搜索，返回按时间从新到旧排列的消息
+    QVariantList searchMessages(const QString &query, int limit);
+
+    // 消息操作
+    bool markMessageAsRead(const QString &chatKey, const QString &messageId);
+    bool recallMessage(const QString &chatKey, const QString &messageId);
+
+    // 离线消息处理
+    void saveOfflineMessage(const QJsonObject &messageData);
+    QJsonArray loadOfflineMessages();
+    void clearOfflineMessages();
+
+    // 最近聊天，列表本身由ChatHistoryManager在内存中维护，这里只负责读写文件
+    QJsonArray loadRecentChats();
+    void saveRecentChats(const QJsonArray &chats);
+
+    // 联系人列表快照{revision, items}，用于启动时直接显示和增量同步
+    QJsonObject loadContactList(const QString &listName);
+    void saveContactList(const QString &listName, const QJsonObject &list);
+
+    // 清理操作
+    void clearChatHistory(const QString &chatKey);
+    void clearAllHistory();
+
+    // 记录格式
+    void setRecordFormat(ChatLogStore::RecordFormat format);
+    int convertHistory(ChatLogStore::RecordFormat format);
+
+public slots:
+    // 将合并队列中的追加写入磁盘
+    void flushPendingWrites();
+
+    // 组提交：写入合并队列并同步到磁盘，之后清空预写日志
+    void commitPendingWrites();
+
+signals:
+    void recordsFlushed(int count);
+
+private:
+    struct PendingChat {
+        QString chatId;
+        bool isGroup = false;
+        QList<ChatRecord> records;
+    };
+
+    QString m_userDataDir;
+    std::unique_ptr<ChatLogStore> m_logStore;
+    std::unique_ptr<QTimer> m_flushTimer;
+    std::unique_ptr<QTimer> m_commitTimer;
+    QHash<QString, PendingChat> m_pendingWrites;
+    ChatJournal m_journal;
+    std::unique_ptr<ChatSearchIndex> m_searchIndex;
+    bool m_writeFailed;                         // 有写入失败、等待重试的消息，期间保留预写日志
+
+    static constexpr int kWriteCoalesceMs = 50; // 追加合并窗口
+    static constexpr int kGroupCommitMs = 500;  // 组提交间隔
+    static constexpr int kIndexBatchSize = 1000; // 补建索引时每批读取的记录数
+
+    // 文件路径管理
+    QString getOfflineMessagesFilePath() const;
+    QString getRecentChatsFilePath() const;
+    QString getContactListFilePath(const QString &listName) const;
+    QString getJournalFilePath() const;
+
+    // JSON文件操作
+    QJsonArray loadJsonArray(const QString &filePath) const;
+    bool saveJsonArray(const QString &filePath, const QJsonArray &array);
+    QJsonObject loadJsonObject(const QString &filePath) const;
+    bool saveJsonObject(const QString &filePath, const QJsonObject &object);
+    static bool writeFileAtomically(const QString &filePath, const QByteArray &data);
+    static void preserveCorruptFile(const QString &filePath);
+
+    // 消息处理
+    void queueRecord(const QString &chatKey, const QString &chatId, const ChatRecord &record);
+    void scheduleCommit();
+    void replayJournal();
+    void indexBacklog();
+
+    // 文件系统操作
+    bool ensureDirectoryExists(const QString &dirPath);
+    void migrateLegacyHistory();
+};
+
+#endif // CHATHISTORYWORKER_H
@@ -0,0 +1,46 @@
+#ifndef CHATJOURNAL_H
+#define CHATJOURNAL_H
+
+#include <QString>
+#include <QList>
+#include <QFile>
+#include "ChatLogStore.h"
+
+/**
+ * @brief 聊天记录预写日志
+ * 消息进入合并队列时先追加到journal.wal，写入分段日志并同步到磁盘后再清空，
+ * 程序在合并窗口内崩溃时，下次初始化可以从日志中重放尚未写入的消息
+ * 每个条目为4字节长度 + 2字节校验 + JSON负载，末尾写了一半的条目在打开时丢弃
+ */
+class ChatJournal
+{
+public:
+    struct Entry {
+        QString chatKey;
+        QString chatId;
+        ChatRecord record;
+    };
+
+    ChatJournal() = default;
+    ~ChatJournal();
+
+    // 打开日志文件，返回其中完整的条目用于重放
+    QList<Entry> open(const QString &filePath);
+    void close();
+    bool isOpen() const { return m_file.isOpen(); }
+
+    // 追加条目，只写入系统缓存，由每次组提交调用sync()批量同步到磁盘
+    bool append(const QString &chatKey, const QString &chatId, const ChatRecord &record);
+    bool sync();
+
+    // 条目都已持久化到分段日志后清空
+    bool reset();
+
+    bool isEmpty() const { return m_entryCount == 0; }
+
+private:
+    QFile m_file;
+    int m_entryCount = 0;
+};
+
+#endif // CHATJOURNAL_H
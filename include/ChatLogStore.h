@@ -0,0 +1,168 @@
+#ifndef CHATLOGSTORE_H
+#define CHATLOGSTORE_H
+
+#include <QString>
+#include <QList>
+#include <QHash>
+#include <QFile>
+#include <QJsonObject>
+#include <memory>
+
+/**
+ * @brief 聊天记录条目
+ * 存储层使用的单条消息，可与原有的JSON消息对象互相转换
+ */
+struct ChatRecord
+{
+    QString messageId;
+    QString fromUserId;
+    QString targetId;       // 私聊为toUserId，群聊为groupId
+    QString content;
+    qint64 timestamp = 0;
+    bool isGroup = false;
+    bool isRead = false;
+    bool recalled = false;
+
+    QJsonObject toJson() const;
+    static ChatRecord fromJson(const QJsonObject &object);
+};
+
+/**
+ * @brief 历史分页游标
+ * 指向一条消息，分页时读取该消息之前(不含)的记录
+ * messageId为空时按timestamp定位，两者都为空表示从最新消息开始
+ */
+struct HistoryCursor
+{
+    QString messageId;
+    qint64 timestamp = 0;
+
+    bool isNull() const { return messageId.isEmpty() && timestamp <= 0; }
+};
+
+/**
+ * @brief 一页历史记录
+ */
+struct HistoryPage
+{
+    QList<ChatRecord> records;  // 按时间顺序
+    HistoryCursor nextCursor;   // 本页最早一条，用于继续向前翻页
+    bool hasMore = false;       // 游标之前是否还有更早的记录
+};
+
+/**
+ * @brief 追加式分段日志存储
+ * 每个会话对应一个目录，消息按顺序追加到滚动的分段文件(seg_XXXXXX.log)中，
+ * 定长的记录索引(records.idx)保存每条消息所在的分段和偏移，
+ * 因此追加消息为O(1)，读取最近一页只需读取该页涉及的记录
+ * 消息ID索引(ids.idx)记录messageId到记录序号的映射，已读/撤回状态
+ * 以增量形式追加到flags.log，读取时再合并，修改状态无需重写历史
+ * 记录格式记录在每个分段的文件头中，可选JSON或紧凑二进制格式，
+ * 新分段使用当前设置的格式，旧分段保持原格式可继续读取
+ * 写入只进入系统缓存，由sync()按组提交的方式统一同步到磁盘；
+ * 打开会话时丢弃指向不完整数据的索引项和未被索引的分段尾部
+ * 读取时分段文件以内存映射方式访问，记录直接从映射区域解码，
+ * 常驻内存只与实际访问的页有关，与历史长度无关
+ */
+class ChatLogStore
+{
+public:
+    // 分段中的记录格式
+    enum class RecordFormat : quint8 {
+        Json = 0,       // 紧凑JSON文本
+        Binary = 1      // varint长度、会话内用户ID字典、标志字节和CRC32校验
+    };
+
+    explicit ChatLogStore(const QString &rootDir = QString());
+    ~ChatLogStore();
+
+    void setRootDir(const QString &rootDir);
+    QString rootDir() const { return m_rootDir; }
+
+    void setRecordFormat(RecordFormat format) { m_recordFormat = format; }
+    RecordFormat recordFormat() const { return m_recordFormat; }
+
+    // 追加记录
+    bool append(const QString &chatKey, const ChatRecord &record);
+    bool append(const QString &chatKey, const QList<ChatRecord> &records);
+
+    // 读取记录，offset为从末尾跳过的条数
+    QList<ChatRecord> readTail(const QString &chatKey, int count, int offset = 0);
+    QList<ChatRecord> readAll(const QString &chatKey);
+    // 读取记录序号在[start, end)内的记录
+    QList<ChatRecord> readRecords(const QString &chatKey, qint64 start, qint64 end);
+    quint32 recordCount(const QString &chatKey);
+
+    // 从游标处向前读取一页，只读取和解码该页的记录，与翻到第几页无关
+    HistoryPage readPage(const QString &chatKey, const HistoryCursor &cursor, int count);
+
+    // 按消息ID查找记录序号，未找到返回-1
+    qint64 findRecord(const QString &chatKey, const QString &messageId);
+
+    // 为指定消息追加状态标志，未找到消息返回false
+    bool updateFlags(const QString &chatKey, const QString &messageId, quint8 flags);
+
+    // 会话管理
+    bool exists(const QString &chatKey) const;
+    bool replace(const QString &chatKey, const QList<ChatRecord> &records);
+    void clear(const QString &chatKey);
+    void closeAll();
+
+    // 将会话的全部记录转换为指定格式重写，同时合并状态增量
+    bool convert(const QString &chatKey, RecordFormat format);
+
+    // 将有写入的会话同步到磁盘，先数据后索引
+    bool sync();
+
+    // 清理被中断的格式转换留下的临时目录
+    void recover();
+
+    // 将文件内容同步到磁盘(fsync)
+    static bool syncToDisk(QFile &file);
+
+    static constexpr qint64 kSegmentSizeLimit = 4 * 1024 * 1024; // 单个分段上限4MB
+    static constexpr int kMaxOpenLogs = 64;                      // 同时打开的会话数上限
+    static constexpr int kMaxMappedSegments = 4;                 // 每个会话同时映射的分段数上限
+
+    // 记录状态标志
+    static constexpr quint8 kFlagRead = 0x01;
+    static constexpr quint8 kFlagRecalled = 0x02;
+
+private:
+    struct ChatLog;
+    struct IndexEntry {
+        quint32 segment;
+        quint32 offset;
+        quint32 length;
+    };
+
+    QString m_rootDir;
+    RecordFormat m_recordFormat;
+    QHash<QString, std::shared_ptr<ChatLog>> m_logs;
+    quint64 m_useCounter;               // openLog()调用序号
+
+    // 日志文件操作
+    ChatLog *openLog(const QString &chatKey, bool create);
+    void evictLeastRecentlyUsed();
+    void recoverTail(ChatLog *log, qint64 &indexSize);
+    const char *mapSegment(ChatLog *log, quint32 segment, qint64 end);
+    bool syncLog(ChatLog *log);
+    bool openSegment(ChatLog *log, quint32 segment);
+    bool rollSegment(ChatLog *log);
+    bool writeSegment(ChatLog *log, const QByteArray &data);
+    QList<ChatRecord> readRange(ChatLog *log, qint64 start, qint64 end);
+    qint64 lowerBoundByTimestamp(ChatLog *log, qint64 timestamp);
+    bool loadIdIndex(ChatLog *log);
+    bool appendIdIndex(ChatLog *log, quint32 firstRecord, const QList<ChatRecord> &records);
+    void loadFlags(ChatLog *log);
+    void loadDictionary(ChatLog *log);
+    quint32 internString(ChatLog *log, const QString &text, QByteArray *dictionaryData);
+    RecordFormat segmentFormat(ChatLog *log, quint32 segment);
+    QString chatDirPath(const QString &chatKey) const;
+
+    // 记录编解码
+    QByteArray encodeRecord(ChatLog *log, const ChatRecord &record, QByteArray *dictionaryData);
+    bool decodeRecord(ChatLog *log, RecordFormat format, const char *data, qsizetype size, ChatRecord *record);
+};
+
+#endif // CHATLOGSTORE_H
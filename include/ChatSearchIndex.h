@@ -0,0 +1,154 @@
+#ifndef CHATSEARCHINDEX_H
+#define CHATSEARCHINDEX_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QHash>
+#include <QFile>
+#include <vector>
+#include <deque>
+#include "ChatLogStore.h"
+
+/**
+ * @brief 本地聊天记录全文索引
+ * 覆盖所有私聊和群聊的倒排索引，随消息写入增量维护
+ * 中日韩文字按单字和相邻双字切分，其他文字按单词切分并转为小写，
+ * 倒排表记录词在消息中的位置，支持多词与、短语("...")和前缀(词*)查询
+ * 新消息的倒排块追加到postings.log并保留在内存中，累积到一定数量后
+ * 按词整理成段追加到segments.dat，同时用检查点重写postings.log；
+ * 打开时只载入各段的词目录，段中的倒排表和文档在查询时从磁盘读取
+ * 清空会话时追加删除标记，旧的文档在查询时被忽略
+ * 只在ChatHistoryWorker所在的工作线程中使用
+ */
+class ChatSearchIndex
+{
+public:
+    struct Token {
+        QString term;
+        quint32 position = 0;
+    };
+
+    struct Hit {
+        QString chatKey;
+        quint32 record = 0;
+    };
+
+    ChatSearchIndex();
+    ~ChatSearchIndex();
+
+    // 打开索引目录并载入已有索引
+    bool open(const QString &dirPath);
+    void close();
+
+    // 删除全部索引
+    void clear();
+
+    // 会话中已建立索引的记录数，记录序号小于该值的消息都已索引
+    quint32 indexedCount(const QString &chatKey) const;
+
+    // 为会话中从firstRecord开始的连续记录建立索引
+    bool addRecords(const QString &chatKey, quint32 firstRecord, const QList<ChatRecord> &records);
+
+    // 会话被清空后删除其索引
+    bool removeChat(const QString &chatKey);
+
+    // 查询，按消息从新到旧返回最多limit个候选
+    QList<Hit> search(const QString &query, int limit) const;
+
+    quint32 documentCount() const { return m_tailBase + static_cast<quint32>(m_documents.size()); }
+    quint32 termCount() const { return static_cast<quint32>(m_terms.size()); }
+
+    // 分词，查询时中日韩连续文字只保留双字词
+    static QList<Token> tokenize(const QString &text, bool forQuery = false);
+
+private:
+    struct Posting {
+        quint32 document;
+        quint32 position;
+    };
+
+    struct Document {
+        quint32 chat;
+        quint32 record;
+        quint32 epoch;
+    };
+
+    struct ChatState {
+        QString chatKey;
+        quint32 epoch = 0;
+        quint32 indexedCount = 0;
+    };
+
+    // 查询子句：连续出现的一组词，最后一个词可以是前缀
+    struct Clause {
+        QList<Token> tokens;
+        bool prefix = false;
+    };
+
+    // 段中一个词的倒排表位置，offset相对于段的倒排数据起点
+    struct TermEntry {
+        quint32 term;
+        quint32 offset;
+        quint32 length;
+    };
+
+    struct Segment {
+        qint64 offset = 0;          // 段头在segments.dat中的位置
+        qint64 dataOffset = 0;      // 倒排数据的起点
+        quint32 documentBase = 0;
+        quint32 documentCount = 0;
+        std::vector<TermEntry> terms;   // 按词序号排序
+    };
+
+    struct ClauseTerm {
+        const std::vector<Posting> *postings;
+        quint32 offset;
+    };
+
+    QString m_dirPath;
+    QFile m_termsFile;
+    QFile m_chatsFile;
+    QFile m_postingsFile;
+    mutable QFile m_segmentsFile;
+
+    QStringList m_terms;
+    QHash<QString, quint32> m_termIds;
+    // 尚未整理成段的文档及其倒排表，文档号从m_tailBase开始
+    std::vector<std::vector<Posting>> m_postings;
+    std::vector<Document> m_documents;
+    quint32 m_tailBase;
+
+    std::vector<Segment> m_segments;
+    qint64 m_segmentsSize;
+    std::vector<ChatState> m_chats;
+    QHash<QString, quint32> m_chatIds;
+
+    // 前缀查询使用的有序词表，新增词后重建
+    mutable QStringList m_sortedTerms;
+    mutable bool m_sortedTermsDirty;
+
+    static constexpr int kMaxPrefixExpansion = 64;
+    static constexpr qsizetype kSegmentDocuments = 8192;
+
+    // 载入与写入
+    bool loadDictionary(const QString &filePath, QStringList *entries);
+    bool loadPostings();
+    bool loadSegments();
+    void applyBlock(const char *data, qsizetype size);
+    bool writeBlock(const QByteArray &payload);
+    bool writeSegment();
+    bool rewriteLog();
+    quint32 chatId(const QString &chatKey, QByteArray *dictionaryData);
+    quint32 termId(const QString &term, QByteArray *dictionaryData);
+
+    // 查询
+    static QList<Clause> parseQuery(const QString &query);
+    const std::vector<Posting> *lookup(const QString &term, bool prefix,
+                                       std::deque<std::vector<Posting>> &loaded) const;
+    void readPostings(quint32 term, std::vector<Posting> &postings) const;
+    bool readDocument(quint32 document, Document *doc) const;
+    static bool matchesClause(const QList<ClauseTerm> &terms, quint32 document);
+};
+
+#endif // CHATSEARCHINDEX_H
@@ -0,0 +1,52 @@
+#ifndef CONTACTLISTMODEL_H
+#define CONTACTLISTMODEL_H
+
+#include <QAbstractListModel>
+#include <QList>
+#include <QStringList>
+#include <QVariantMap>
+
+/**
+ * @brief 好友、群组、用户列表共用的联系人模型
+ * 每行是一个QVariantMap，以keyField字段作为行的唯一标识，字段名即QML中的角色名
+ * setContacts()把新快照与当前内容逐行比较，只发出删除、插入、移动和变化的行，
+ * 未变化的行不会重建delegate，列表滚动位置也得以保留
+ */
+class ContactListModel : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_PROPERTY(int count READ rowCount NOTIFY countChanged)
+
+public:
+    ContactListModel(const QString &keyField, const QStringList &fields, QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    // 用新快照替换列表内容，按key比较后只通知差异
+    void setContacts(const QVariantList &contacts);
+    // 应用增量：changed中的项按key替换或追加到末尾，removed中的key被删除
+    void applyChanges(const QVariantList &changed, const QStringList &removed);
+    // 修改单行的一个字段，例如在线状态变化
+    bool setField(const QString &key, const QString &field, const QVariant &value);
+    bool contains(const QString &key) const { return rowOf(key) >= 0; }
+
+    QVariantList contacts() const;
+    QStringList keys() const;
+    Q_INVOKABLE QVariantMap get(int row) const;
+
+signals:
+    void countChanged();
+
+private:
+    QString m_keyField;
+    QStringList m_fields;
+    QList<QVariantMap> m_rows;
+
+    QString keyOf(const QVariantMap &row) const { return row.value(m_keyField).toString(); }
+    int rowOf(const QString &key) const;
+    QList<int> changedRoles(const QVariantMap &before, const QVariantMap &after) const;
+};
+
+#endif // CONTACTLISTMODEL_H
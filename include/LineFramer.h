@@ -0,0 +1,56 @@
+#ifndef LINEFRAMER_H
+#define LINEFRAMER_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QIODevice>
+
+/**
+ * @brief 按换行符切分的增量帧解析器
+ * 接收的数据直接读入内部字节缓冲区，只扫描新到达的字节查找分隔符，
+ * 完整的帧以指向缓冲区的视图返回，不做复制和UTF-16转换
+ * 协商为二进制协议后改用nextSizedFrame()，按4字节大端长度前缀切分，
+ * 前缀最高位为压缩标记，只有调用方能处理压缩帧时才接受
+ * 已取走的数据在缓冲区前部累积过半时整体前移，避免每帧移动数据
+ * 返回的视图在下一次readFrom()/append()之前有效
+ */
+class LineFramer
+{
+public:
+    explicit LineFramer(qsizetype maxFrameSize = 16 * 1024 * 1024);
+
+    // 读入设备中全部可读数据，返回读取的字节数
+    qint64 readFrom(QIODevice *device);
+    void append(QByteArrayView data);
+
+    // 取出下一个完整的帧(不含行尾的\r\n)，没有完整帧时返回false
+    bool nextFrame(QByteArrayView *frame);
+    // 取出下一个长度前缀帧(不含前缀)，长度超过上限时置错误标记
+    // compressed为空时带压缩标记的帧也视为错误
+    bool nextSizedFrame(QByteArrayView *frame, bool *compressed = nullptr);
+    bool hasError() const { return m_error; }
+
+    // 尚未形成完整帧的数据
+    QByteArrayView pending() const;
+    void discardPending();
+
+    void clear();
+    qsizetype bufferedBytes() const { return m_tail - m_head; }
+
+    static constexpr qsizetype kSizePrefixBytes = 4;
+    static constexpr quint32 kCompressedFlag = 0x80000000u;
+
+private:
+    QByteArray m_buffer;
+    qsizetype m_head;       // 下一帧的起始位置
+    qsizetype m_scan;       // 下一次查找分隔符的起始位置
+    qsizetype m_tail;       // 有效数据的结束位置
+    qsizetype m_maxFrameSize;
+    bool m_error;
+
+    static constexpr qsizetype kInitialCapacity = 4096;
+
+    void reserve(qsizetype bytes);
+};
+
+#endif // LINEFRAMER_H
@@ -6,10 +6,12 @@
 #include <QString>
 #include <QDateTime>
 #include "MessageType.h"
+#include "NetMessage.h"
 
 /**
  * @brief 消息类
- * 封装客户端和服务器之间的消息数据
+ * 封装客户端和服务器之间的消息数据，供QML使用
+ * 网络层内部使用值类型NetMessage，只在需要QObject时才转换为Message
  */
 class Message : public QObject
 {
@@ -21,6 +23,7 @@ class Message : public QObject
 public:
     explicit Message(QObject *parent = nullptr);
     Message(MessageType type, const QVariantMap &data, QObject *parent = nullptr);
+    explicit Message(const NetMessage &message, QObject *parent = nullptr);
     
     // Getter 和 Setter
     MessageType type() const { return m_type; }
@@ -35,6 +38,7 @@ public:
     // 序列化和反序列化
     QString toString() const;
     static Message* fromString(const QString &messageString, QObject *parent = nullptr);
+    NetMessage toNetMessage() const { return NetMessage(m_type, m_data); }
     
     // 便捷方法
     void setData(const QString &key, const QVariant &value);
@@ -0,0 +1,51 @@
+#ifndef MESSAGEDISPATCHER_H
+#define MESSAGEDISPATCHER_H
+
+#include <QObject>
+#include <QPointer>
+#include <array>
+#include <functional>
+#include "NetMessage.h"
+
+/**
+ * @brief 按消息类型索引的分发表
+ * 每种MessageType最多有一个处理函数，分发时按类型直接取表项，不做字符串比较
+ * subscribe()的类型化版本从Payload::kType取得表项位置，收到消息时先用Payload::decode()
+ * 解码为结构再调用处理函数；接收对象析构后表项自动失效
+ */
+class MessageDispatcher
+{
+public:
+    using Handler = std::function<void(const NetMessage &message)>;
+
+    static constexpr int kTableSize = 64;
+
+    template <typename Payload, typename Receiver>
+    bool subscribe(Receiver *receiver, void (Receiver::*handler)(const Payload &))
+    {
+        static_assert(static_cast<int>(Payload::kType) >= 0 && static_cast<int>(Payload::kType) < kTableSize,
+                      "message type outside dispatch table");
+        return subscribe(Payload::kType, receiver, [receiver, handler](const NetMessage &message) {
+            (receiver->*handler)(Payload::decode(message));
+        });
+    }
+
+    // 已有其他对象处理该类型时返回false
+    bool subscribe(MessageType type, QObject *receiver, Handler handler);
+    void unsubscribe(const QObject *receiver);
+
+    // 没有处理函数时返回false
+    bool dispatch(const NetMessage &message) const;
+
+private:
+    struct Entry {
+        QPointer<QObject> receiver;
+        Handler handler;
+    };
+
+    std::array<Entry, kTableSize> m_entries;
+
+    static int indexOf(MessageType type);
+};
+
+#endif // MESSAGEDISPATCHER_H
@@ -0,0 +1,86 @@
+#ifndef MESSAGELISTMODEL_H
+#define MESSAGELISTMODEL_H
+
+#include <QAbstractListModel>
+#include <QList>
+#include <QString>
+#include "ChatLogStore.h"
+
+/**
+ * @brief 当前会话的消息列表模型
+ * 直接由ChatHistoryManager读出的ChatRecord填充，不经过QVariantMap转换
+ * 一页历史记录只触发一次beginInsertRows，向前翻页的记录整体插入到顶部
+ * 消息按时间从旧到新排列，isOwn和显示时间在data()中按需计算
+ */
+class MessageListModel : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_PROPERTY(int count READ rowCount NOTIFY countChanged)
+    Q_PROPERTY(QString chatType READ chatType NOTIFY chatChanged)
+    Q_PROPERTY(QString chatId READ chatId NOTIFY chatChanged)
+
+public:
+    enum Roles {
+        MessageIdRole = Qt::UserRole + 1,
+        TextRole,
+        IsOwnRole,
+        TimestampRole,      // 显示用的时间字符串
+        TimestampMsRole,
+        StatusRole,
+        FromUserIdRole,
+        FromUsernameRole,
+        RecalledRole
+    };
+    Q_ENUM(Roles)
+
+    explicit MessageListModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    // 当前会话，切换时清空列表
+    QString chatType() const { return m_chatType; }
+    QString chatId() const { return m_chatId; }
+    void setChat(const QString &type, const QString &chatId);
+    bool isShowing(const QString &type, const QString &chatId) const;
+    void setCurrentUserId(const QString &userId);
+
+    // 批量更新，每次调用只通知一次
+    void setRecords(const QList<ChatRecord> &records);
+    void prependRecords(const QList<ChatRecord> &records);
+
+    // 单条消息
+    void appendMessage(const QString &messageId, const QString &fromUserId, const QString &fromUsername,
+                       const QString &content, qint64 timestamp, const QString &status);
+    bool setStatus(const QString &messageId, const QString &status);
+    bool markRecalled(const QString &messageId);
+
+    Q_INVOKABLE void clear();
+    Q_INVOKABLE QString firstMessageId() const;
+
+signals:
+    void countChanged();
+    void chatChanged();
+
+private:
+    struct MessageItem {
+        QString messageId;
+        QString fromUserId;
+        QString fromUsername;
+        QString content;
+        qint64 timestamp = 0;
+        QString status;
+        bool recalled = false;
+    };
+
+    QList<MessageItem> m_items;
+    QString m_chatType;
+    QString m_chatId;
+    QString m_currentUserId;
+
+    static MessageItem itemFromRecord(const ChatRecord &record);
+    int rowOf(const QString &messageId) const;
+};
+
+#endif // MESSAGELISTMODEL_H
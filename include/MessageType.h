@@ -60,7 +60,13 @@ enum class MessageType : int {
     FILE_MESSAGE = 48,              // 文件消息
     FILE_MESSAGE_RESPONSE = 49,     // 文件消息响应
     IMAGE_MESSAGE = 50,             // 图片消息
-    IMAGE_MESSAGE_RESPONSE = 51     // 图片消息响应
+    IMAGE_MESSAGE_RESPONSE = 51,    // 图片消息响应
+    PROTOCOL_NEGOTIATE = 52,        // 协商传输格式
+    PROTOCOL_NEGOTIATE_RESPONSE = 53, // 协商传输格式响应
+    SESSION_RESUME = 54,            // 断线重连后恢复会话
+    SESSION_RESUME_RESPONSE = 55,   // 恢复会话响应
+    SEARCH_USERS = 56,              // 按用户名前缀分页搜索用户
+    SEARCH_USERS_RESPONSE = 57      // 搜索用户响应
 };
 
 /**
@@ -117,7 +123,13 @@ public:
         FileMessage = static_cast<int>(MessageType::FILE_MESSAGE),
         FileMessageResponse = static_cast<int>(MessageType::FILE_MESSAGE_RESPONSE),
         ImageMessage = static_cast<int>(MessageType::IMAGE_MESSAGE),
-        ImageMessageResponse = static_cast<int>(MessageType::IMAGE_MESSAGE_RESPONSE)
+        ImageMessageResponse = static_cast<int>(MessageType::IMAGE_MESSAGE_RESPONSE),
+        ProtocolNegotiate = static_cast<int>(MessageType::PROTOCOL_NEGOTIATE),
+        ProtocolNegotiateResponse = static_cast<int>(MessageType::PROTOCOL_NEGOTIATE_RESPONSE),
+        SessionResume = static_cast<int>(MessageType::SESSION_RESUME),
+        SessionResumeResponse = static_cast<int>(MessageType::SESSION_RESUME_RESPONSE),
+        SearchUsers = static_cast<int>(MessageType::SEARCH_USERS),
+        SearchUsersResponse = static_cast<int>(MessageType::SEARCH_USERS_RESPONSE)
     };
     Q_ENUM(Type)
 
@@ -174,6 +186,12 @@ inline QString messageTypeToString(MessageType type) {
         case MessageType::FILE_MESSAGE_RESPONSE: return "FILE_MESSAGE_RESPONSE";
         case MessageType::IMAGE_MESSAGE: return "IMAGE_MESSAGE";
         case MessageType::IMAGE_MESSAGE_RESPONSE: return "IMAGE_MESSAGE_RESPONSE";
+        case MessageType::PROTOCOL_NEGOTIATE: return "PROTOCOL_NEGOTIATE";
+        case MessageType::PROTOCOL_NEGOTIATE_RESPONSE: return "PROTOCOL_NEGOTIATE_RESPONSE";
+        case MessageType::SESSION_RESUME: return "SESSION_RESUME";
+        case MessageType::SESSION_RESUME_RESPONSE: return "SESSION_RESUME_RESPONSE";
+        case MessageType::SEARCH_USERS: return "SEARCH_USERS";
+        case MessageType::SEARCH_USERS_RESPONSE: return "SEARCH_USERS_RESPONSE";
     }
     return "UNKNOWN";
 }
@@ -0,0 +1,71 @@
+#ifndef NETMESSAGE_H
+#define NETMESSAGE_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QString>
+#include <QVariant>
+#include <QVariantMap>
+#include <QVarLengthArray>
+#include <QMetaType>
+#include "MessageType.h"
+
+/**
+ * @brief 网络消息的值类型表示
+ * 接收时把整帧复制到一块连续内存中，字段只记录键和值在其中的位置，
+ * 字段表存放在内联数组里，常见消息不需要额外分配
+ * 字符串值在读取时才从UTF-8转换，二进制格式中的列表、整数等带类型的值解析时直接转换
+ * 以常量引用分发给各控制器，需要QObject时(例如QML)再转换为Message
+ */
+class NetMessage
+{
+public:
+    NetMessage();
+    NetMessage(MessageType type, const QVariantMap &data);
+
+    MessageType type() const { return m_type; }
+    qsizetype fieldCount() const { return m_fields.size(); }
+
+    // 字段访问，键重复时以最后一个为准
+    bool contains(QByteArrayView key) const { return findField(key) >= 0; }
+    QVariant value(QByteArrayView key, const QVariant &defaultValue = QVariant()) const;
+    QString string(QByteArrayView key, const QString &defaultValue = QString()) const;
+    QVariantMap toVariantMap() const;
+
+    // 按位置访问字段，解码时遍历一次即可取出全部字段
+    QByteArrayView keyAt(qsizetype index) const { return keyOf(m_fields[index]); }
+    QVariant valueAt(qsizetype index) const { return fieldValue(m_fields[index]); }
+    QString stringAt(qsizetype index) const;
+
+    // 文本格式 type:key1=value1;key2=value2(不含行尾换行)
+    QByteArray toText() const;
+    static bool fromText(QByteArrayView frame, NetMessage *message);
+
+    // 二进制格式: 类型(varint)、字段数(varint)，每个字段为键和带类型标记的值
+    // 值可以是字符串、整数、布尔、浮点、字节、列表和嵌套映射，不需要转义
+    QByteArray toBinary() const;
+    static bool fromBinary(QByteArrayView payload, NetMessage *message);
+
+private:
+    struct Field {
+        qint32 keyOffset = 0;
+        qint32 keyLength = 0;
+        qint32 valueOffset = 0;
+        qint32 valueLength = 0;
+        bool typed = false;     // 值保存在value中，否则为m_raw中的UTF-8字符串
+        QVariant value;
+    };
+
+    MessageType m_type;
+    QByteArray m_raw;
+    QVarLengthArray<Field, 8> m_fields;
+
+    qsizetype findField(QByteArrayView key) const;
+    QByteArrayView keyOf(const Field &field) const;
+    QByteArrayView rawValueOf(const Field &field) const;
+    QVariant fieldValue(const Field &field) const;
+};
+
+Q_DECLARE_METATYPE(NetMessage)
+
+#endif // NETMESSAGE_H
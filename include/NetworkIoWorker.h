@@ -0,0 +1,169 @@
+#ifndef NETWORKIOWORKER_H
+#define NETWORKIOWORKER_H
+
+#include <QObject>
+#include <QTcpSocket>
+#include <QHostInfo>
+#include <QHostAddress>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QQueue>
+#include <QHash>
+#include <QAtomicInteger>
+#include <memory>
+#include <optional>
+#include <vector>
+#include "NetMessage.h"
+#include "LineFramer.h"
+#include "SpscQueue.h"
+
+/**
+ * @brief 网络I/O后台工作对象
+ * 运行在NetworkManager的专用线程中，负责套接字读写、分帧和消息解析
+ * 解析出的消息放入单生产者单消费者队列，队列由空变为非空时发出messagesAvailable，
+ * 界面线程每帧取出一次；队列满时暂停读取，未读数据留在套接字缓冲区，由TCP流量控制限速
+ * 连接建立后由这里发出格式协商请求，收到同意的响应后立即切换后续帧的解析方式
+ * 二进制格式下可以同时协商zlib压缩，超过阈值的帧用qCompress压缩，长度前缀最高位作为标记
+ * 主机名的解析结果缓存一段时间，连接时IPv6和IPv4地址交替、错开发起连接(Happy Eyeballs)，
+ * 最先建立的连接胜出；胜出的地址记录下来，下次连接时最先尝试，缓存过期时与重新解析同时进行
+ * 除构造函数和标注为线程安全的方法外，所有方法都只能在工作线程中调用
+ */
+class NetworkIoWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    // 传输格式
+    enum class WireFormat {
+        Text,   // type:k=v;k=v，以换行分隔
+        Binary  // 4字节长度前缀 + NetMessage::toBinary()
+    };
+
+    // 写入批次中需要通知发送结果的消息
+    struct Delivery {
+        qint64 endOffset;   // 消息最后一个字节在批次中的位置
+        quint64 ticket;
+    };
+
+    using InboundQueue = SpscQueue<NetMessage>;
+
+    // 编码一个二进制帧追加到out，compress为true且压缩后更小时发送压缩帧
+    static void appendBinaryFrame(QByteArray &out, const QByteArray &payload, bool compress);
+
+    explicit NetworkIoWorker(InboundQueue *inbound, QObject *parent = nullptr);
+    ~NetworkIoWorker();
+
+    // 连接管理
+    void connectToHost(const QString &host, quint16 port);
+    // 关闭连接，连接尚未建立时取消解析和竞速
+    void disconnectFromHost();
+    // 立即关闭连接，用于判定连接已失效时
+    void abortConnection();
+
+    // 消费者取出消息后调用，队列有空间时继续读取
+    void resumeReading();
+
+    // 以下方法线程安全
+    // 写入已编码的一批帧，投递到工作线程后执行，结果通过deliveriesFinished通知
+    void writeBatch(const QByteArray &data, const QList<Delivery> &deliveries);
+    WireFormat wireFormat() const { return static_cast<WireFormat>(m_wireFormat.loadAcquire()); }
+    bool isCompressionEnabled() const { return m_compression.loadAcquire(); }
+    // 已提交但还没有发出的字节数，包括投递途中的批次
+    qint64 queuedBytes() const { return m_queuedBytes.loadRelaxed(); }
+    bool isReadingStalled() const { return m_readingStalled.loadAcquire(); }
+    void setHighWaterMark(qint64 bytes) { m_highWaterMark.storeRelaxed(bytes); }
+    // 消费者开始取队列前调用，之后再有新消息时重新发出messagesAvailable
+    void clearWakeup() { m_wakePending.storeRelease(false); }
+
+signals:
+    void connected();
+    void disconnected();
+    void errorOccurred(const QString &error, bool unconnected);
+    void messagesAvailable();
+    void deliveriesFinished(const QList<quint64> &tickets, bool delivered);
+    void writeBufferDrained();
+
+private slots:
+    void onSocketConnected();
+    void onSocketDisconnected();
+    void onSocketError(QAbstractSocket::SocketError error);
+    void onSocketReadyRead();
+    void onSocketBytesWritten(qint64 bytes);
+    void onHostLookedUp(const QHostInfo &info);
+    void startNextAttempt();
+
+private:
+    struct PendingDelivery {
+        qint64 endOffset;   // 在本次连接写出数据中的位置
+        quint64 ticket;
+    };
+
+    // 主机名解析缓存
+    struct ResolvedHost {
+        QList<QHostAddress> addresses;
+        qint64 expiresAt;
+    };
+
+    InboundQueue *m_inbound;
+    std::unique_ptr<QTcpSocket> m_socket;
+    QElapsedTimer m_clock;
+
+    // 解析缓存，以及每个主机上次连接成功的地址
+    QHash<QString, ResolvedHost> m_dnsCache;
+    QHash<QString, QHostAddress> m_preferredAddresses;
+
+    // 正在进行的连接竞速
+    bool m_racing;
+    QString m_raceHost;
+    quint16 m_racePort;
+    int m_lookupId;                         // 等待中的解析，-1表示没有
+    QList<QHostAddress> m_raceQueue;        // 还没有尝试的地址
+    QList<QHostAddress> m_raceTried;
+    std::vector<std::unique_ptr<QTcpSocket>> m_attempts;
+    std::unique_ptr<QTimer> m_raceTimer;
+    QString m_raceError;
+    LineFramer m_framer;
+
+    // 队列满时解析出但还没放入队列的消息
+    std::optional<NetMessage> m_stalledMessage;
+
+    QQueue<PendingDelivery> m_pendingDeliveries;
+    qint64 m_bytesSubmitted;
+    qint64 m_bytesDelivered;
+
+    QAtomicInteger<int> m_wireFormat;
+    QAtomicInteger<bool> m_compression;
+    QAtomicInteger<qint64> m_queuedBytes;
+    QAtomicInteger<qint64> m_highWaterMark;
+    QAtomicInteger<bool> m_readingStalled;
+    QAtomicInteger<bool> m_wakePending;
+
+    static constexpr qint64 kSocketReadBufferSize = 4 * 1024 * 1024;
+    // 小于阈值的帧压缩收益很小，直接发送
+    static constexpr qsizetype kCompressionThreshold = 512;
+    static constexpr quint32 kMaxInflatedFrameSize = 16 * 1024 * 1024;
+    // QHostInfo不提供记录的TTL，使用固定的缓存时间
+    static constexpr qint64 kDnsCacheTtlMs = 5 * 60 * 1000;
+    // 前一个地址在此时间内没有结果时并行尝试下一个地址
+    static constexpr int kConnectAttemptDelayMs = 250;
+
+    void configureSocket(QTcpSocket *socket);
+    void attachSocket(std::unique_ptr<QTcpSocket> socket);
+    void addCandidates(const QList<QHostAddress> &addresses);
+    void onAttemptConnected(QTcpSocket *socket);
+    void onAttemptFailed(QTcpSocket *socket);
+    std::unique_ptr<QTcpSocket> takeAttempt(QTcpSocket *socket);
+    void finishRaceIfExhausted();
+    void cancelRace();
+    QString raceKey() const { return m_raceHost.toLower(); }
+    void writeData(const QByteArray &data, const QList<Delivery> &deliveries);
+    void processReceivedFrames();
+    bool nextFrame(QByteArrayView *frame, bool *compressed);
+    bool processFrame(QByteArrayView frame, bool compressed = false);
+    static bool inflateFrame(QByteArrayView frame, QByteArray *payload);
+    bool pushMessage(NetMessage &&message);
+    void startNegotiation();
+    void failPendingDeliveries();
+};
+
+#endif // NETWORKIOWORKER_H
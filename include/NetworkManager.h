@@ -2,18 +2,39 @@
 #define NETWORKMANAGER_H
 
 #include <QObject>
-#include <QTcpSocket>
 #include <QTimer>
 #include <QQueue>
+#include <QHash>
+#include <QSet>
 #include <QMutex>
 #include <QThread>
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QPromise>
 #include <memory>
+#include <functional>
+#include <map>
 #include "Message.h"
+#include "NetMessage.h"
+#include "NetworkIoWorker.h"
+#include "MessageDispatcher.h"
 
 /**
  * @brief 网络管理器
  * 负责与服务器的TCP连接、消息发送接收和心跳维护
- * 支持异步操作，避免界面卡顿
+ * 套接字读写、分帧和解析在专用I/O线程(NetworkIoWorker)中执行，解析好的消息经无锁队列
+ * 交给界面线程，界面线程每帧取出一次并在时间预算内分发，其余留到下一帧
+ * 连接建立后先以文本格式发送协商请求，服务器同意后双方改用长度前缀的二进制格式，
+ * 旧服务器不认识协商请求时继续使用文本格式
+ * 发送的消息先进入发送队列，同一轮事件循环中的消息合并为一次写入；
+ * 套接字未发出的数据超过高水位时暂停写入，断线和协商期间消息保留在队列中
+ * 连接意外断开后按带随机抖动的指数退避自动重连，连续失败过多时熔断一段时间；
+ * 设置了会话令牌时，重连后先用令牌恢复会话并请求断线期间的消息，成功后才发送队列
+ * request()发出的请求带有reqId，服务器在响应中原样返回，多个请求可以同时等待响应；
+ * 匹配到请求的响应只交给请求方，其余消息按类型交给在dispatcher()中订阅的唯一处理方，
+ * 都不匹配时才通过messageReceived广播
+ * 心跳带序号，根据响应估算往返时间和抖动；连续心跳超时且期间没有收到任何数据时
+ * 判定连接已失效并断开重连，心跳间隔随网络状况和应用是否在前台调整
  */
 class NetworkManager : public QObject
 {
@@ -21,13 +42,22 @@ class NetworkManager : public QObject
     Q_PROPERTY(bool connected READ isConnected NOTIFY connectedChanged)
     Q_PROPERTY(QString serverHost READ serverHost WRITE setServerHost NOTIFY serverHostChanged)
     Q_PROPERTY(int serverPort READ serverPort WRITE setServerPort NOTIFY serverPortChanged)
+    Q_PROPERTY(bool reconnecting READ isReconnecting NOTIFY reconnectingChanged)
+    Q_PROPERTY(int rtt READ rtt NOTIFY rttChanged)
+    Q_PROPERTY(int rttJitter READ rttJitter NOTIFY rttChanged)
 
 public:
+    using WireFormat = NetworkIoWorker::WireFormat;
+
+    // 发送结果回调，数据全部交给系统发出时为true，断线或丢弃时为false
+    using DeliveryCallback = std::function<void(bool delivered)>;
+
     explicit NetworkManager(QObject *parent = nullptr);
     ~NetworkManager();
 
     // 连接状态
     bool isConnected() const;
+    WireFormat wireFormat() const { return m_worker->wireFormat(); }
     
     // 服务器配置
     QString serverHost() const { return m_serverHost; }
@@ -35,6 +65,37 @@ public:
     
     int serverPort() const { return m_serverPort; }
     void setServerPort(int port);
+    
+    // 发送队列
+    void sendMessage(const NetMessage &message, DeliveryCallback callback);
+    qint64 sendHighWaterMark() const { return m_sendHighWaterMark; }
+    void setSendHighWaterMark(qint64 bytes);
+    int queuedMessageCount() const;
+    
+    // 请求/响应，超时或断线时结果为ERROR类型、status为-1的消息
+    // 旧服务器不回传reqId时，按发出顺序匹配第一个等待responseType的请求
+    QFuture<NetMessage> request(MessageType type, const QVariantMap &data, MessageType responseType,
+                                int timeoutMs = kDefaultRequestTimeoutMs);
+    int pendingRequestCount() const { return static_cast<int>(m_pendingRequests.size()); }
+    
+    // 按消息类型订阅服务器推送
+    MessageDispatcher &dispatcher() { return m_dispatcher; }
+    
+    // 自动重连
+    bool isReconnecting() const;
+    bool autoReconnect() const { return m_autoReconnect; }
+    void setAutoReconnect(bool enabled);
+    
+    // 会话恢复，登录成功后设置，登出时清除
+    void setSession(const QString &userId, const QString &token);
+    void clearSession();
+    bool hasSession() const { return !m_sessionToken.isEmpty(); }
+    QString lastMessageId() const { return m_lastMessageId; }
+    
+    // 平滑往返时间和抖动(毫秒)，还没有测量结果时为-1
+    int rtt() const { return m_srtt; }
+    int rttJitter() const { return m_rttVar; }
+    int heartbeatInterval() const { return m_heartbeatTimer->interval(); }
 
 public slots:
     // 连接管理
@@ -44,9 +105,10 @@ public slots:
     // 消息发送
     void sendMessage(const Message *message);
     void sendMessage(MessageType type, const QVariantMap &data);
+    void sendMessage(const NetMessage &message);
     
     // 心跳管理
-    void startHeartbeat(int intervalMs = 20000); // 默认20秒
+    void startHeartbeat(int intervalMs = kDefaultHeartbeatIntervalMs); // 默认20秒，为基准间隔
     void stopHeartbeat();
 
 signals:
@@ -55,47 +117,160 @@ signals:
     void connected();
     void disconnected();
     void connectionError(const QString &error);
+    void reconnectingChanged();
+    void reconnectScheduled(int attempt, int delayMs);
+    void reconnected();
+    void sessionResumed();
+    void sessionResumeFailed(const QString &reason);
+    void rttChanged();
     
-    // 消息信号
-    void messageReceived(const Message *message);
-    void messageSent(const Message *message);
+    // 没有订阅方的消息，消息只在信号处理期间有效
+    void messageReceived(const NetMessage &message);
+    void messageSent(const NetMessage &message);
+    // 供QML使用，只有连接了该信号才会创建Message对象
+    void messageObjectReceived(Message *message);
     
     // 服务器配置信号
     void serverHostChanged();
     void serverPortChanged();
 
 private slots:
-    // Socket事件处理
-    void onSocketConnected();
-    void onSocketDisconnected();
-    void onSocketError(QAbstractSocket::SocketError error);
-    void onSocketReadyRead();
+    // I/O线程事件处理
+    void onWorkerConnected();
+    void onWorkerDisconnected();
+    void onWorkerError(const QString &error, bool unconnected);
+    void onDeliveriesFinished(const QList<quint64> &tickets, bool delivered);
+    void drainInbound();
     
     // 心跳处理
     void sendHeartbeat();
+    void onHeartbeatTimeout();
+    void onApplicationStateChanged(Qt::ApplicationState state);
+    
+    // 重连处理
+    void attemptReconnect();
 
 private:
+    // I/O线程，以及从其中接收已解析消息的队列
+    QThread m_ioThread;
+    NetworkIoWorker::InboundQueue m_inbound;
+    NetworkIoWorker *m_worker;
+    std::unique_ptr<QTimer> m_drainTimer;
+    QElapsedTimer m_lastDrain;
+    
     // 网络组件
-    std::unique_ptr<QTcpSocket> m_socket;
     std::unique_ptr<QTimer> m_heartbeatTimer;
+    std::unique_ptr<QTimer> m_heartbeatTimeoutTimer;
+    std::unique_ptr<QTimer> m_negotiationTimer;
+    std::unique_ptr<QTimer> m_reconnectTimer;
+    std::unique_ptr<QTimer> m_requestTimer;
     
     // 服务器配置
     QString m_serverHost;
     int m_serverPort;
     
-    // 消息缓冲
-    QString m_messageBuffer;
-    QQueue<std::shared_ptr<Message>> m_sendQueue;
-    QMutex m_sendMutex;
+    // 发送队列，以及已交给I/O线程、等待发出的回调
+    struct QueuedMessage {
+        NetMessage message;
+        DeliveryCallback callback;
+    };
+    QQueue<QueuedMessage> m_sendQueue;
+    QHash<quint64, DeliveryCallback> m_deliveryCallbacks;
+    quint64 m_nextDeliveryTicket;
+    mutable QMutex m_sendMutex;
+    qint64 m_sendHighWaterMark;
+    bool m_flushScheduled;
       // 状态
     bool m_isConnected;
+    bool m_connecting;
     qint64 m_connectionStartTime;  // 连接开始时间
+    bool m_negotiating;
+    
+    // 等待响应的请求，按reqId(即发出顺序)排序
+    struct PendingRequest {
+        MessageType responseType;
+        qint64 deadline;    // m_clock上的时间
+        std::shared_ptr<QPromise<NetMessage>> promise;
+    };
+    std::map<quint32, PendingRequest> m_pendingRequests;
+    quint32 m_nextRequestId;
+    MessageDispatcher m_dispatcher;
+    
+    // 重连与会话恢复
+    bool m_autoReconnect;
+    bool m_manualDisconnect;    // 用户主动断开时不重连
+    int m_reconnectAttempt;
+    bool m_resuming;
+    QString m_sessionUserId;
+    QString m_sessionToken;
+    QString m_lastMessageId;
+    
+    // 心跳与往返时间，时间取自单调时钟m_clock
+    QElapsedTimer m_clock;
+    int m_heartbeatBaseIntervalMs;
+    quint32 m_heartbeatSeq;
+    quint32 m_outstandingHeartbeat;   // 等待响应的心跳序号，0表示没有
+    qint64 m_heartbeatSentAt;
+    int m_missedHeartbeats;
+    int m_srtt;
+    int m_rttVar;
+    bool m_appActive;
+    
+    static constexpr int kNegotiationTimeoutMs = 3000;
+    static constexpr qint64 kDefaultSendHighWaterMark = 1024 * 1024;
+    static constexpr int kMaxQueuedMessages = 1000;
+    static constexpr int kReconnectBaseDelayMs = 500;
+    static constexpr int kReconnectMaxDelayMs = 30000;
+    static constexpr int kCircuitBreakerThreshold = 8;
+    static constexpr int kCircuitOpenMs = 120000;
+    static constexpr int kDefaultRequestTimeoutMs = 10000;
+    static constexpr int kRequestSweepIntervalMs = 250;
+    static constexpr int kDefaultHeartbeatIntervalMs = 20000;
+    static constexpr int kMinHeartbeatIntervalMs = 5000;
+    static constexpr int kMaxHeartbeatIntervalMs = 60000;
+    static constexpr int kIdleHeartbeatFactor = 3;
+    static constexpr int kMinHeartbeatTimeoutMs = 2000;
+    static constexpr int kMaxHeartbeatTimeoutMs = 10000;
+    static constexpr int kMaxMissedHeartbeats = 2;
+    static constexpr size_t kInboundQueueCapacity = 1024;
+    static constexpr int kFrameIntervalMs = 16;
+    static constexpr int kDrainBudgetMs = 4;
     
     // 私有方法
-    void processReceivedData(const QString &data);
-    void processMessage(const QString &messageString);
+    void scheduleDrain();
+    void dispatchInbound(qint64 budgetMs);
+    void processMessage(const NetMessage &message);
+    void appendFrame(QByteArray &out, const NetMessage &message) const;
+    void writeFrame(const NetMessage &message);
+    void scheduleFlush();
     void sendQueuedMessages();
+    void failQueuedMessages();
     void initializeComponents();
+    
+    // 在I/O线程中执行操作
+    template <typename Function>
+    void postToWorker(Function function);
+    
+    // 格式协商与会话恢复
+    void startNegotiation();
+    void finishNegotiation(WireFormat format);
+    void startResume();
+    void finishResume(bool resumed, const QString &reason = QString());
+    bool handleControlMessage(const NetMessage &message);
+    
+    // 心跳
+    void handleHeartbeatResponse(const NetMessage &message);
+    void updateHeartbeatInterval();
+    int heartbeatTimeoutMs() const;
+    void resetRtt();
+    void scheduleReconnect();
+    
+    // 请求匹配
+    bool completeRequest(const NetMessage &message);
+    void expireRequests();
+    void failPendingRequests(const QString &reason);
+    void removeQueuedRequests(const QSet<quint32> &requestIds);
+    static NetMessage requestError(const QString &reason);
 };
 
 #endif // NETWORKMANAGER_H
\ No newline at end of file
@@ -0,0 +1,200 @@
+#ifndef PROTOCOLMESSAGES_H
+#define PROTOCOLMESSAGES_H
+
+#include <QString>
+#include <QStringList>
+#include <QVariantList>
+#include "NetMessage.h"
+
+/**
+ * @brief 服务器推送和响应消息的类型化结构
+ * 每个结构对应一种MessageType(kType)，decode()遍历一次消息字段取出全部内容，
+ * 列表字段在解码时转换为界面使用的QVariantList
+ * 由MessageDispatcher按消息类型解码后交给唯一的处理函数
+ */
+
+// 登录响应
+struct LoginResponsePayload {
+    static constexpr MessageType kType = MessageType::LOGIN_RESPONSE;
+    QString status;
+    QString message;
+    int offlineMsgCount = 0;
+
+    static LoginResponsePayload decode(const NetMessage &message);
+};
+
+// 服务器错误，errorMsg优先于message
+struct ErrorPayload {
+    static constexpr MessageType kType = MessageType::ERROR;
+    QString errorMsg;
+    QString message;
+
+    QString text() const;
+    static ErrorPayload decode(const NetMessage &message);
+};
+
+// 私聊消息
+struct PrivateChatPayload {
+    static constexpr MessageType kType = MessageType::PRIVATE_CHAT;
+    QString fromUserId;
+    QString fromUsername;
+    QString content;
+    QString messageId;
+    QString timestamp;
+
+    static PrivateChatPayload decode(const NetMessage &message);
+};
+
+// 群聊消息
+struct GroupChatPayload {
+    static constexpr MessageType kType = MessageType::GROUP_CHAT;
+    QString groupId;
+    QString fromUserId;
+    QString fromUsername;
+    QString content;
+    QString messageId;
+    QString timestamp;
+
+    static GroupChatPayload decode(const NetMessage &message);
+};
+
+// 好友
+struct AddFriendResponsePayload {
+    static constexpr MessageType kType = MessageType::ADD_FRIEND_RESPONSE;
+    QString status;
+    QString friendId;
+    QString username;
+    QString message;
+
+    static AddFriendResponsePayload decode(const NetMessage &message);
+};
+
+struct FriendRequestPayload {
+    static constexpr MessageType kType = MessageType::ADD_FRIEND_REQUEST;
+    QString fromUserId;
+    QString fromUsername;
+
+    static FriendRequestPayload decode(const NetMessage &message);
+};
+
+struct FriendAcceptedPayload {
+    static constexpr MessageType kType = MessageType::ACCEPT_FRIEND_RESPONSE;
+    QString userId;
+    QString username;
+
+    static FriendAcceptedPayload decode(const NetMessage &message);
+};
+
+struct FriendRejectedPayload {
+    static constexpr MessageType kType = MessageType::REJECT_FRIEND_RESPONSE;
+    QString userId;
+
+    static FriendRejectedPayload decode(const NetMessage &message);
+};
+
+// 列表增量同步，请求中带上revision时服务器只回传变化的项(delta=1)
+// 旧服务器不回传revision，此时revision为0，列表字段为完整列表
+struct ListSyncInfo {
+    qint64 revision = 0;
+    bool isDelta = false;
+    QVariantList changed;   // 新增和修改的项，格式与完整列表相同
+    QStringList removed;    // 删除项的id
+};
+
+// 每项为{userId, username, online}
+struct FriendListPayload {
+    static constexpr MessageType kType = MessageType::USER_FRIENDS_RESPONSE;
+    QVariantList friends;
+    ListSyncInfo sync;
+
+    static FriendListPayload decode(const NetMessage &message);
+};
+
+// 每项为{userId, username, online}
+struct UserListPayload {
+    static constexpr MessageType kType = MessageType::USER_LIST_RESPONSE;
+    QVariantList users;
+    ListSyncInfo sync;
+
+    static UserListPayload decode(const NetMessage &message);
+};
+
+// 用户目录搜索的一页，每项为{userId, username, online}，nextCursor为空表示没有更多结果
+struct UserSearchPayload {
+    static constexpr MessageType kType = MessageType::SEARCH_USERS_RESPONSE;
+    QString prefix;
+    QVariantList users;
+    QString nextCursor;
+
+    static UserSearchPayload decode(const NetMessage &message);
+};
+
+// 群组，列表每项为{groupId, groupName, memberCount}
+struct GroupListPayload {
+    static constexpr MessageType kType = MessageType::GROUP_LIST_RESPONSE;
+    QVariantList groups;
+    ListSyncInfo sync;
+
+    static GroupListPayload decode(const NetMessage &message);
+};
+
+struct GroupCreatedPayload {
+    static constexpr MessageType kType = MessageType::CREATE_GROUP_RESPONSE;
+    QString groupId;
+    QString groupName;
+
+    static GroupCreatedPayload decode(const NetMessage &message);
+};
+
+struct GroupJoinedPayload {
+    static constexpr MessageType kType = MessageType::JOIN_GROUP_RESPONSE;
+    QString groupId;
+    QString groupName;
+
+    static GroupJoinedPayload decode(const NetMessage &message);
+};
+
+struct GroupLeftPayload {
+    static constexpr MessageType kType = MessageType::LEAVE_GROUP_RESPONSE;
+    QString groupId;
+
+    static GroupLeftPayload decode(const NetMessage &message);
+};
+
+// 成员每项为{userId, username, role}
+struct GroupMembersPayload {
+    static constexpr MessageType kType = MessageType::GROUP_MEMBERS_RESPONSE;
+    QString groupId;
+    QVariantList members;
+
+    static GroupMembersPayload decode(const NetMessage &message);
+};
+
+// 消息每项为{messageId, fromUserId, fromUsername, content, timestamp}
+struct ChatHistoryPayload {
+    static constexpr MessageType kType = MessageType::CHAT_HISTORY_RESPONSE;
+    QString type;
+    QString targetId;
+    QVariantList messages;
+
+    static ChatHistoryPayload decode(const NetMessage &message);
+};
+
+// 消息状态
+struct MessageRecalledPayload {
+    static constexpr MessageType kType = MessageType::RECALL_MESSAGE_RESPONSE;
+    QString messageId;
+    QString type;
+    QString targetId;
+
+    static MessageRecalledPayload decode(const NetMessage &message);
+};
+
+struct MessageReadPayload {
+    static constexpr MessageType kType = MessageType::MARK_MESSAGE_READ_RESPONSE;
+    QString messageId;
+
+    static MessageReadPayload decode(const NetMessage &message);
+};
+
+#endif // PROTOCOLMESSAGES_H
@@ -0,0 +1,59 @@
+#ifndef RECENTCHATSINDEX_H
+#define RECENTCHATSINDEX_H
+
+#include <QString>
+#include <QHash>
+#include <QJsonArray>
+#include <list>
+
+/**
+ * @brief 最近聊天列表的内存索引
+ * 按chatId索引，链表按最后活动时间排列，新消息和已读操作都是O(1)更新
+ * 未读只保存计数，打开会话或读到其中的消息时整体清零
+ * 只在ChatHistoryManager所在的界面线程中使用，持久化由调用方延迟批量写入
+ */
+class RecentChatsIndex
+{
+public:
+    struct Entry {
+        QString chatId;
+        QString chatName;
+        QString lastMessage;
+        qint64 lastMessageTime = 0;
+        bool isGroup = false;
+        int unreadCount = 0;
+    };
+
+    explicit RecentChatsIndex(int maxChats = 50);
+
+    // 记录会话的新消息并移到最前，unread为true时未读数加一
+    const Entry &touch(const QString &chatId, bool isGroup, const QString &chatName,
+                       const QString &lastMessage, qint64 time, bool unread = false);
+
+    // 会话全部已读，未读数变化时返回true
+    bool markAllRead(const QString &chatId, bool isGroup);
+
+    int unreadCount(const QString &chatId, bool isGroup) const;
+    int totalUnreadCount() const { return m_totalUnread; }
+
+    void remove(const QString &chatId, bool isGroup);
+    void clear();
+
+    // 序列化，count小于0表示全部
+    QJsonArray toJson(int count = -1) const;
+    // 合并从磁盘读出的列表，内存中已有的会话以内存为准
+    void merge(const QJsonArray &chats);
+
+    int size() const { return static_cast<int>(m_entries.size()); }
+
+private:
+    int m_maxChats;
+    int m_totalUnread;
+    std::list<Entry> m_entries;         // 表头为最近活动的会话
+    QHash<QString, std::list<Entry>::iterator> m_positions;
+
+    static QString key(const QString &chatId, bool isGroup);
+    void trim();
+};
+
+#endif // RECENTCHATSINDEX_H
@@ -0,0 +1,52 @@
+#ifndef USERDIRECTORYCACHE_H
+#define USERDIRECTORYCACHE_H
+
+#include <QString>
+#include <QList>
+#include <QHash>
+#include <QSet>
+#include <QVariantMap>
+
+/**
+ * @brief 已搜索到的用户目录缓存
+ * 用户按小写用户名排序保存，前缀查询用二分查找定位到第一个匹配项后顺序读取，
+ * 不需要遍历整个缓存；记录服务器已完整返回过的前缀，
+ * 这些前缀及其延长的前缀可以直接用本地结果回答
+ * 只在界面线程中使用，不做加锁
+ */
+class UserDirectoryCache
+{
+public:
+    explicit UserDirectoryCache(int maxEntries = 50000);
+
+    // 加入服务器返回的用户，已存在的按userId更新
+    void insert(const QVariantList &users);
+
+    // 按前缀读取最多limit个用户，after非空时从该排序键之后开始
+    QVariantList search(const QString &prefix, int limit, const QString &after = QString()) const;
+
+    // 前缀的全部结果都已在缓存中
+    void markComplete(const QString &prefix);
+    bool isComplete(const QString &prefix) const;
+
+    // 分页用的排序键
+    static QString sortKey(const QVariantMap &user);
+
+    int size() const { return m_entries.size(); }
+    void clear();
+
+private:
+    struct Entry {
+        QString key;        // 小写用户名 + '\x1f' + userId，保证唯一且按用户名排序
+        QVariantMap user;
+    };
+
+    int m_maxEntries;
+    QList<Entry> m_entries;                 // 按key排序
+    QHash<QString, QString> m_keysByUserId;
+    QSet<QString> m_completePrefixes;
+
+    qsizetype lowerBound(const QString &key) const;
+};
+
+#endif // USERDIRECTORYCACHE_H
@@ -11,6 +11,8 @@
 #include "include/Message.h"
 #include "include/MessageType.h"
 #include "include/ChatHistoryManager.h"
+#include "include/MessageListModel.h"
+#include "include/ContactListModel.h"
 
 int main(int argc, char *argv[])
 {
@@ -22,6 +24,8 @@ int main(int argc, char *argv[])
     qmlRegisterType<ChatController>("SQChat", 1, 0, "ChatController");
     qmlRegisterType<Message>("SQChat", 1, 0, "Message");
     qmlRegisterType<ChatHistoryManager>("SQChat", 1, 0, "ChatHistoryManager");
+    qmlRegisterUncreatableType<MessageListModel>("SQChat", 1, 0, "MessageListModel", "由ChatController提供");
+    qmlRegisterUncreatableType<ContactListModel>("SQChat", 1, 0, "ContactListModel", "由ChatController提供");
     
     // 注册枚举类型 - MessageType
     qmlRegisterUncreatableMetaObject(
@@ -45,6 +45,9 @@ Dialog {
                 font.pixelSize: 14
                 color: "#212529"
                 selectByMouse: true
+
+                // 输入停顿后按前缀搜索用户
+                onTextChanged: searchTimer.restart()
                 
                 Text {
                     anchors.left: parent.left
@@ -59,7 +62,7 @@ Dialog {
         
         // 用户列表
         Text {
-            text: "或从在线用户中选择："
+            text: "或从搜索结果中选择："
             font.pixelSize: 14
             color: "#666"
         }
@@ -71,9 +74,19 @@ Dialog {
             ListView {
                 id: usersListView
                 width: parent.width
-                model: chatController.usersList
+                model: chatController.userSearchModel
+
+                // 滚动到末尾时读取下一页
+                onAtYEndChanged: {
+                    if (atYEnd && count > 0 && chatController.userSearchCursor !== "") {
+                        chatController.searchUsers(friendIdInput.text.trim(), 50, chatController.userSearchCursor)
+                    }
+                }
                 
                 delegate: Rectangle {
+                    required property string userId
+                    required property string username
+
                     width: usersListView.width
                     height: 40
                     color: userMouseArea.containsMouse ? "#f8f9fa" : "transparent"
@@ -88,7 +101,7 @@ Dialog {
                             font.pixelSize: 16
                         }
                           Text {
-                            text: modelData.username + " (ID: " + modelData.userId + ")"
+                            text: username + " (ID: " + userId + ")"
                             font.pixelSize: 14
                             color: "#212529"
                             Layout.fillWidth: true
@@ -111,7 +124,7 @@ Dialog {
                             }
                             
                             onClicked: {
-                                friendIdInput.text = modelData.username
+                                friendIdInput.text = username
                             }
                         }
                     }
@@ -121,7 +134,7 @@ Dialog {
                         anchors.fill: parent
                         hoverEnabled: true
                         onClicked: {
-                            friendIdInput.text = modelData.username
+                            friendIdInput.text = username
                         }
                     }
                 }
@@ -175,9 +188,16 @@ Dialog {
         }
     }
     
+    Timer {
+        id: searchTimer
+        interval: 200
+        repeat: false
+        onTriggered: chatController.searchUsers(friendIdInput.text.trim(), 50)
+    }
+
     onOpened: {
-        // 打开对话框时获取用户列表
-        chatController.getUsersList()
+        // 打开对话框时只取第一页，之后按输入的前缀搜索
+        chatController.searchUsers(friendIdInput.text.trim(), 50)
         friendIdInput.focus = true
     }
     
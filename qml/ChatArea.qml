@@ -13,89 +13,62 @@ Rectangle {
     
     signal typingChanged(bool typing)
     
-    // 消息数据模型
-    ListModel {
-        id: messagesModel
-    }
+    // 消息数据模型，由ChatController直接从本地历史和服务器推送填充
+    readonly property var messagesModel: chatController.messageModel
     
     // 监听聊天消息
     Connections {
         target: chatController
         
         function onPrivateMessageReceived(fromUserId, fromUsername, content, messageId, timestamp) {
-            // 只显示当前聊天的消息
+            // 消息已加入当前会话的模型，这里只处理已读
             if (fromUserId === chatArea.currentChatId) {
-                addMessage({
-                    messageId: messageId,
-                    text: content,
-                    isOwn: false,
-                    timestamp: formatTimestamp(timestamp),
-                    status: "delivered",
-                    fromUserId: fromUserId,
-                    fromUsername: fromUsername
-                })
-                
-                // 自动标记为已读
                 chatController.markMessageRead(messageId, "private", fromUserId)
             }
         }
         
-        function onChatHistoryReceived(type, targetId, messages) {
+        function onLocalChatHistoryLoaded(type, targetId, count) {
             if (type === "private" && targetId === chatArea.currentChatId) {
-                messagesModel.clear()
-                
-                // 按时间排序并添加到模型
-                var sortedMessages = messages.sort(function(a, b) {
-                    return parseInt(a.timestamp) - parseInt(b.timestamp)
-                })
-                
-                for (var i = 0; i < sortedMessages.length; i++) {
-                    var msg = sortedMessages[i]
-                    messagesModel.append({
-                        messageId: msg.id,
-                        text: msg.content,
-                        isOwn: msg.from === "self", // 需要根据实际用户ID判断
-                        timestamp: formatTimestamp(msg.timestamp),
-                        status: "read",
-                        fromUserId: msg.from,
-                        fromUsername: msg.from                    })
-                }
-                  // onCountChanged会自动处理滚动
-            }
-        }
-        
-        function onLocalChatHistoryLoaded(type, targetId, messages) {
-            if (type === "private" && targetId === chatArea.currentChatId) {
-                messagesModel.clear()
-                
-                // 按时间排序并添加到模型
-                var sortedMessages = messages.sort(function(a, b) {
-                    return parseInt(a.timestamp) - parseInt(b.timestamp)
-                })
-                
-                for (var i = 0; i < sortedMessages.length; i++) {
-                    var msg = sortedMessages[i]
-                    // 判断消息是否被撤回
-                    var messageText = msg.recalled ? "[消息已撤回]" : msg.content
-                    
-                    messagesModel.append({
-                        messageId: msg.messageId,
-                        text: messageText,
-                        isOwn: msg.fromUserId === globalAuthController.currentUserId, // 根据发送者判断
-                        timestamp: formatTimestamp(msg.timestamp),
-                        status: msg.isRead ? "read" : "delivered",
-                        fromUserId: msg.fromUserId,
-                        fromUsername: msg.fromUserId, // 这里可以后续优化为显示用户名
-                        recalled: msg.recalled || false
-                    })
-                }
-                  console.log("本地聊天记录加载完成，消息数量:", messages.length)
+                console.log("本地聊天记录加载完成，消息数量:", count)
+                // 第一页不满一页说明已经是全部记录
+                chatArea.hasOlderHistory = count >= chatArea.historyPageSize
                 // 加载完成后滚动到底部
                 Qt.callLater(function() {
                     scrollToBottom()
                 })
             }
         }
+
+        function onOlderChatHistoryLoaded(type, targetId, count, hasMore) {
+            if (type !== "private" || targetId !== chatArea.currentChatId) {
+                chatArea.isLoadingOlder = false
+                return
+            }
+            chatArea.hasOlderHistory = hasMore
+
+            // 整页已插入到列表顶部，保持当前可见位置不跳动
+            var previousHeight = chatArea.heightBeforeOlder
+            chatArea.isLoadingOlder = false
+            Qt.callLater(function() {
+                messageListView.contentY += messageListView.contentHeight - previousHeight
+            })
+        }
+    }
+
+    // 向前翻页加载更早的本地记录
+    readonly property int historyPageSize: 50
+    property bool hasOlderHistory: false
+    property bool isLoadingOlder: false
+    property real heightBeforeOlder: 0
+
+    function loadOlderHistory() {
+        if (!hasOlderHistory || isLoadingOlder || messagesModel.count === 0) {
+            return
+        }
+        isLoadingOlder = true
+        heightBeforeOlder = messageListView.contentHeight
+        chatController.loadOlderChatHistory("private", currentChatId,
+                                            messagesModel.firstMessageId(), historyPageSize)
     }
       // 强制滚动到底部的函数
     function scrollToBottom() {
@@ -110,14 +83,6 @@ Rectangle {
         }
     }
     
-    // 添加新消息的函数，带自动滚动
-    function addMessage(messageData) {
-        messagesModel.append(messageData)
-        Qt.callLater(function() {
-            scrollToBottom()
-        })
-    }
-    
     ColumnLayout {
         anchors.fill: parent
         spacing: 0
@@ -190,10 +155,19 @@ Rectangle {
                     if (!atBottom && userScrolling) {
                         scrollToBottomTimer.stop()
                     }
+
+                    // 滚动到顶部时加载更早的消息
+                    if (userScrolling && atYBeginning) {
+                        chatArea.loadOlderHistory()
+                    }
                 }
                 
                 // 只有在用户没有手动滚动且在底部时才自动滚动
                 onCountChanged: {
+                    // 顶部插入的历史页不触发自动滚动
+                    if (chatArea.isLoadingOlder) {
+                        return
+                    }
                     if (count > 0 && (!userScrolling || atBottom)) {
                         scrollToBottomTimer.start()
                     }
@@ -281,10 +255,10 @@ Rectangle {
         if (currentChatId && !isLoadingHistory && globalChatHistoryManager.getCurrentUserId() !== "") {
             console.log("Loading local chat history for:", currentChatId)
             isLoadingHistory = true
-            // 清空当前消息列表
-            messagesModel.clear()
+            // 切换模型显示的会话并清空当前消息列表
+            chatController.openChat("private", currentChatId)
             // 加载本地聊天历史
-            chatController.loadLocalChatHistory("private", currentChatId, 50)
+            chatController.loadLocalChatHistory("private", currentChatId, historyPageSize)
             // 延迟重置标志
             loadingTimer.start()
         } else {
@@ -300,18 +274,6 @@ Rectangle {
         }
     }
     
-    // 时间戳格式化函数
-    function formatTimestamp(timestamp) {
-        var date = new Date(parseInt(timestamp))
-        var hours = date.getHours()
-        var minutes = date.getMinutes()
-        var ampm = hours >= 12 ? 'PM' : 'AM'
-        hours = hours % 12
-        hours = hours ? hours : 12
-        minutes = minutes < 10 ? '0' + minutes : minutes
-        return hours + ':' + minutes + ' ' + ampm
-    }
-    
     // 发送消息函数
     function sendMessage(text) {
         console.log("ChatArea.sendMessage called with:", text)
@@ -322,47 +284,12 @@ Rectangle {
             return
         }
         
-        var currentTime = new Date()
-        var timeString = formatTimestamp(currentTime.getTime())
-          // 先添加到本地消息列表
-        addMessage({
-            messageId: "local_" + Date.now(),
-            text: text,
-            isOwn: true,
-            timestamp: timeString,
-            status: "sending"
-        })
-        
-        // 发送到服务器
+        // 消息以sending状态加入列表，写入socket后由发送回调更新状态
         console.log("Sending private message to:", currentChatId, "content:", text)
         chatController.sendPrivateMessage(currentChatId, text)
-        
-        // 模拟发送状态更新
-        sendStatusTimer.start()
-    }
-    
-    Timer {
-        id: sendStatusTimer
-        interval: 1000
-        repeat: false
-        onTriggered: {
-            if (messagesModel.count > 0) {
-                messagesModel.setProperty(messagesModel.count - 1, "status", "sent")
-                // 再延迟更新为已送达
-                deliveredTimer.start()
-            }
-        }
-    }
-    
-    Timer {
-        id: deliveredTimer
-        interval: 2000
-        repeat: false
-        onTriggered: {
-            if (messagesModel.count > 0) {
-                messagesModel.setProperty(messagesModel.count - 1, "status", "delivered")
-            }
-        }
+        Qt.callLater(function() {
+            scrollToBottom()
+        })
     }
     
     // 组件完成时的初始化
@@ -400,8 +327,9 @@ Rectangle {
         onTriggered: {
             if (currentChatId && globalChatHistoryManager.getCurrentUserId() !== "") {
                 console.log("重新加载当前聊天记录:", currentChatId)
+                chatController.openChat("private", currentChatId)
                 messagesModel.clear()
-                chatController.loadLocalChatHistory("private", currentChatId, 50)
+                chatController.loadLocalChatHistory("private", currentChatId, historyPageSize)
             }
         }
     }
@@ -21,7 +21,7 @@ Rectangle {
         target: chatController
         
         function onFriendsListChanged() {
-            console.log("好友列表更新，共", chatController.friendsList.length, "个好友")
+            console.log("好友列表更新，共", chatController.friendsModel.count, "个好友")
         }
         
         function onFriendAdded(friendId, username) {
@@ -148,27 +148,31 @@ Rectangle {
             ListView {
                 id: contactListView
                 width: parent.width
-                model: chatController.friendsList
+                model: chatController.friendsModel
                 spacing: 4
                   delegate: ContactItem {
+                    required property string userId
+                    required property string username
+                    required property bool online
+                    required property int unreadCount
+
                     width: contactListView.width
                     contactData: {
                         // 转换好友数据格式以适配ContactItem
                         return {
-                            "contactId": modelData.userId,
-                            "name": modelData.username,
+                            "contactId": userId,
+                            "name": username,
                             "lastMessage": "点击开始聊天...",
                             "timestamp": "",
-                            "unreadCount": 0,
-                            "isOnline": modelData.online,
+                            "unreadCount": unreadCount,
+                            "isOnline": online,
                             "avatar": "👤"
                         }
                     }
-                    isSelected: modelData.userId === sidebar.currentChatId
+                    isSelected: userId === sidebar.currentChatId
                       onClicked: {
-                        console.log("ContactItem clicked - userId:", modelData.userId, "username:", modelData.username)
-                        console.log("Full modelData:", JSON.stringify(modelData))
-                        sidebar.chatSelected(modelData.userId, modelData.username)
+                        console.log("ContactItem clicked - userId:", userId, "username:", username)
+                        sidebar.chatSelected(userId, username)
                     }
                 }
                 
@@ -227,7 +231,7 @@ Rectangle {
                 
                 Item { Layout.fillWidth: true }
                   Text {
-                    text: chatController.friendsList.length + " 个好友"
+                    text: chatController.friendsModel.count + " 个好友"
                     font.pixelSize: 12
                     color: "#6c757d"
                 }
@@ -6,9 +6,7 @@ AuthController::AuthController(QObject *parent)
     , m_networkManager(nullptr)
     , m_ownNetworkManager(false)
     , m_isLoggedIn(false)
-    , m_pendingOperation(PendingOperation::None)
 {
-    initializeComponents();
 }
 
 AuthController::~AuthController()
@@ -18,15 +16,6 @@ AuthController::~AuthController()
     }
 }
 
-void AuthController::initializeComponents()
-{
-    // 初始化操作超时定时器
-    m_operationTimer = std::make_unique<QTimer>(this);
-    m_operationTimer->setSingleShot(true);
-    connect(m_operationTimer.get(), &QTimer::timeout, 
-            this, &AuthController::onOperationTimeout);
-}
-
 bool AuthController::isConnected() const
 {
     return m_networkManager ? m_networkManager->isConnected() : false;
@@ -53,10 +42,12 @@ void AuthController::setNetworkManager(NetworkManager *networkManager)
                 this, &AuthController::onNetworkDisconnected);
         connect(m_networkManager, &NetworkManager::connectionError,
                 this, &AuthController::onNetworkError);
-        connect(m_networkManager, &NetworkManager::messageReceived,
-                this, &AuthController::onMessageReceived);
         connect(m_networkManager, &NetworkManager::connectedChanged,
                 this, &AuthController::connectionStateChanged);
+        connect(m_networkManager, &NetworkManager::sessionResumed,
+                this, &AuthController::onSessionResumed);
+        connect(m_networkManager, &NetworkManager::sessionResumeFailed,
+                this, &AuthController::onSessionResumeFailed);
     }
     
     emit connectionStateChanged();
@@ -89,19 +80,14 @@ void AuthController::login(const QString &username, const QString &password)
         return;
     }
     
-    if (m_pendingOperation != PendingOperation::None) {
-        emit loginFailed("有操作正在进行中，请稍后再试");
-        return;
-    }
-    
     QVariantMap data;
     data["username"] = username;
     data["password"] = password;
     
-    m_networkManager->sendMessage(MessageType::LOGIN_REQUEST, data);
-    
-    setPendingOperation(PendingOperation::Login);
-    startOperationTimer();
+    m_networkManager->request(MessageType::LOGIN_REQUEST, data, MessageType::LOGIN_RESPONSE, kOperationTimeoutMs)
+        .then(this, [this](const NetMessage &response) {
+            handleLoginResponse(response);
+        });
     
     qDebug() << "Login request sent for user:" << username;
 }
@@ -122,10 +108,10 @@ void AuthController::logout()
     QVariantMap data;
     data["userId"] = m_currentUserId;
     
-    m_networkManager->sendMessage(MessageType::LOGOUT_REQUEST, data);
-    
-    setPendingOperation(PendingOperation::Logout);
-    startOperationTimer();
+    m_networkManager->request(MessageType::LOGOUT_REQUEST, data, MessageType::LOGOUT_RESPONSE, kOperationTimeoutMs)
+        .then(this, [this](const NetMessage &response) {
+            handleLogoutResponse(response);
+        });
     
     qDebug() << "Logout request sent for user:" << m_currentUserId;
 }
@@ -138,21 +124,16 @@ void AuthController::registerUser(const QString &username, const QString &email,
         return;
     }
     
-    if (m_pendingOperation != PendingOperation::None) {
-        emit registerFailed("有操作正在进行中，请稍后再试");
-        return;
-    }
-    
     QVariantMap data;
     data["username"] = username;
     data["email"] = email;
     data["password"] = password;
     data["code"] = verifyCode;
     
-    m_networkManager->sendMessage(MessageType::REGISTER_REQUEST, data);
-    
-    setPendingOperation(PendingOperation::Register);
-    startOperationTimer();
+    m_networkManager->request(MessageType::REGISTER_REQUEST, data, MessageType::REGISTER_RESPONSE, kOperationTimeoutMs)
+        .then(this, [this](const NetMessage &response) {
+            handleRegisterResponse(response);
+        });
     
     qDebug() << "Register request sent for user:" << username << "email:" << email;
 }
@@ -164,18 +145,13 @@ void AuthController::sendVerifyCode(const QString &email)
         return;
     }
     
-    if (m_pendingOperation != PendingOperation::None) {
-        emit verifyCodeFailed("有操作正在进行中，请稍后再试");
-        return;
-    }
-    
     QVariantMap data;
     data["email"] = email;
     
-    m_networkManager->sendMessage(MessageType::VERIFY_CODE_REQUEST, data);
-    
-    setPendingOperation(PendingOperation::VerifyCode);
-    startOperationTimer();
+    m_networkManager->request(MessageType::VERIFY_CODE_REQUEST, data, MessageType::VERIFY_CODE_RESPONSE, kOperationTimeoutMs)
+        .then(this, [this](const NetMessage &response) {
+            handleVerifyCodeResponse(response);
+        });
     
     qDebug() << "Verify code request sent for email:" << email;
 }
@@ -189,79 +165,50 @@ void AuthController::onNetworkConnected()
 void AuthController::onNetworkDisconnected()
 {
     qDebug() << "Network disconnected";
-    resetUserState();
+    
+    // 正在自动重连且可以恢复会话时保留登录状态，避免重新加载好友和历史
+    bool canResume = m_isLoggedIn && m_networkManager
+                     && m_networkManager->hasSession() && m_networkManager->isReconnecting();
+    if (!canResume) {
+        resetUserState();
+    }
     emit disconnected();
 }
 
-void AuthController::onNetworkError(const QString &error)
+void AuthController::onSessionResumed()
 {
-    qDebug() << "Network error:" << error;
-    
-    // 如果有正在进行的操作，报告错误
-    if (m_pendingOperation != PendingOperation::None) {
-        stopOperationTimer();
-        
-        switch (m_pendingOperation) {
-        case PendingOperation::Login:
-            emit loginFailed(QString("网络错误: %1").arg(error));
-            break;
-        case PendingOperation::Logout:
-            emit logoutFailed(QString("网络错误: %1").arg(error));
-            break;
-        case PendingOperation::Register:
-            emit registerFailed(QString("网络错误: %1").arg(error));
-            break;
-        case PendingOperation::VerifyCode:
-            emit verifyCodeFailed(QString("网络错误: %1").arg(error));
-            break;
-        default:
-            break;
-        }
-        
-        m_pendingOperation = PendingOperation::None;
-    }
-    
-    emit connectionError(error);
+    qDebug() << "Session resumed for user:" << m_currentUserId;
+    emit sessionResumed();
 }
 
-void AuthController::onMessageReceived(const Message *message)
+void AuthController::onSessionResumeFailed(const QString &reason)
 {
-    if (!message) return;
-    
-    switch (message->type()) {
-    case MessageType::LOGIN_RESPONSE:
-        handleLoginResponse(message);
-        break;
-    case MessageType::LOGOUT_RESPONSE:
-        handleLogoutResponse(message);
-        break;
-    case MessageType::REGISTER_RESPONSE:
-        handleRegisterResponse(message);
-        break;
-    case MessageType::VERIFY_CODE_RESPONSE:
-        handleVerifyCodeResponse(message);
-        break;
-    default:
-        // 其他类型的消息不在此处处理
-        break;
-    }
+    qDebug() << "Session expired:" << reason;
+    resetUserState();
+    emit sessionExpired(reason);
 }
 
-void AuthController::handleLoginResponse(const Message *message)
+void AuthController::onNetworkError(const QString &error)
 {
-    if (m_pendingOperation != PendingOperation::Login) {
-        return;
-    }
-    
-    stopOperationTimer();
-    m_pendingOperation = PendingOperation::None;
+    qDebug() << "Network error:" << error;
     
-    QString status = message->getData("status").toString();
+    emit connectionError(error);
+}
+
+void AuthController::handleLoginResponse(const NetMessage &message)
+{
+    QString status = message.string("status");
       if (status == "0") {
         // 登录成功
         m_isLoggedIn = true;
-        m_currentUserId = message->getData("userId").toString();
-        m_currentUsername = message->getData("username").toString();
+        m_currentUserId = message.string("userId");
+        m_currentUsername = message.string("username");
+        
+        // 旧服务器不返回令牌，此时断线后需要重新登录
+        QString sessionToken = message.string("sessionToken");
+        if (!sessionToken.isEmpty() && m_networkManager) {
+            m_networkManager->setSession(m_currentUserId, sessionToken);
+        }
         
         emit loginStateChanged();
         emit currentUserChanged();
@@ -272,104 +219,63 @@ void AuthController::handleLoginResponse(const Message *message)
                  << "Username:" << m_currentUsername;
     } else {
         // 登录失败
-        QString errorMessage = message->getData("message", "登录失败").toString();
+        QString errorMessage = message.string("message", "登录失败");
         emit loginFailed(errorMessage);
         
         qDebug() << "Login failed:" << errorMessage;
     }
 }
 
-void AuthController::handleLogoutResponse(const Message *message)
+void AuthController::handleLogoutResponse(const NetMessage &message)
 {
-    if (m_pendingOperation != PendingOperation::Logout) {
-        return;
-    }
-    
-    stopOperationTimer();
-    m_pendingOperation = PendingOperation::None;
-    
-    QString status = message->getData("status").toString();
+    QString status = message.string("status");
     
     if (status == "0") {
         resetUserState();
         emit logoutSuccess();
         qDebug() << "Logout successful";
     } else {
-        QString errorMessage = message->getData("message", "登出失败").toString();
+        QString errorMessage = message.string("message", "登出失败");
         emit logoutFailed(errorMessage);
         qDebug() << "Logout failed:" << errorMessage;
     }
 }
 
-void AuthController::handleRegisterResponse(const Message *message)
+void AuthController::handleRegisterResponse(const NetMessage &message)
 {
-    if (m_pendingOperation != PendingOperation::Register) {
-        return;
-    }
-    
-    stopOperationTimer();
-    m_pendingOperation = PendingOperation::None;
-    
-    QString status = message->getData("status").toString();
+    QString status = message.string("status");
     
     if (status == "0") {
-        QString userId = message->getData("userid").toString(); // 注意这里是userid，不是userId
+        QString userId = message.string("userid"); // 注意这里是userid，不是userId
         emit registerSuccess(userId);
         qDebug() << "Register successful. User ID:" << userId;
     } else {
-        QString errorMessage = message->getData("message", "注册失败").toString();
+        QString errorMessage = message.string("message", "注册失败");
         emit registerFailed(errorMessage);
         qDebug() << "Register failed:" << errorMessage;
     }
 }
 
-void AuthController::handleVerifyCodeResponse(const Message *message)
+void AuthController::handleVerifyCodeResponse(const NetMessage &message)
 {
-    if (m_pendingOperation != PendingOperation::VerifyCode) {
-        return;
-    }
-    
-    stopOperationTimer();
-    m_pendingOperation = PendingOperation::None;
-    
-    QString status = message->getData("status").toString();
+    QString status = message.string("status");
     
     if (status == "0") {
         emit verifyCodeSent();
         qDebug() << "Verify code sent successfully";
     } else {
-        QString errorMessage = message->getData("message", "验证码发送失败").toString();
+        QString errorMessage = message.string("message", "验证码发送失败");
         emit verifyCodeFailed(errorMessage);
         qDebug() << "Verify code sending failed:" << errorMessage;
     }
 }
 
-void AuthController::onOperationTimeout()
+void AuthController::resetUserState()
 {
-    qWarning() << "Operation timeout";
-    
-    switch (m_pendingOperation) {
-    case PendingOperation::Login:
-        emit loginFailed("操作超时，请检查网络连接");
-        break;
-    case PendingOperation::Logout:
-        emit logoutFailed("操作超时，请检查网络连接");
-        break;
-    case PendingOperation::Register:
-        emit registerFailed("操作超时，请检查网络连接");
-        break;
-    case PendingOperation::VerifyCode:
-        emit verifyCodeFailed("操作超时，请检查网络连接");
-        break;
-    default:
-        break;
+    if (m_networkManager) {
+        m_networkManager->clearSession();
     }
     
-    m_pendingOperation = PendingOperation::None;
-}
-
-void AuthController::resetUserState()
-{
     if (m_isLoggedIn) {
         m_isLoggedIn = false;
         emit loginStateChanged();
@@ -381,20 +287,3 @@ void AuthController::resetUserState()
         emit currentUserChanged();
     }
 }
-
-void AuthController::startOperationTimer(int timeoutMs)
-{
-    m_operationTimer->start(timeoutMs);
-}
-
-void AuthController::stopOperationTimer()
-{
-    if (m_operationTimer->isActive()) {
-        m_operationTimer->stop();
-    }
-}
-
-void AuthController::setPendingOperation(PendingOperation operation)
-{
-    m_pendingOperation = operation;
-}
\ No newline at end of file
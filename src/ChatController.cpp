@@ -3,7 +3,10 @@
 #include "include/MessageType.h"
 #include "include/Message.h"
 #include "include/ChatHistoryManager.h"
+#include "include/ProtocolMessages.h"
 #include <QDebug>
+#include <QDateTime>
+#include <QPointer>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonArray>
@@ -12,20 +15,32 @@ ChatController::ChatController(QObject *parent)
     : QObject(parent)
     , m_networkManager(nullptr)
     , m_chatHistoryManager(nullptr)
+    , m_messageModel(new MessageListModel(this))
+    , m_friendsModel(new ContactListModel("userId", {"userId", "username", "online", "unreadCount"}, this))
+    , m_groupsModel(new ContactListModel("groupId", {"groupId", "groupName", "memberCount"}, this))
+    , m_usersModel(new ContactListModel("userId", {"userId", "username", "online"}, this))
+    , m_userSearchModel(new ContactListModel("userId", {"userId", "username", "online"}, this))
+    , m_localMessageSeq(0)
 {
+    // 列表增量频繁到达时合并保存，避免每次都转换并重写整个列表
+    m_listSaveTimer = std::make_unique<QTimer>(this);
+    m_listSaveTimer->setSingleShot(true);
+    m_listSaveTimer->setInterval(kListSaveDelayMs);
+    connect(m_listSaveTimer.get(), &QTimer::timeout,
+            this, &ChatController::saveDirtyContactLists);
 }
 
 void ChatController::setNetworkManager(NetworkManager *manager)
 {
     if (m_networkManager) {
         disconnect(m_networkManager, nullptr, this, nullptr);
+        m_networkManager->dispatcher().unsubscribe(this);
     }
     
     m_networkManager = manager;
     
     if (m_networkManager) {
-        connect(m_networkManager, &NetworkManager::messageReceived, 
-                this, &ChatController::handleNetworkMessage);
+        subscribeMessages(m_networkManager->dispatcher());
         connect(m_networkManager, &NetworkManager::connected, 
                 this, &ChatController::handleNetworkConnected);
         connect(m_networkManager, &NetworkManager::disconnected, 
@@ -33,6 +48,29 @@ void ChatController::setNetworkManager(NetworkManager *manager)
     }
 }
 
+void ChatController::subscribeMessages(MessageDispatcher &dispatcher)
+{
+    // 每种服务器推送只由一个处理函数接收，消息先解码为对应的结构
+    dispatcher.subscribe(this, &ChatController::handleLoginResponse);
+    dispatcher.subscribe(this, &ChatController::handleError);
+    dispatcher.subscribe(this, &ChatController::handlePrivateChat);
+    dispatcher.subscribe(this, &ChatController::handleGroupChat);
+    dispatcher.subscribe(this, &ChatController::handleAddFriendResponse);
+    dispatcher.subscribe(this, &ChatController::handleFriendRequest);
+    dispatcher.subscribe(this, &ChatController::handleFriendAccepted);
+    dispatcher.subscribe(this, &ChatController::handleFriendRejected);
+    dispatcher.subscribe(this, &ChatController::handleFriendList);
+    dispatcher.subscribe(this, &ChatController::handleGroupList);
+    dispatcher.subscribe(this, &ChatController::handleGroupCreated);
+    dispatcher.subscribe(this, &ChatController::handleGroupJoined);
+    dispatcher.subscribe(this, &ChatController::handleGroupLeft);
+    dispatcher.subscribe(this, &ChatController::handleGroupMembers);
+    dispatcher.subscribe(this, &ChatController::handleUserList);
+    dispatcher.subscribe(this, &ChatController::handleChatHistory);
+    dispatcher.subscribe(this, &ChatController::handleMessageRecalled);
+    dispatcher.subscribe(this, &ChatController::handleMessageRead);
+}
+
 bool ChatController::isConnected() const
 {
     return m_networkManager && m_networkManager->isConnected();
@@ -48,12 +86,27 @@ void ChatController::sendPrivateMessage(const QString &toUserId, const QString &
     QVariantMap data;
     data["toUserId"] = toUserId;
     data["content"] = content;
+
+    // 本地记录与列表使用同一个ID，向前翻页时可以作为游标
+    qint64 timestamp = QDateTime::currentMSecsSinceEpoch();
+    QString messageId = nextLocalMessageId(timestamp);
       // 保存消息到本地
     if (m_chatHistoryManager && !m_currentUserId.isEmpty()) {
-        m_chatHistoryManager->savePrivateMessage(m_currentUserId, toUserId, content);
+        m_chatHistoryManager->savePrivateMessage(m_currentUserId, toUserId, content, messageId, timestamp);
+    }
+
+    NetworkManager::DeliveryCallback callback;
+    if (m_messageModel->isShowing("private", toUserId)) {
+        m_messageModel->appendMessage(messageId, m_currentUserId, QString(), content, timestamp, "sending");
+        QPointer<MessageListModel> model = m_messageModel;
+        callback = [model, messageId](bool delivered) {
+            if (model) {
+                model->setStatus(messageId, delivered ? "sent" : "failed");
+            }
+        };
     }
     
-    m_networkManager->sendMessage(MessageType::PRIVATE_CHAT, data);
+    m_networkManager->sendMessage(NetMessage(MessageType::PRIVATE_CHAT, data), std::move(callback));
     qDebug() << "Private message sent to:" << toUserId << "content:" << content;
 }
 
@@ -67,15 +120,35 @@ void ChatController::sendGroupMessage(const QString &groupId, const QString &con
     QVariantMap data;
     data["groupId"] = groupId;
     data["content"] = content;
+
+    qint64 timestamp = QDateTime::currentMSecsSinceEpoch();
+    QString messageId = nextLocalMessageId(timestamp);
       // 保存消息到本地
     if (m_chatHistoryManager && !m_currentUserId.isEmpty()) {
-        m_chatHistoryManager->saveGroupMessage(groupId, m_currentUserId, content);
+        m_chatHistoryManager->saveGroupMessage(groupId, m_currentUserId, content, messageId, timestamp);
+    }
+
+    NetworkManager::DeliveryCallback callback;
+    if (m_messageModel->isShowing("group", groupId)) {
+        m_messageModel->appendMessage(messageId, m_currentUserId, QString(), content, timestamp, "sending");
+        QPointer<MessageListModel> model = m_messageModel;
+        callback = [model, messageId](bool delivered) {
+            if (model) {
+                model->setStatus(messageId, delivered ? "sent" : "failed");
+            }
+        };
     }
     
-    m_networkManager->sendMessage(MessageType::GROUP_CHAT, data);
+    m_networkManager->sendMessage(NetMessage(MessageType::GROUP_CHAT, data), std::move(callback));
     qDebug() << "Group message sent to group:" << groupId << "content:" << content;
 }
 
+QString ChatController::nextLocalMessageId(qint64 timestamp)
+{
+    // 同一毫秒内连续发送的消息靠序号区分
+    return QString("%1-%2").arg(timestamp).arg(++m_localMessageSeq);
+}
+
 void ChatController::getFriendsList()
 {
     if (!m_networkManager || !isConnected()) {
@@ -83,8 +156,7 @@ void ChatController::getFriendsList()
         return;
     }
     
-    QVariantMap data; // 空数据
-    m_networkManager->sendMessage(MessageType::GET_USER_FRIENDS, data);
+    requestList(MessageType::GET_USER_FRIENDS, "friends");
     qDebug() << "Friends list requested";
 }
 
@@ -139,6 +211,12 @@ void ChatController::getFriendRequests()
     qDebug() << "Friend requests list requested";
 }
 
+void ChatController::setUserOnline(const QString &userId, bool online)
+{
+    m_friendsModel->setField(userId, "online", online);
+    m_usersModel->setField(userId, "online", online);
+}
+
 void ChatController::getGroupsList()
 {
     if (!m_networkManager || !isConnected()) {
@@ -146,8 +224,7 @@ void ChatController::getGroupsList()
         return;
     }
     
-    QVariantMap data; // 空数据
-    m_networkManager->sendMessage(MessageType::GET_GROUP_LIST, data);
+    requestList(MessageType::GET_GROUP_LIST, "groups");
     qDebug() << "Groups list requested";
 }
 
@@ -199,10 +276,30 @@ void ChatController::getGroupMembers(const QString &groupId)
     
     QVariantMap data;
     data["groupId"] = groupId;
-    m_networkManager->sendMessage(MessageType::GET_GROUP_MEMBERS, data);
+    // 响应按reqId匹配到本次请求，多个群的成员可以同时请求
+    m_networkManager->request(MessageType::GET_GROUP_MEMBERS, data, MessageType::GROUP_MEMBERS_RESPONSE)
+        .then(this, [this, groupId](const NetMessage &response) {
+            if (response.type() == MessageType::ERROR) {
+                emit errorOccurred(response.string("message", "获取群成员失败"));
+                return;
+            }
+            emit groupMembersReceived(groupId, GroupMembersPayload::decode(response).members);
+        });
     qDebug() << "Group members requested for group:" << groupId;
 }
 
+void ChatController::prefetchGroupMembers()
+{
+    if (!m_networkManager || !isConnected()) {
+        return;
+    }
+    
+    const QStringList groupIds = m_groupsModel->keys();
+    for (const QString &groupId : groupIds) {
+        getGroupMembers(groupId);
+    }
+}
+
 void ChatController::getUsersList()
 {
     if (!m_networkManager || !isConnected()) {
@@ -210,11 +307,84 @@ void ChatController::getUsersList()
         return;
     }
     
-    QVariantMap data; // 空数据
-    m_networkManager->sendMessage(MessageType::GET_USER_LIST, data);
+    requestList(MessageType::GET_USER_LIST, "users");
     qDebug() << "Users list requested";
 }
 
+void ChatController::searchUsers(const QString &prefix, int limit, const QString &cursor)
+{
+    limit = qBound(1, limit, 200);
+    const bool firstPage = cursor.isEmpty();
+    m_userSearchPrefix = prefix;
+
+    // 本地游标：该前缀的结果已全部在缓存中，直接从缓存翻页
+    if (cursor.startsWith('@')) {
+        QVariantList users = m_userDirectory.search(prefix, limit, cursor.mid(1));
+        QString next = users.size() == limit ? "@" + UserDirectoryCache::sortKey(users.last().toMap()) : QString();
+        showUserSearchResults(prefix, users, next, true);
+        return;
+    }
+
+    // 先用缓存中已有的结果立即显示，完整时不再请求服务器
+    if (firstPage) {
+        QVariantList users = m_userDirectory.search(prefix, limit);
+        if (m_userDirectory.isComplete(prefix)) {
+            QString next = users.size() == limit ? "@" + UserDirectoryCache::sortKey(users.last().toMap()) : QString();
+            showUserSearchResults(prefix, users, next, false);
+            return;
+        }
+        showUserSearchResults(prefix, users, QString(), false);
+    }
+
+    if (!m_networkManager || !isConnected()) {
+        return;
+    }
+
+    QVariantMap data;
+    data["prefix"] = prefix;
+    data["limit"] = QString::number(limit);
+    if (!firstPage) {
+        data["cursor"] = cursor;
+    }
+    m_networkManager->request(MessageType::SEARCH_USERS, data, MessageType::SEARCH_USERS_RESPONSE)
+        .then(this, [this, prefix, limit, firstPage](const NetMessage &response) {
+            if (response.type() == MessageType::ERROR) {
+                // 不支持搜索的旧服务器超时返回错误，保留本地结果
+                qDebug() << "User search failed:" << response.string("message");
+                return;
+            }
+
+            UserSearchPayload payload = UserSearchPayload::decode(response);
+            m_userDirectory.insert(payload.users);
+            if (firstPage && payload.nextCursor.isEmpty()) {
+                m_userDirectory.markComplete(prefix);
+            }
+
+            // 输入已变化的过期结果只进入缓存
+            if (prefix != m_userSearchPrefix) {
+                return;
+            }
+            if (firstPage) {
+                // 首页与缓存合并后按用户名排序显示
+                showUserSearchResults(prefix, m_userDirectory.search(prefix, limit), payload.nextCursor, false);
+            } else {
+                showUserSearchResults(prefix, payload.users, payload.nextCursor, true);
+            }
+        });
+}
+
+void ChatController::showUserSearchResults(const QString &prefix, const QVariantList &users,
+                                           const QString &nextCursor, bool append)
+{
+    if (append) {
+        m_userSearchModel->applyChanges(users, QStringList());
+    } else {
+        m_userSearchModel->setContacts(users);
+    }
+    m_userSearchCursor = nextCursor;
+    emit userSearchResultsChanged(prefix);
+}
+
 void ChatController::getChatHistory(const QString &type, const QString &targetId, int count)
 {
     if (!m_networkManager || !isConnected()) {
@@ -231,7 +401,15 @@ void ChatController::getChatHistory(const QString &type, const QString &targetId
     }
     data["count"] = QString::number(count);  // 确保count是字符串
     
-    m_networkManager->sendMessage(MessageType::GET_CHAT_HISTORY, data);
+    // 结果按请求时的会话返回，不依赖服务器在响应中回填type和targetId
+    m_networkManager->request(MessageType::GET_CHAT_HISTORY, data, MessageType::CHAT_HISTORY_RESPONSE)
+        .then(this, [this, type, targetId](const NetMessage &response) {
+            if (response.type() == MessageType::ERROR) {
+                emit errorOccurred(response.string("message", "获取聊天记录失败"));
+                return;
+            }
+            emit chatHistoryReceived(type, targetId, ChatHistoryPayload::decode(response).messages);
+        });
     qDebug() << "Chat history requested for type:" << type << "target:" << targetId << "count:" << count;
 }
 
@@ -257,6 +435,11 @@ void ChatController::recallMessage(const QString &messageId, const QString &type
 
 void ChatController::markMessageRead(const QString &messageId, const QString &type, const QString &targetId)
 {
+    // 本地先更新已读标记和未读数，离线时也生效
+    if (m_chatHistoryManager) {
+        m_chatHistoryManager->markMessageAsRead(messageId, targetId, type == "group");
+    }
+
     if (!m_networkManager || !isConnected()) {
         emit errorOccurred("未连接到服务器");
         return;
@@ -275,292 +458,274 @@ void ChatController::markMessageRead(const QString &messageId, const QString &ty
     qDebug() << "Mark message read request sent for:" << messageId;
 }
 
-void ChatController::handleNetworkMessage(const Message *message)
+void ChatController::handleNetworkConnected()
 {
-    if (!message) {
-        qDebug() << "Received null message";
-        return;
+    emit connectedChanged();
+}
+
+void ChatController::handleNetworkDisconnected()
+{
+    emit connectedChanged();
+}
+
+void ChatController::handleLoginResponse(const LoginResponsePayload &payload)
+{
+    if (payload.status == "0") {
+        // 登录成功，服务器会自动发送离线消息，这里只需要等待接收
+        if (payload.offlineMsgCount > 0) {
+            qDebug() << "收到离线消息数量:" << payload.offlineMsgCount;
+        }
+        qDebug() << "Login response received (success)";
+    } else {
+        qDebug() << "Login response received (failed):" << payload.message;
+    }
+}
+
+void ChatController::handleError(const ErrorPayload &payload)
+{
+    QString errorMsg = payload.text();
+    emit errorOccurred(errorMsg);
+    qDebug() << "Server error:" << errorMsg;
+}
+
+void ChatController::handlePrivateChat(const PrivateChatPayload &payload)
+{
+    // 保存接收到的消息到本地
+    if (m_chatHistoryManager && !m_currentUserId.isEmpty()) {
+        m_chatHistoryManager->savePrivateMessage(payload.fromUserId, m_currentUserId, payload.content,
+                                                 payload.messageId, payload.timestamp.toLongLong());
+    }
+
+    if (m_messageModel->isShowing("private", payload.fromUserId)) {
+        m_messageModel->appendMessage(payload.messageId, payload.fromUserId, payload.fromUsername,
+                                      payload.content, payload.timestamp.toLongLong(), "delivered");
     }
     
-    MessageType messageType = message->type();
-    QVariantMap data = message->data();
+    emit privateMessageReceived(payload.fromUserId, payload.fromUsername, payload.content,
+                                payload.messageId, payload.timestamp);
+}
+
+void ChatController::handleGroupChat(const GroupChatPayload &payload)
+{
+    // 保存接收到的群聊消息到本地
+    if (m_chatHistoryManager) {
+        m_chatHistoryManager->saveGroupMessage(payload.groupId, payload.fromUserId, payload.content,
+                                               payload.messageId, payload.timestamp.toLongLong());
+    }
+
+    // 自己发出的群消息已在发送时加入列表
+    if (m_messageModel->isShowing("group", payload.groupId) && payload.fromUserId != m_currentUserId) {
+        m_messageModel->appendMessage(payload.messageId, payload.fromUserId, payload.fromUsername,
+                                      payload.content, payload.timestamp.toLongLong(), "delivered");
+    }
     
-    parseMessage(static_cast<int>(messageType), data);
+    emit groupMessageReceived(payload.groupId, payload.fromUserId, payload.fromUsername,
+                              payload.content, payload.messageId, payload.timestamp);
 }
 
-void ChatController::handleNetworkConnected()
+void ChatController::handleAddFriendResponse(const AddFriendResponsePayload &payload)
 {
-    emit connectedChanged();
+    if (payload.status == "0") {
+        emit friendAdded(payload.friendId, payload.username);
+        qDebug() << "Friend added successfully:" << payload.username;
+    } else {
+        emit errorOccurred(QString("添加好友失败: %1").arg(payload.message));
+        qDebug() << "Add friend failed:" << payload.message;
+    }
 }
 
-void ChatController::handleNetworkDisconnected()
+void ChatController::handleFriendRequest(const FriendRequestPayload &payload)
 {
-    emit connectedChanged();
+    emit friendRequestReceived(payload.fromUserId, payload.fromUsername);
 }
 
-void ChatController::parseMessage(int messageType, const QVariantMap &data)
-{
-    switch (static_cast<MessageType>(messageType)) {        case MessageType::LOGIN_RESPONSE:
-            {
-                QString status = data["status"].toString();
-                if (status == "0") {
-                    // 登录成功，检查是否有离线消息
-                    QString offlineCountStr = data["offlineMsgCount"].toString();
-                    if (!offlineCountStr.isEmpty()) {
-                        int offlineCount = offlineCountStr.toInt();
-                        if (offlineCount > 0) {
-                            qDebug() << "收到离线消息数量:" << offlineCount;
-                            // 这里服务器会自动发送离线消息，我们只需要等待接收
-                        }
-                    }
-                    qDebug() << "Login response received (success)";
-                } else {
-                    QString message = data["message"].toString();
-                    qDebug() << "Login response received (failed):" << message;
-                }
-            }
-            break;
-            
-        case MessageType::ERROR:
-            {
-                QString errorMsg = data.value("errorMsg", data.value("message", "未知错误")).toString();
-                emit errorOccurred(errorMsg);
-                qDebug() << "Server error:" << errorMsg;
-            }
-            break;
-            
-        case MessageType::HEARTBEAT_RESPONSE:
-            // 心跳响应，无需特殊处理
-            break;
-            
-        case MessageType::ADD_FRIEND_RESPONSE:
-            {
-                QString status = data["status"].toString();
-                if (status == "0") {
-                    QString friendId = data["friendId"].toString();
-                    QString username = data["username"].toString();
-                    emit friendAdded(friendId, username);
-                    qDebug() << "Friend added successfully:" << username;
-                } else {
-                    QString message = data["message"].toString();
-                    emit errorOccurred(QString("添加好友失败: %1").arg(message));
-                    qDebug() << "Add friend failed:" << message;
-                }
-            }
-            break;
-              case MessageType::PRIVATE_CHAT:
-            {
-                QString fromUserId = data["fromUserId"].toString();
-                QString fromUsername = data["fromUsername"].toString();
-                QString content = data["content"].toString();
-                QString messageId = data["messageId"].toString();
-                QString timestamp = data["timestamp"].toString();
-                  // 保存接收到的消息到本地
-                if (m_chatHistoryManager && !m_currentUserId.isEmpty()) {
-                    qint64 timestampMs = timestamp.toLongLong();
-                    m_chatHistoryManager->savePrivateMessage(fromUserId, m_currentUserId, content, messageId, timestampMs);
-                }
-                
-                emit privateMessageReceived(fromUserId, fromUsername, content, messageId, timestamp);
-            }
-            break;
-              case MessageType::GROUP_CHAT:
-            {
-                QString groupId = data["groupId"].toString();
-                QString fromUserId = data["fromUserId"].toString();
-                QString fromUsername = data["fromUsername"].toString();
-                QString content = data["content"].toString();
-                QString messageId = data["messageId"].toString();
-                QString timestamp = data["timestamp"].toString();
-                
-                // 保存接收到的群聊消息到本地
-                if (m_chatHistoryManager) {
-                    qint64 timestampMs = timestamp.toLongLong();
-                    m_chatHistoryManager->saveGroupMessage(groupId, fromUserId, content, messageId, timestampMs);
-                }
-                
-                emit groupMessageReceived(groupId, fromUserId, fromUsername, content, messageId, timestamp);
-            }
-            break;
-            
-        case MessageType::ADD_FRIEND_REQUEST:
-            emit friendRequestReceived(
-                data["fromUserId"].toString(),
-                data["fromUsername"].toString()
-            );
-            break;
-              case MessageType::ACCEPT_FRIEND_RESPONSE:
-            emit friendRequestAccepted(
-                data["userId"].toString(),
-                data["username"].toString()
-            );
-            break;
-            
-        case MessageType::REJECT_FRIEND_RESPONSE:
-            emit friendRequestRejected(data["userId"].toString());
-            break;
-              case MessageType::USER_FRIENDS_RESPONSE:
-            {
-                QVariantList friends;
-                // 解析服务器返回的好友列表数据
-                QString friendsJson = data["friends"].toString();
-                QJsonDocument doc = QJsonDocument::fromJson(friendsJson.toUtf8());
-                if (doc.isArray()) {
-                    QJsonArray array = doc.array();
-                    for (const auto &value : array) {
-                        if (value.isObject()) {                            QJsonObject obj = value.toObject();
-                            QVariantMap friendData;
-                            // 处理id字段 - 可能是数字或字符串
-                            QJsonValue idValue = obj["id"];
-                            QString userId;
-                            if (idValue.isDouble()) {
-                                userId = QString::number(idValue.toInt());
-                            } else {
-                                userId = idValue.toString();
-                            }
-                            friendData["userId"] = userId;
-                            friendData["username"] = obj["username"].toString();
-                            friendData["online"] = obj["online"].toBool();
-                            qDebug() << "Parsed friend:" << userId << obj["username"].toString() << obj["online"].toBool();
-                            friends.append(friendData);
-                        }
-                    }
-                }
-                m_friendsList = friends;
-                emit friendsListChanged();
-                qDebug() << "Friends list updated with" << friends.size() << "friends";
-            }
-            break;
-              case MessageType::FRIEND_REQUESTS_RESPONSE:
-            // 处理好友请求列表
-            break;
-            
-        case MessageType::GROUP_LIST_RESPONSE:
-            {
-                QVariantList groups;
-                QJsonDocument doc = QJsonDocument::fromJson(data["groups"].toString().toUtf8());
-                if (doc.isArray()) {
-                    QJsonArray array = doc.array();
-                    for (const auto &value : array) {
-                        if (value.isObject()) {
-                            QJsonObject obj = value.toObject();
-                            QVariantMap groupData;
-                            groupData["groupId"] = obj["group_id"].toString();
-                            groupData["groupName"] = obj["group_name"].toString();
-                            groupData["memberCount"] = obj["member_count"].toInt();
-                            groups.append(groupData);
-                        }
-                    }
-                }
-                m_groupsList = groups;
-                emit groupsListChanged();
-            }
-            break;
-              case MessageType::CREATE_GROUP_RESPONSE:
-            emit groupCreated(
-                data["groupId"].toString(),
-                data["groupName"].toString()
-            );
-            break;
-            
-        case MessageType::JOIN_GROUP_RESPONSE:
-            emit joinedGroup(
-                data["groupId"].toString(),
-                data["groupName"].toString()
-            );
-            break;
-            
-        case MessageType::LEAVE_GROUP_RESPONSE:
-            emit leftGroup(data["groupId"].toString());
-            break;
-            
-        case MessageType::GROUP_MEMBERS_RESPONSE:
-            {
-                QVariantList members;
-                QJsonDocument doc = QJsonDocument::fromJson(data["members"].toString().toUtf8());
-                if (doc.isArray()) {
-                    QJsonArray array = doc.array();
-                    for (const auto &value : array) {
-                        if (value.isObject()) {
-                            QJsonObject obj = value.toObject();
-                            QVariantMap memberData;
-                            memberData["userId"] = obj["user_id"].toString();
-                            memberData["username"] = obj["username"].toString();
-                            memberData["role"] = obj["role"].toString();
-                            members.append(memberData);
-                        }
-                    }
-                }
-                emit groupMembersReceived(data["groupId"].toString(), members);
-            }
-            break;
-              case MessageType::USER_LIST_RESPONSE:
-            {
-                QVariantList users;
-                // 解析服务器返回的用户列表数据
-                QString usersJson = data["users"].toString();
-                QJsonDocument doc = QJsonDocument::fromJson(usersJson.toUtf8());
-                if (doc.isArray()) {
-                    QJsonArray array = doc.array();
-                    for (const auto &value : array) {
-                        if (value.isObject()) {
-                            QJsonObject obj = value.toObject();
-                            QVariantMap userData;
-                            userData["userId"] = obj["id"].toString();
-                            userData["username"] = obj["username"].toString();
-                            userData["online"] = obj["online"].toBool();
-                            users.append(userData);
-                        }
-                    }
+void ChatController::handleFriendAccepted(const FriendAcceptedPayload &payload)
+{
+    emit friendRequestAccepted(payload.userId, payload.username);
+}
+
+void ChatController::handleFriendRejected(const FriendRejectedPayload &payload)
+{
+    emit friendRequestRejected(payload.userId);
+}
+
+void ChatController::handleFriendList(const FriendListPayload &payload)
+{
+    applyListSync("friends", m_friendsModel, payload.friends, payload.sync);
+    qDebug() << "Friends list updated with" << m_friendsModel->rowCount() << "friends";
+}
+
+void ChatController::handleGroupList(const GroupListPayload &payload)
+{
+    applyListSync("groups", m_groupsModel, payload.groups, payload.sync);
+}
+
+void ChatController::handleGroupCreated(const GroupCreatedPayload &payload)
+{
+    emit groupCreated(payload.groupId, payload.groupName);
+}
+
+void ChatController::handleGroupJoined(const GroupJoinedPayload &payload)
+{
+    emit joinedGroup(payload.groupId, payload.groupName);
+}
+
+void ChatController::handleGroupLeft(const GroupLeftPayload &payload)
+{
+    emit leftGroup(payload.groupId);
+}
+
+void ChatController::handleGroupMembers(const GroupMembersPayload &payload)
+{
+    emit groupMembersReceived(payload.groupId, payload.members);
+}
+
+void ChatController::handleUserList(const UserListPayload &payload)
+{
+    applyListSync("users", m_usersModel, payload.users, payload.sync);
+    qDebug() << "Users list updated with" << m_usersModel->rowCount() << "users";
+}
+
+void ChatController::requestList(MessageType type, const QString &listName)
+{
+    // 带上已有版本号时服务器只回传之后的变化
+    QVariantMap data;
+    qint64 revision = m_listRevisions.value(listName);
+    if (revision > 0) {
+        data["revision"] = QString::number(revision);
+    }
+    m_networkManager->sendMessage(type, data);
+}
+
+void ChatController::applyListSync(const QString &listName, ContactListModel *model,
+                                   const QVariantList &items, const ListSyncInfo &sync)
+{
+    // 好友行带上本地未读数，否则合并时会被当作变化的行
+    const bool friends = model == m_friendsModel;
+    if (sync.isDelta) {
+        model->applyChanges(friends ? withUnreadCounts(sync.changed) : sync.changed, sync.removed);
+    } else {
+        model->setContacts(friends ? withUnreadCounts(items) : items);
+    }
+    m_listRevisions[listName] = sync.revision;
+    emitListChanged(listName);
+
+    // 只有服务器给出版本号时才保存，旧服务器每次仍取完整列表
+    if (m_chatHistoryManager && !m_currentUserId.isEmpty() && sync.revision > 0) {
+        m_dirtyLists.insert(listName, model);
+        if (!m_listSaveTimer->isActive()) {
+            m_listSaveTimer->start();
+        }
+    }
+}
+
+void ChatController::saveDirtyContactLists()
+{
+    m_listSaveTimer->stop();
+    if (!m_chatHistoryManager || m_currentUserId.isEmpty()) {
+        m_dirtyLists.clear();
+        return;
+    }
+
+    // 快照与版本号一起保存，未来得及保存时下次只是从较旧的版本开始同步
+    for (auto it = m_dirtyLists.cbegin(); it != m_dirtyLists.cend(); ++it) {
+        QJsonObject list;
+        list["revision"] = QString::number(m_listRevisions.value(it.key()));
+        list["items"] = QJsonArray::fromVariantList(it.value()->contacts());
+        m_chatHistoryManager->saveContactList(it.key(), list);
+    }
+    m_dirtyLists.clear();
+}
+
+QVariantList ChatController::withUnreadCounts(const QVariantList &friends) const
+{
+    // 未读数来自本地最近会话，服务器返回的好友列表中没有该字段
+    QVariantList rows;
+    rows.reserve(friends.size());
+    for (const QVariant &item : friends) {
+        QVariantMap row = item.toMap();
+        row["unreadCount"] = m_chatHistoryManager
+                             ? m_chatHistoryManager->unreadCount(row.value("userId").toString(), false) : 0;
+        rows.append(row);
+    }
+    return rows;
+}
+
+void ChatController::updateUnreadCount(const QString &chatId, bool isGroup, int unreadCount)
+{
+    if (!isGroup) {
+        m_friendsModel->setField(chatId, "unreadCount", unreadCount);
+    }
+}
+
+void ChatController::refreshUnreadCounts()
+{
+    if (!m_chatHistoryManager) {
+        return;
+    }
+    // 最近会话整体重新载入时逐个好友更新，setField只通知真正变化的行
+    const QStringList friendIds = m_friendsModel->keys();
+    for (const QString &friendId : friendIds) {
+        m_friendsModel->setField(friendId, "unreadCount", m_chatHistoryManager->unreadCount(friendId, false));
+    }
+}
+
+void ChatController::loadSavedContactLists()
+{
+    const std::pair<QString, ContactListModel *> lists[] = {
+        {"friends", m_friendsModel},
+        {"groups", m_groupsModel},
+        {"users", m_usersModel},
+    };
+
+    QString userId = m_currentUserId;
+    for (const auto &[listName, model] : lists) {
+        m_chatHistoryManager->fetchContactList(listName).then(this,
+            [this, userId, listName = listName, model = model](const QJsonObject &list) {
+                // 期间已切换用户或服务器已返回新列表时丢弃
+                if (userId != m_currentUserId || m_listRevisions.value(listName) > 0) {
+                    return;
                 }
-                m_usersList = users;
-                emit usersListChanged();
-                qDebug() << "Users list updated with" << users.size() << "users";
-            }
-            break;
-            
-        case MessageType::CHAT_HISTORY_RESPONSE:
-            {
-                QVariantList messages;
-                QJsonDocument doc = QJsonDocument::fromJson(data["messages"].toString().toUtf8());
-                if (doc.isArray()) {
-                    QJsonArray array = doc.array();
-                    for (const auto &value : array) {
-                        if (value.isObject()) {
-                            QJsonObject obj = value.toObject();
-                            QVariantMap messageData;
-                            messageData["messageId"] = obj["message_id"].toString();
-                            messageData["fromUserId"] = obj["from_user_id"].toString();
-                            messageData["fromUsername"] = obj["from_username"].toString();
-                            messageData["content"] = obj["content"].toString();
-                            messageData["timestamp"] = obj["timestamp"].toString();
-                            messages.append(messageData);
-                        }
-                    }
+                qint64 revision = list["revision"].toString().toLongLong();
+                if (revision <= 0) {
+                    return;
                 }
-                emit chatHistoryReceived(
-                    data["type"].toString(),
-                    data["targetId"].toString(),
-                    messages
-                );
-            }
-            break;
-              case MessageType::RECALL_MESSAGE_RESPONSE:
-            emit messageRecalled(
-                data["messageId"].toString(),
-                data["type"].toString(),
-                data["targetId"].toString()
-            );
-            break;
-            
-        case MessageType::MARK_MESSAGE_READ_RESPONSE:
-            emit messageMarkedRead(data["messageId"].toString());
-            break;
-            
-        default:
-            qDebug() << "Unknown message type:" << messageType;
-            break;
+                QVariantList items = list["items"].toArray().toVariantList();
+                model->setContacts(model == m_friendsModel ? withUnreadCounts(items) : items);
+                m_listRevisions[listName] = revision;
+                emitListChanged(listName);
+            });
+    }
+}
+
+void ChatController::emitListChanged(const QString &listName)
+{
+    if (listName == "friends") {
+        emit friendsListChanged();
+    } else if (listName == "groups") {
+        emit groupsListChanged();
+    } else if (listName == "users") {
+        emit usersListChanged();
+    }
+}
+
+void ChatController::handleChatHistory(const ChatHistoryPayload &payload)
+{
+    emit chatHistoryReceived(payload.type, payload.targetId, payload.messages);
+}
+
+void ChatController::handleMessageRecalled(const MessageRecalledPayload &payload)
+{
+    if (m_messageModel->isShowing(payload.type, payload.targetId)) {
+        m_messageModel->markRecalled(payload.messageId);
     }
+    emit messageRecalled(payload.messageId, payload.type, payload.targetId);
+}
+
+void ChatController::handleMessageRead(const MessageReadPayload &payload)
+{
+    m_messageModel->setStatus(payload.messageId, "read");
+    emit messageMarkedRead(payload.messageId);
 }
 
 QVariantMap ChatController::parseMessageContent(const QString &content)
@@ -584,12 +749,34 @@ QVariantMap ChatController::parseMessageContent(const QString &content)
 
 void ChatController::setChatHistoryManager(ChatHistoryManager *manager)
 {
+    if (m_chatHistoryManager) {
+        disconnect(m_chatHistoryManager, nullptr, this, nullptr);
+    }
     m_chatHistoryManager = manager;
     if (m_chatHistoryManager) {
+        // 未读数写入好友模型，只更新对应的行
+        connect(m_chatHistoryManager, &ChatHistoryManager::unreadCountChanged,
+                this, &ChatController::updateUnreadCount);
+        connect(m_chatHistoryManager, &ChatHistoryManager::recentChatUpdated, this,
+                [this](const QString &chatId, bool isGroup, const QString &, int unreadCount) {
+                    updateUnreadCount(chatId, isGroup, unreadCount);
+                });
+        connect(m_chatHistoryManager, &ChatHistoryManager::recentChatsChanged,
+                this, &ChatController::refreshUnreadCounts);
         qDebug() << "ChatController: 聊天历史管理器已设置";
     }
 }
 
+void ChatController::openChat(const QString &type, const QString &targetId)
+{
+    m_messageModel->setChat(type, targetId);
+
+    // 打开会话即视为已读
+    if (m_chatHistoryManager && !targetId.isEmpty()) {
+        m_chatHistoryManager->markChatAsRead(targetId, type == "group");
+    }
+}
+
 void ChatController::loadLocalChatHistory(const QString &type, const QString &targetId, int count)
 {
     if (!m_chatHistoryManager) {
@@ -597,41 +784,56 @@ void ChatController::loadLocalChatHistory(const QString &type, const QString &ta
         return;
     }
     
-    QJsonArray messages;
+    QFuture<QList<ChatRecord>> future;
     if (type == "private") {
-        messages = m_chatHistoryManager->getPrivateMessages(targetId, count);
+        future = m_chatHistoryManager->fetchPrivateMessages(targetId, count);
     } else if (type == "group") {
-        messages = m_chatHistoryManager->getGroupMessages(targetId, count);
+        future = m_chatHistoryManager->fetchGroupMessages(targetId, count);
     } else {
         qWarning() << "无效的聊天类型:" << type;
         return;
     }
     
-    // 转换为QVariantList
-    QVariantList messagesList;
-    for (const auto &value : messages) {
-        if (value.isObject()) {
-            QJsonObject msgObj = value.toObject();
-            QVariantMap msgMap;
-            msgMap["fromUserId"] = msgObj["fromUserId"].toString();
-            msgMap["content"] = msgObj["content"].toString();
-            msgMap["messageId"] = msgObj["messageId"].toString();
-            msgMap["timestamp"] = msgObj["timestamp"].toVariant();
-            msgMap["isRead"] = msgObj["isRead"].toBool();
-            msgMap["recalled"] = msgObj["recalled"].toBool();
-            
-            if (type == "private") {
-                msgMap["toUserId"] = msgObj["toUserId"].toString();
-            } else if (type == "group") {
-                msgMap["groupId"] = msgObj["groupId"].toString();
-            }
-            
-            messagesList.append(msgMap);
+    // 读取在历史线程中完成，结果回到界面线程后直接写入模型；期间已切换会话的结果丢弃
+    future.then(this, [this, type, targetId](const QList<ChatRecord> &records) {
+        if (!m_messageModel->isShowing(type, targetId)) {
+            return;
         }
+        m_messageModel->setRecords(records);
+        emit localChatHistoryLoaded(type, targetId, static_cast<int>(records.size()));
+        qDebug() << "加载本地聊天记录:" << type << targetId << "消息数量:" << records.size();
+    });
+}
+
+void ChatController::loadOlderChatHistory(const QString &type, const QString &targetId,
+                                          const QString &beforeMessageId, int count)
+{
+    if (!m_chatHistoryManager) {
+        qWarning() << "聊天历史管理器未设置";
+        return;
     }
-    
-    emit localChatHistoryLoaded(type, targetId, messagesList);
-    qDebug() << "加载本地聊天记录:" << type << targetId << "消息数量:" << messagesList.size();
+
+    // 以当前最早一条消息为游标向前翻页
+    HistoryCursor cursor;
+    cursor.messageId = beforeMessageId;
+
+    QFuture<HistoryPage> future;
+    if (type == "private") {
+        future = m_chatHistoryManager->fetchPrivatePage(targetId, cursor, count);
+    } else if (type == "group") {
+        future = m_chatHistoryManager->fetchGroupPage(targetId, cursor, count);
+    } else {
+        qWarning() << "无效的聊天类型:" << type;
+        return;
+    }
+
+    future.then(this, [this, type, targetId](const HistoryPage &page) {
+        if (!m_messageModel->isShowing(type, targetId)) {
+            return;
+        }
+        m_messageModel->prependRecords(page.records);
+        emit olderChatHistoryLoaded(type, targetId, static_cast<int>(page.records.size()), page.hasMore);
+    });
 }
 
 void ChatController::clearChatHistory(const QString &type, const QString &targetId)
@@ -653,42 +855,43 @@ void ChatController::processOfflineMessages()
         return;
     }
     
-    QJsonArray offlineMessages = m_chatHistoryManager->getOfflineMessages();
-    int processedCount = 0;
-    
-    for (const auto &value : offlineMessages) {
-        if (value.isObject()) {
-            QJsonObject msgObj = value.toObject();
-            QString messageType = msgObj["type"].toString();
-            
-            if (messageType == "private") {
-                emit privateMessageReceived(
-                    msgObj["fromUserId"].toString(),
-                    msgObj["fromUsername"].toString(),
-                    msgObj["content"].toString(),
-                    msgObj["messageId"].toString(),
-                    QString::number(msgObj["timestamp"].toVariant().toLongLong())
-                );
-            } else if (messageType == "group") {
-                emit groupMessageReceived(
-                    msgObj["groupId"].toString(),
-                    msgObj["fromUserId"].toString(),
-                    msgObj["fromUsername"].toString(),
-                    msgObj["content"].toString(),
-                    msgObj["messageId"].toString(),
-                    QString::number(msgObj["timestamp"].toVariant().toLongLong())
-                );
+    m_chatHistoryManager->fetchOfflineMessages().then(this, [this](const QJsonArray &offlineMessages) {
+        int processedCount = 0;
+        
+        for (const auto &value : offlineMessages) {
+            if (value.isObject()) {
+                QJsonObject msgObj = value.toObject();
+                QString messageType = msgObj["type"].toString();
+                
+                if (messageType == "private") {
+                    emit privateMessageReceived(
+                        msgObj["fromUserId"].toString(),
+                        msgObj["fromUsername"].toString(),
+                        msgObj["content"].toString(),
+                        msgObj["messageId"].toString(),
+                        QString::number(msgObj["timestamp"].toVariant().toLongLong())
+                    );
+                } else if (messageType == "group") {
+                    emit groupMessageReceived(
+                        msgObj["groupId"].toString(),
+                        msgObj["fromUserId"].toString(),
+                        msgObj["fromUsername"].toString(),
+                        msgObj["content"].toString(),
+                        msgObj["messageId"].toString(),
+                        QString::number(msgObj["timestamp"].toVariant().toLongLong())
+                    );
+                }
+                processedCount++;
             }
-            processedCount++;
         }
-    }
-    
-    // 清空已处理的离线消息
-    if (processedCount > 0) {
-        m_chatHistoryManager->clearOfflineMessages();
-        emit offlineMessagesProcessed(processedCount);
-        qDebug() << "处理离线消息:" << processedCount << "条";
-    }
+        
+        // 清空已处理的离线消息
+        if (processedCount > 0) {
+            m_chatHistoryManager->clearOfflineMessages();
+            emit offlineMessagesProcessed(processedCount);
+            qDebug() << "处理离线消息:" << processedCount << "条";
+        }
+    });
 }
 
 void ChatController::clearOfflineMessages()
@@ -709,11 +912,27 @@ void ChatController::initializeChatHistory(const QString &userId)
         return;
     }
     
+    // 上一个用户未保存的列表先写入其目录
+    saveDirtyContactLists();
+
     // 设置当前用户ID
     m_currentUserId = userId;
+    m_messageModel->setCurrentUserId(userId);
+
+    // 上一个用户的列表不再有效
+    m_listRevisions.clear();
+    m_friendsModel->setContacts(QVariantList());
+    m_groupsModel->setContacts(QVariantList());
+    m_usersModel->setContacts(QVariantList());
+    m_userDirectory.clear();
+    m_userSearchModel->setContacts(QVariantList());
+    m_userSearchCursor.clear();
     
     if (m_chatHistoryManager->initialize(userId)) {
         qDebug() << "聊天历史管理器初始化成功，用户ID:" << userId;
+
+        // 先显示本地保存的列表，之后的请求只取增量
+        loadSavedContactLists();
         
         // 处理离线消息
         processOfflineMessages();
@@ -0,0 +1,204 @@
+#include "include/ChatHistoryCache.h"
+
+ChatHistoryCache::ChatHistoryCache(int windowSize, qint64 memoryBudget)
+    : m_windowSize(qMax(1, windowSize))
+    , m_memoryBudget(memoryBudget)
+    , m_memoryUsage(0)
+    , m_hits(0)
+    , m_misses(0)
+{
+}
+
+void ChatHistoryCache::setLimits(int windowSize, qint64 memoryBudget)
+{
+    m_windowSize = qMax(1, windowSize);
+    m_memoryBudget = memoryBudget;
+
+    for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+        trimWindow(it.value());
+    }
+    evictOverBudget();
+}
+
+bool ChatHistoryCache::lookup(const QString &chatKey, int count, int offset, QList<ChatRecord> *records)
+{
+    auto it = m_entries.find(chatKey);
+    if (it == m_entries.end() || count <= 0) {
+        ++m_misses;
+        return false;
+    }
+
+    Entry &entry = it.value();
+    qsizetype size = entry.records.size();
+    offset = qMax(0, offset);
+
+    // 窗口不够且还有更早的历史时只能读磁盘
+    if (offset + count > size && !entry.complete) {
+        ++m_misses;
+        return false;
+    }
+
+    qsizetype end = qMax<qsizetype>(0, size - offset);
+    qsizetype start = qMax<qsizetype>(0, end - count);
+    *records = entry.records.mid(start, end - start);
+
+    touch(entry);
+    ++m_hits;
+    return true;
+}
+
+bool ChatHistoryCache::lookupPage(const QString &chatKey, const HistoryCursor &cursor, int count, HistoryPage *page)
+{
+    auto it = m_entries.find(chatKey);
+    // 只按消息ID定位，按时间戳定位交给存储层
+    if (it == m_entries.end() || count <= 0 || (cursor.messageId.isEmpty() && cursor.timestamp > 0)) {
+        ++m_misses;
+        return false;
+    }
+
+    Entry &entry = it.value();
+    const QList<ChatRecord> &records = entry.records;
+    qsizetype end = records.size();
+    if (!cursor.messageId.isEmpty()) {
+        end = -1;
+        for (qsizetype i = records.size() - 1; i >= 0; --i) {
+            if (records[i].messageId == cursor.messageId) {
+                end = i;
+                break;
+            }
+        }
+    }
+
+    if (end < 0 || (end < count && !entry.complete)) {
+        ++m_misses;
+        return false;
+    }
+
+    qsizetype start = qMax<qsizetype>(0, end - count);
+    page->records = records.mid(start, end - start);
+    page->hasMore = start > 0 || !entry.complete;
+    if (!page->records.isEmpty()) {
+        page->nextCursor.messageId = page->records.first().messageId;
+        page->nextCursor.timestamp = page->records.first().timestamp;
+    }
+
+    touch(entry);
+    ++m_hits;
+    return true;
+}
+
+void ChatHistoryCache::store(const QString &chatKey, const QList<ChatRecord> &records, bool complete)
+{
+    remove(chatKey);
+
+    m_lru.push_front(chatKey);
+    Entry &entry = m_entries[chatKey];
+    entry.records = records;
+    entry.complete = complete;
+    entry.lruPosition = m_lru.begin();
+    for (const ChatRecord &record : records) {
+        entry.bytes += recordBytes(record);
+    }
+    m_memoryUsage += entry.bytes;
+
+    trimWindow(entry);
+    evictOverBudget();
+}
+
+void ChatHistoryCache::append(const QString &chatKey, const ChatRecord &record)
+{
+    auto it = m_entries.find(chatKey);
+    if (it == m_entries.end()) {
+        return;
+    }
+
+    Entry &entry = it.value();
+    entry.records.append(record);
+    qint64 bytes = recordBytes(record);
+    entry.bytes += bytes;
+    m_memoryUsage += bytes;
+
+    trimWindow(entry);
+    evictOverBudget();
+}
+
+void ChatHistoryCache::updateFlags(const QString &chatKey, const QString &messageId, quint8 flags)
+{
+    auto it = m_entries.find(chatKey);
+    if (it == m_entries.end()) {
+        return;
+    }
+
+    // 通常是最新的消息，从末尾向前查找
+    QList<ChatRecord> &records = it.value().records;
+    for (qsizetype i = records.size() - 1; i >= 0; --i) {
+        if (records[i].messageId == messageId) {
+            if (flags & ChatLogStore::kFlagRead) {
+                records[i].isRead = true;
+            }
+            if (flags & ChatLogStore::kFlagRecalled) {
+                records[i].recalled = true;
+                records[i].content = "[消息已撤回]";
+            }
+            break;
+        }
+    }
+}
+
+void ChatHistoryCache::remove(const QString &chatKey)
+{
+    auto it = m_entries.find(chatKey);
+    if (it == m_entries.end()) {
+        return;
+    }
+
+    m_memoryUsage -= it.value().bytes;
+    m_lru.erase(it.value().lruPosition);
+    m_entries.erase(it);
+}
+
+void ChatHistoryCache::clear()
+{
+    m_entries.clear();
+    m_lru.clear();
+    m_memoryUsage = 0;
+}
+
+// 私有方法实现
+
+void ChatHistoryCache::touch(Entry &entry)
+{
+    m_lru.splice(m_lru.begin(), m_lru, entry.lruPosition);
+}
+
+void ChatHistoryCache::trimWindow(Entry &entry)
+{
+    qsizetype excess = entry.records.size() - m_windowSize;
+    if (excess <= 0) {
+        return;
+    }
+
+    for (qsizetype i = 0; i < excess; ++i) {
+        qint64 bytes = recordBytes(entry.records.at(i));
+        entry.bytes -= bytes;
+        m_memoryUsage -= bytes;
+    }
+    entry.records.remove(0, excess);
+    entry.complete = false;
+}
+
+void ChatHistoryCache::evictOverBudget()
+{
+    // 至少保留最近使用的一个会话
+    while (m_memoryUsage > m_memoryBudget && m_lru.size() > 1) {
+        QString oldest = m_lru.back();
+        remove(oldest);
+    }
+}
+
+qint64 ChatHistoryCache::recordBytes(const ChatRecord &record)
+{
+    qint64 characters = record.messageId.size() + record.fromUserId.size()
+                        + record.targetId.size() + record.content.size();
+    return static_cast<qint64>(sizeof(ChatRecord)) + characters * static_cast<qint64>(sizeof(QChar));
+}
@@ -1,24 +1,76 @@
 #include "include/ChatHistoryManager.h"
+#include "include/ChatHistoryWorker.h"
 #include <QDebug>
-#include <QFile>
-#include <QJsonParseError>
+#include <QPromise>
+#include <QUuid>
 
 ChatHistoryManager::ChatHistoryManager(QObject *parent)
     : QObject(parent)
+    , m_worker(new ChatHistoryWorker)
+    , m_cacheGeneration(0)
+    , m_storageFormat(ChatLogStore::RecordFormat::Binary)
+    , m_recentChatsDirty(false)
 {
     // 初始化数据目录
     initializeDataDirectory();
+
+    // 启动工作线程，所有磁盘I/O都在其中执行
+    m_workerThread.setObjectName("ChatHistoryWorker");
+    m_worker->moveToThread(&m_workerThread);
+    connect(&m_workerThread, &QThread::finished, m_worker, &QObject::deleteLater);
+    connect(m_worker, &ChatHistoryWorker::recordsFlushed,
+            this, &ChatHistoryManager::messagesSaved);
+    m_workerThread.start();
+
+    // 最近聊天列表延迟写入
+    m_recentChatsTimer.setSingleShot(true);
+    m_recentChatsTimer.setInterval(kRecentChatsFlushMs);
+    connect(&m_recentChatsTimer, &QTimer::timeout, this, &ChatHistoryManager::flushRecentChats);
 }
 
 ChatHistoryManager::~ChatHistoryManager()
 {
+    // 等待最近聊天列表写入完成后再结束工作线程
+    if (m_recentChatsDirty) {
+        ChatHistoryWorker *worker = m_worker;
+        QJsonArray chats = m_recentChats.toJson();
+        runOnWorker<bool>([worker, chats]() {
+            worker->saveRecentChats(chats);
+            return true;
+        }).waitForFinished();
+    }
+
+    // 工作对象在线程结束时析构，析构时会写入尚未落盘的消息
+    m_workerThread.quit();
+    m_workerThread.wait();
+}
+
+template <typename Function>
+void ChatHistoryManager::postToWorker(Function function)
+{
+    QMetaObject::invokeMethod(m_worker, std::move(function), Qt::QueuedConnection);
+}
+
+template <typename T, typename Function>
+QFuture<T> ChatHistoryManager::runOnWorker(Function function)
+{
+    auto promise = std::make_shared<QPromise<T>>();
+    QFuture<T> future = promise->future();
+    promise->start();
+
+    postToWorker([promise, function]() {
+        promise->addResult(function());
+        promise->finish();
+    });
+
+    return future;
 }
 
 void ChatHistoryManager::initializeDataDirectory()
 {
     // 使用应用程序数据目录
     m_dataDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
-    
+
     // 确保基础目录存在
     ensureDirectoryExists(m_dataDir);
 }
@@ -29,36 +81,53 @@ bool ChatHistoryManager::initialize(const QString &userId)
         qWarning() << "用户ID不能为空";
         return false;
     }
-    
+
+    // 先写出上一个用户的最近聊天列表，排在切换目录之前执行
+    flushRecentChats();
+    m_recentChats.clear();
+
     setCurrentUserId(userId);
+
+    // 切换用户后之前的缓存全部失效
+    m_cache.clear();
+    m_chatVersions.clear();
+    ++m_cacheGeneration;
       // 创建用户专用数据目录
     m_userDataDir = QDir(m_dataDir).filePath(userId);
     qDebug() << "数据目录路径:" << m_dataDir;
     qDebug() << "用户数据目录路径:" << m_userDataDir;
-    
-    if (!ensureDirectoryExists(m_userDataDir)) {
-        qWarning() << "无法创建用户数据目录:" << m_userDataDir;
-        return false;
-    }
-    
-    // 创建子目录
-    QString privateChatsDir = QDir(m_userDataDir).filePath("private_chats");
-    QString groupChatsDir = QDir(m_userDataDir).filePath("group_chats");
-    
-    qDebug() << "私聊目录:" << privateChatsDir;
-    qDebug() << "群聊目录:" << groupChatsDir;
-    
-    ensureDirectoryExists(privateChatsDir);
-    ensureDirectoryExists(groupChatsDir);
-    
-    qDebug() << "聊天历史管理器初始化成功，用户:" << userId;
-    
-    // 检查是否有离线消息
-    QJsonArray offlineMessages = getOfflineMessages();
-    if (!offlineMessages.isEmpty()) {
-        emit offlineMessagesAvailable(offlineMessages.size());
-    }
-    
+
+    // 目录创建和旧数据迁移在工作线程中完成，之后排队的请求都会在其后执行
+    ChatHistoryWorker *worker = m_worker;
+    QString userDataDir = m_userDataDir;
+    runOnWorker<int>([worker, userDataDir]() {
+        return worker->initialize(userDataDir);
+    }).then(this, [this, userId](int offlineCount) {
+        if (offlineCount < 0) {
+            qWarning() << "聊天历史初始化失败，用户:" << userId;
+            return;
+        }
+
+        qDebug() << "聊天历史管理器初始化成功，用户:" << userId;
+
+        // 载入最近聊天列表，初始化期间已收到的消息以内存为准
+        ChatHistoryWorker *worker = m_worker;
+        runOnWorker<QJsonArray>([worker]() {
+            return worker->loadRecentChats();
+        }).then(this, [this, userId](const QJsonArray &chats) {
+            if (userId != m_currentUserId) {
+                return;
+            }
+            m_recentChats.merge(chats);
+            emit recentChatsChanged();
+        });
+
+        // 检查是否有离线消息
+        if (offlineCount > 0) {
+            emit offlineMessagesAvailable(offlineCount);
+        }
+    });
+
     return true;
 }
 
@@ -67,7 +136,7 @@ void ChatHistoryManager::setCurrentUserId(const QString &userId)
     m_currentUserId = userId;
 }
 
-void ChatHistoryManager::savePrivateMessage(const QString &fromUserId, const QString &toUserId, 
+void ChatHistoryManager::savePrivateMessage(const QString &fromUserId, const QString &toUserId,
                                           const QString &content, const QString &messageId,
                                           qint64 timestamp)
 {
@@ -75,38 +144,24 @@ void ChatHistoryManager::savePrivateMessage(const QString &fromUserId, const QSt
         qWarning() << "当前用户ID为空，无法保存消息";
         return;
     }
-    
+
     // 确定对话的另一方
     QString otherUserId = (fromUserId == m_currentUserId) ? toUserId : fromUserId;
-      // 获取文件路径
-    QString filePath = getPrivateChatFilePath(otherUserId);
-    qDebug() << "保存私聊消息到文件:" << filePath;
-    
-    // 加载现有消息
-    QJsonArray messages = loadJsonArray(filePath);
-    qDebug() << "当前文件中的消息数量:" << messages.size();
-    
-    // 创建新消息对象
-    QJsonObject messageObj = createMessageObject(fromUserId, content, messageId, timestamp);
-    messageObj["toUserId"] = toUserId;
-    messageObj["type"] = "private";
-    
-    // 添加到消息数组
-    messages.append(messageObj);
-    qDebug() << "添加消息后的总数量:" << messages.size();
-    
-    // 保存到文件
-    if (saveJsonArray(filePath, messages)) {
-        qDebug() << "私聊消息已保存:" << fromUserId << "->" << toUserId;
-        
-        // 更新最近聊天列表
-        QString chatName = otherUserId; // 这里可以后续优化为显示用户名
-        updateRecentChats(otherUserId, chatName, content, false);
-        
-        emit messagesSaved();
-    } else {
-        qWarning() << "保存私聊消息失败";
-    }
+
+    // 创建新消息记录
+    ChatRecord record = createMessageRecord(fromUserId, content, messageId, timestamp);
+    record.targetId = toUserId;
+    record.isGroup = false;
+
+    // 更新缓存后交给工作线程排队写入
+    ChatHistoryWorker *worker = m_worker;
+    QString chatKey = getPrivateChatKey(otherUserId);
+    m_cache.append(chatKey, record);
+    bumpChatVersion(chatKey);
+    touchRecentChat(otherUserId, false, record);
+    postToWorker([worker, chatKey, otherUserId, record]() {
+        worker->appendRecord(chatKey, otherUserId, record);
+    });
 }
 
 void ChatHistoryManager::saveGroupMessage(const QString &groupId, const QString &fromUserId,
@@ -117,361 +172,411 @@ void ChatHistoryManager::saveGroupMessage(const QString &groupId, const QString
         qWarning() << "当前用户ID为空，无法保存消息";
         return;
     }
-    
-    // 获取文件路径
-    QString filePath = getGroupChatFilePath(groupId);
-    
-    // 加载现有消息
-    QJsonArray messages = loadJsonArray(filePath);
-    
-    // 创建新消息对象
-    QJsonObject messageObj = createMessageObject(fromUserId, content, messageId, timestamp);
-    messageObj["groupId"] = groupId;
-    messageObj["type"] = "group";
-    
-    // 添加到消息数组
-    messages.append(messageObj);
-    
-    // 保存到文件
-    if (saveJsonArray(filePath, messages)) {
-        qDebug() << "群聊消息已保存:" << groupId << "，来自:" << fromUserId;
-        
-        // 更新最近聊天列表
-        QString chatName = "群聊 " + groupId; // 这里可以后续优化为显示群名
-        updateRecentChats(groupId, chatName, content, true);
-        
-        emit messagesSaved();
-    } else {
-        qWarning() << "保存群聊消息失败";
+
+    // 创建新消息记录
+    ChatRecord record = createMessageRecord(fromUserId, content, messageId, timestamp);
+    record.targetId = groupId;
+    record.isGroup = true;
+
+    // 更新缓存后交给工作线程排队写入
+    ChatHistoryWorker *worker = m_worker;
+    QString chatKey = getGroupChatKey(groupId);
+    m_cache.append(chatKey, record);
+    bumpChatVersion(chatKey);
+    touchRecentChat(groupId, true, record);
+    postToWorker([worker, chatKey, groupId, record]() {
+        worker->appendRecord(chatKey, groupId, record);
+    });
+}
+
+QFuture<QList<ChatRecord>> ChatHistoryManager::fetchPrivateMessages(const QString &otherUserId, int count, int offset)
+{
+    return fetchMessages(getPrivateChatKey(otherUserId), count, offset);
+}
+
+QFuture<QList<ChatRecord>> ChatHistoryManager::fetchGroupMessages(const QString &groupId, int count, int offset)
+{
+    return fetchMessages(getGroupChatKey(groupId), count, offset);
+}
+
+QFuture<QList<ChatRecord>> ChatHistoryManager::fetchMessages(const QString &chatKey, int count, int offset)
+{
+    // 缓存命中时直接返回，不经过工作线程
+    QList<ChatRecord> cached;
+    if (m_cache.lookup(chatKey, count, offset, &cached)) {
+        return QtFuture::makeReadyValueFuture(cached);
+    }
+
+    ChatHistoryWorker *worker = m_worker;
+    quint64 version = m_chatVersions.value(chatKey);
+    quint64 generation = m_cacheGeneration;
+
+    return runOnWorker<QList<ChatRecord>>([worker, chatKey, count, offset]() {
+        return worker->readMessages(chatKey, count, offset);
+    }).then(this, [this, chatKey, count, offset, version, generation](const QList<ChatRecord> &records) {
+        // 只缓存会话末尾的窗口，且读取期间会话没有被修改
+        if (offset == 0 && generation == m_cacheGeneration
+            && version == m_chatVersions.value(chatKey)) {
+            m_cache.store(chatKey, records, records.size() < count);
+        }
+        return records;
+    });
+}
+
+QFuture<HistoryPage> ChatHistoryManager::fetchPrivatePage(const QString &otherUserId, const HistoryCursor &cursor, int count)
+{
+    return fetchPage(getPrivateChatKey(otherUserId), cursor, count);
+}
+
+QFuture<HistoryPage> ChatHistoryManager::fetchGroupPage(const QString &groupId, const HistoryCursor &cursor, int count)
+{
+    return fetchPage(getGroupChatKey(groupId), cursor, count);
+}
+
+QFuture<HistoryPage> ChatHistoryManager::fetchPage(const QString &chatKey, const HistoryCursor &cursor, int count)
+{
+    HistoryPage cached;
+    if (m_cache.lookupPage(chatKey, cursor, count, &cached)) {
+        return QtFuture::makeReadyValueFuture(cached);
     }
+
+    ChatHistoryWorker *worker = m_worker;
+    quint64 version = m_chatVersions.value(chatKey);
+    quint64 generation = m_cacheGeneration;
+
+    return runOnWorker<HistoryPage>([worker, chatKey, cursor, count]() {
+        return worker->readPage(chatKey, cursor, count);
+    }).then(this, [this, chatKey, cursor, version, generation](const HistoryPage &page) {
+        // 最新一页同时作为会话末尾的窗口放入缓存
+        if (cursor.isNull() && generation == m_cacheGeneration
+            && version == m_chatVersions.value(chatKey)) {
+            m_cache.store(chatKey, page.records, !page.hasMore);
+        }
+        return page;
+    });
 }
 
-QJsonArray ChatHistoryManager::getPrivateMessages(const QString &otherUserId, int count, int offset)
+QFuture<QVariantList> ChatHistoryManager::fetchSearchResults(const QString &query, int limit)
 {
-    QString filePath = getPrivateChatFilePath(otherUserId);
-    qDebug() << "加载私聊消息从文件:" << filePath;
-    
-    QJsonArray allMessages = loadJsonArray(filePath);
-    qDebug() << "文件中总消息数量:" << allMessages.size();
-    
-    // 应用分页
-    QJsonArray result;
-    int start = qMax(0, allMessages.size() - count - offset);
-    int end = qMax(0, allMessages.size() - offset);
-    
-    qDebug() << "分页参数 - start:" << start << "end:" << end << "count:" << count << "offset:" << offset;
-    
-    for (int i = start; i < end; ++i) {
-        result.append(allMessages[i]);
+    ChatHistoryWorker *worker = m_worker;
+    return runOnWorker<QVariantList>([worker, query, limit]() {
+        return worker->searchMessages(query, limit);
+    });
+}
+
+void ChatHistoryManager::searchMessages(const QString &query, int limit)
+{
+    if (query.trimmed().isEmpty()) {
+        emit searchResultsReady(query, QVariantList());
+        return;
     }
-    
-    qDebug() << "返回消息数量:" << result.size();
-    return result;
+
+    fetchSearchResults(query, limit).then(this, [this, query](const QVariantList &results) {
+        emit searchResultsReady(query, results);
+    });
+}
+
+QFuture<QJsonArray> ChatHistoryManager::fetchOfflineMessages()
+{
+    ChatHistoryWorker *worker = m_worker;
+    return runOnWorker<QJsonArray>([worker]() {
+        return worker->loadOfflineMessages();
+    });
+}
+
+QFuture<QJsonArray> ChatHistoryManager::fetchRecentChats(int count)
+{
+    // 列表常驻内存，不需要经过工作线程
+    return QtFuture::makeReadyValueFuture(m_recentChats.toJson(count));
+}
+
+QFuture<QJsonObject> ChatHistoryManager::fetchContactList(const QString &listName)
+{
+    ChatHistoryWorker *worker = m_worker;
+    return runOnWorker<QJsonObject>([worker, listName]() {
+        return worker->loadContactList(listName);
+    });
+}
+
+void ChatHistoryManager::saveContactList(const QString &listName, const QJsonObject &list)
+{
+    ChatHistoryWorker *worker = m_worker;
+    postToWorker([worker, listName, list]() {
+        worker->saveContactList(listName, list);
+    });
+}
+
+QJsonArray ChatHistoryManager::getPrivateMessages(const QString &otherUserId, int count, int offset)
+{
+    return recordsToJsonArray(readMessagesBlocking(getPrivateChatKey(otherUserId), count, offset));
 }
 
 QJsonArray ChatHistoryManager::getGroupMessages(const QString &groupId, int count, int offset)
 {
-    QString filePath = getGroupChatFilePath(groupId);
-    QJsonArray allMessages = loadJsonArray(filePath);
-    
-    // 应用分页
-    QJsonArray result;
-    int start = qMax(0, allMessages.size() - count - offset);
-    int end = qMax(0, allMessages.size() - offset);
-    
-    for (int i = start; i < end; ++i) {
-        result.append(allMessages[i]);
+    return recordsToJsonArray(readMessagesBlocking(getGroupChatKey(groupId), count, offset));
+}
+
+QList<ChatRecord> ChatHistoryManager::readMessagesBlocking(const QString &chatKey, int count, int offset)
+{
+    QList<ChatRecord> records;
+    if (m_cache.lookup(chatKey, count, offset, &records)) {
+        return records;
     }
-    
-    return result;
+
+    // 不能等待fetchMessages的界面线程续体，直接等待工作线程的结果
+    ChatHistoryWorker *worker = m_worker;
+    return runOnWorker<QList<ChatRecord>>([worker, chatKey, count, offset]() {
+        return worker->readMessages(chatKey, count, offset);
+    }).result();
 }
 
 void ChatHistoryManager::markMessageAsRead(const QString &messageId, const QString &chatId, bool isGroup)
 {
-    QString filePath = isGroup ? getGroupChatFilePath(chatId) : getPrivateChatFilePath(chatId);
-    QJsonArray messages = loadJsonArray(filePath);
-    
-    bool found = false;
-    for (int i = 0; i < messages.size(); ++i) {
-        QJsonObject msg = messages[i].toObject();
-        if (msg["messageId"].toString() == messageId) {
-            msg["isRead"] = true;
-            messages[i] = msg;
-            found = true;
-            break;
+    ChatHistoryWorker *worker = m_worker;
+    QString chatKey = isGroup ? getGroupChatKey(chatId) : getPrivateChatKey(chatId);
+    m_cache.updateFlags(chatKey, messageId, ChatLogStore::kFlagRead);
+    bumpChatVersion(chatKey);
+    // 读到会话中的消息说明会话已被查看，未读整体清零
+    markChatAsRead(chatId, isGroup);
+    postToWorker([worker, chatKey, messageId]() {
+        if (worker->markMessageAsRead(chatKey, messageId)) {
+            qDebug() << "消息已标记为已读:" << messageId;
         }
-    }
-    
-    if (found) {
-        saveJsonArray(filePath, messages);
-        qDebug() << "消息已标记为已读:" << messageId;
-    }
+    });
 }
 
 void ChatHistoryManager::recallMessage(const QString &messageId, const QString &chatId, bool isGroup)
 {
-    QString filePath = isGroup ? getGroupChatFilePath(chatId) : getPrivateChatFilePath(chatId);
-    QJsonArray messages = loadJsonArray(filePath);
-    
-    bool found = false;
-    for (int i = 0; i < messages.size(); ++i) {
-        QJsonObject msg = messages[i].toObject();
-        if (msg["messageId"].toString() == messageId) {
-            msg["recalled"] = true;
-            msg["content"] = "[消息已撤回]";
-            messages[i] = msg;
-            found = true;
-            break;
+    ChatHistoryWorker *worker = m_worker;
+    QString chatKey = isGroup ? getGroupChatKey(chatId) : getPrivateChatKey(chatId);
+    m_cache.updateFlags(chatKey, messageId, ChatLogStore::kFlagRecalled);
+    bumpChatVersion(chatKey);
+    postToWorker([worker, chatKey, messageId]() {
+        if (worker->recallMessage(chatKey, messageId)) {
+            qDebug() << "消息已撤回:" << messageId;
         }
-    }
-    
-    if (found) {
-        saveJsonArray(filePath, messages);
-        qDebug() << "消息已撤回:" << messageId;
-    }
+    });
 }
 
 void ChatHistoryManager::saveOfflineMessage(const QJsonObject &messageData)
 {
-    QString filePath = getOfflineMessagesFilePath();
-    QJsonArray offlineMessages = loadJsonArray(filePath);
-    
-    // 添加时间戳
-    QJsonObject msgObj = messageData;
-    msgObj["receivedAt"] = QDateTime::currentMSecsSinceEpoch();
-    
-    offlineMessages.append(msgObj);
-    
-    if (saveJsonArray(filePath, offlineMessages)) {
-        qDebug() << "离线消息已保存";
-    }
+    ChatHistoryWorker *worker = m_worker;
+    postToWorker([worker, messageData]() {
+        worker->saveOfflineMessage(messageData);
+    });
 }
 
 QJsonArray ChatHistoryManager::getOfflineMessages()
 {
-    QString filePath = getOfflineMessagesFilePath();
-    return loadJsonArray(filePath);
+    return fetchOfflineMessages().result();
 }
 
 void ChatHistoryManager::clearOfflineMessages()
 {
-    QString filePath = getOfflineMessagesFilePath();
-    QJsonArray emptyArray;
-    saveJsonArray(filePath, emptyArray);
-    qDebug() << "离线消息已清空";
+    ChatHistoryWorker *worker = m_worker;
+    postToWorker([worker]() {
+        worker->clearOfflineMessages();
+    });
 }
 
 QJsonArray ChatHistoryManager::getRecentChats(int count)
 {
-    QString filePath = getRecentChatsFilePath();
-    QJsonObject recentChatsObj = loadJsonObject(filePath);
-    QJsonArray chats = recentChatsObj["chats"].toArray();
-    
-    // 按最后消息时间排序并限制数量
-    QJsonArray result;
-    int actualCount = qMin(count, chats.size());
-    for (int i = 0; i < actualCount; ++i) {
-        result.append(chats[i]);
+    return m_recentChats.toJson(count);
+}
+
+int ChatHistoryManager::unreadCount(const QString &chatId, bool isGroup) const
+{
+    return m_recentChats.unreadCount(chatId, isGroup);
+}
+
+void ChatHistoryManager::markChatAsRead(const QString &chatId, bool isGroup)
+{
+    if (m_recentChats.markAllRead(chatId, isGroup)) {
+        emit unreadCountChanged(chatId, isGroup, 0);
+        scheduleRecentChatsFlush();
     }
-    
-    return result;
 }
 
 void ChatHistoryManager::clearChatHistory(const QString &chatId, bool isGroup)
 {
-    QString filePath = isGroup ? getGroupChatFilePath(chatId) : getPrivateChatFilePath(chatId);
-    QJsonArray emptyArray;
-    saveJsonArray(filePath, emptyArray);
+    ChatHistoryWorker *worker = m_worker;
+    QString chatKey = isGroup ? getGroupChatKey(chatId) : getPrivateChatKey(chatId);
+    m_cache.remove(chatKey);
+    bumpChatVersion(chatKey);
+    m_recentChats.remove(chatId, isGroup);
+    scheduleRecentChatsFlush();
+    emit recentChatsChanged();
+    postToWorker([worker, chatKey]() {
+        worker->clearChatHistory(chatKey);
+    });
     qDebug() << "聊天记录已清空:" << chatId;
 }
 
 void ChatHistoryManager::clearAllHistory()
 {
-    // 清空所有聊天文件夹
-    QDir privateChatsDir(QDir(m_userDataDir).filePath("private_chats"));
-    QDir groupChatsDir(QDir(m_userDataDir).filePath("group_chats"));
-    
-    // 删除所有私聊文件
-    QStringList privateFiles = privateChatsDir.entryList(QStringList() << "*.json", QDir::Files);
-    for (const QString &fileName : privateFiles) {
-        privateChatsDir.remove(fileName);
-    }
-    
-    // 删除所有群聊文件
-    QStringList groupFiles = groupChatsDir.entryList(QStringList() << "*.json", QDir::Files);
-    for (const QString &fileName : groupFiles) {
-        groupChatsDir.remove(fileName);
-    }
-    
-    // 清空最近聊天
-    QJsonObject emptyObj;
-    emptyObj["chats"] = QJsonArray();
-    saveJsonObject(getRecentChatsFilePath(), emptyObj);
-    
-    qDebug() << "所有聊天记录已清空";
-}
+    m_cache.clear();
+    m_chatVersions.clear();
+    ++m_cacheGeneration;
 
-// 私有方法实现
+    // 工作线程会同时清空最近聊天文件
+    m_recentChats.clear();
+    m_recentChatsTimer.stop();
+    m_recentChatsDirty = false;
+    emit recentChatsChanged();
 
-QString ChatHistoryManager::getPrivateChatFilePath(const QString &otherUserId) const
-{
-    return QDir(m_userDataDir).filePath(QString("private_chats/%1.json").arg(otherUserId));
+    ChatHistoryWorker *worker = m_worker;
+    postToWorker([worker]() {
+        worker->clearAllHistory();
+    });
+    qDebug() << "所有聊天记录已清空";
 }
 
-QString ChatHistoryManager::getGroupChatFilePath(const QString &groupId) const
+void ChatHistoryManager::setCacheLimits(int windowSize, qint64 memoryBudgetBytes)
 {
-    return QDir(m_userDataDir).filePath(QString("group_chats/group_%1.json").arg(groupId));
+    m_cache.setLimits(windowSize, memoryBudgetBytes);
 }
 
-QString ChatHistoryManager::getOfflineMessagesFilePath() const
+QVariantMap ChatHistoryManager::cacheStatistics() const
 {
-    return QDir(m_userDataDir).filePath("offline_messages.json");
+    quint64 lookups = m_cache.hitCount() + m_cache.missCount();
+
+    QVariantMap stats;
+    stats["hits"] = m_cache.hitCount();
+    stats["misses"] = m_cache.missCount();
+    stats["hitRate"] = lookups > 0 ? static_cast<double>(m_cache.hitCount()) / lookups : 0.0;
+    stats["cachedChats"] = m_cache.chatCount();
+    stats["memoryUsage"] = m_cache.memoryUsage();
+    stats["memoryBudget"] = m_cache.memoryBudget();
+    stats["windowSize"] = m_cache.windowSize();
+    return stats;
 }
 
-QString ChatHistoryManager::getRecentChatsFilePath() const
+bool ChatHistoryManager::setStorageFormat(const QString &format)
 {
-    return QDir(m_userDataDir).filePath("recent_chats.json");
+    ChatLogStore::RecordFormat recordFormat;
+    if (!parseStorageFormat(format, &recordFormat)) {
+        qWarning() << "未知的存储格式:" << format;
+        return false;
+    }
+
+    m_storageFormat = recordFormat;
+    ChatHistoryWorker *worker = m_worker;
+    postToWorker([worker, recordFormat]() {
+        worker->setRecordFormat(recordFormat);
+    });
+    return true;
 }
 
-QJsonArray ChatHistoryManager::loadJsonArray(const QString &filePath) const
+QString ChatHistoryManager::storageFormat() const
 {
-    qDebug() << "尝试加载JSON数组文件:" << filePath;
-    
-    QFile file(filePath);
-    if (!file.open(QIODevice::ReadOnly)) {
-        qDebug() << "文件不存在或无法打开:" << filePath;
-        return QJsonArray(); // 返回空数组
-    }
-    
-    QByteArray data = file.readAll();
-    qDebug() << "文件大小:" << data.size() << "字节";
-    
-    if (data.isEmpty()) {
-        qDebug() << "文件为空:" << filePath;
-        return QJsonArray();
-    }
-    
-    QJsonParseError error;
-    QJsonDocument doc = QJsonDocument::fromJson(data, &error);
-    
-    if (error.error != QJsonParseError::NoError) {
-        qWarning() << "解析JSON文件失败:" << filePath << error.errorString();
-        return QJsonArray();
-    }
-    
-    QJsonArray result = doc.array();
-    qDebug() << "成功加载JSON数组，元素数量:" << result.size();
-    return result;
+    return m_storageFormat == ChatLogStore::RecordFormat::Json ? "json" : "binary";
 }
 
-bool ChatHistoryManager::saveJsonArray(const QString &filePath, const QJsonArray &array)
+bool ChatHistoryManager::convertHistory(const QString &format)
 {
-    // 确保目录存在
-    QFileInfo fileInfo(filePath);
-    ensureDirectoryExists(fileInfo.absolutePath());
-    
-    QFile file(filePath);
-    if (!file.open(QIODevice::WriteOnly)) {
-        qWarning() << "无法写入文件:" << filePath;
+    ChatLogStore::RecordFormat recordFormat;
+    if (!parseStorageFormat(format, &recordFormat)) {
+        qWarning() << "未知的存储格式:" << format;
         return false;
     }
-    
-    QJsonDocument doc(array);
-    file.write(doc.toJson());
+
+    // 转换只改变磁盘上的编码，缓存中的记录仍然有效
+    m_storageFormat = recordFormat;
+    ChatHistoryWorker *worker = m_worker;
+    runOnWorker<int>([worker, recordFormat]() {
+        return worker->convertHistory(recordFormat);
+    }).then(this, [this](int chatCount) {
+        emit historyConverted(chatCount);
+    });
     return true;
 }
 
-QJsonObject ChatHistoryManager::loadJsonObject(const QString &filePath) const
+// 私有方法实现
+
+bool ChatHistoryManager::parseStorageFormat(const QString &format, ChatLogStore::RecordFormat *result)
 {
-    QFile file(filePath);
-    if (!file.open(QIODevice::ReadOnly)) {
-        return QJsonObject(); // 返回空对象
+    if (format.compare("binary", Qt::CaseInsensitive) == 0) {
+        *result = ChatLogStore::RecordFormat::Binary;
+        return true;
     }
-    
-    QByteArray data = file.readAll();
-    QJsonParseError error;
-    QJsonDocument doc = QJsonDocument::fromJson(data, &error);
-    
-    if (error.error != QJsonParseError::NoError) {
-        qWarning() << "解析JSON文件失败:" << filePath << error.errorString();
-        return QJsonObject();
+    if (format.compare("json", Qt::CaseInsensitive) == 0) {
+        *result = ChatLogStore::RecordFormat::Json;
+        return true;
     }
-    
-    return doc.object();
+    return false;
 }
 
-bool ChatHistoryManager::saveJsonObject(const QString &filePath, const QJsonObject &object)
+void ChatHistoryManager::bumpChatVersion(const QString &chatKey)
 {
-    // 确保目录存在
-    QFileInfo fileInfo(filePath);
-    ensureDirectoryExists(fileInfo.absolutePath());
-    
-    QFile file(filePath);
-    if (!file.open(QIODevice::WriteOnly)) {
-        qWarning() << "无法写入文件:" << filePath;
-        return false;
-    }
-    
-    QJsonDocument doc(object);
-    file.write(doc.toJson());
-    return true;
+    ++m_chatVersions[chatKey];
 }
 
-QJsonObject ChatHistoryManager::createMessageObject(const QString &fromUserId, const QString &content,
-                                                   const QString &messageId, qint64 timestamp) const
-{
-    QJsonObject messageObj;
-    messageObj["fromUserId"] = fromUserId;
-    messageObj["content"] = content;
-    messageObj["messageId"] = messageId.isEmpty() ? QString::number(QDateTime::currentMSecsSinceEpoch()) : messageId;
-    messageObj["timestamp"] = timestamp == 0 ? QDateTime::currentMSecsSinceEpoch() : timestamp;
-    messageObj["isRead"] = false;
-    messageObj["recalled"] = false;
-    
-    return messageObj;
-}
-
-void ChatHistoryManager::updateRecentChats(const QString &chatId, const QString &chatName, 
-                                         const QString &lastMessage, bool isGroup)
-{
-    QString filePath = getRecentChatsFilePath();
-    QJsonObject recentChatsObj = loadJsonObject(filePath);
-    QJsonArray chats = recentChatsObj.value("chats").toArray();
-    
-    // 查找是否已存在此聊天
-    int existingIndex = -1;
-    for (int i = 0; i < chats.size(); ++i) {
-        QJsonObject chat = chats[i].toObject();
-        if (chat["chatId"].toString() == chatId && chat["isGroup"].toBool() == isGroup) {
-            existingIndex = i;
-            break;
-        }
+void ChatHistoryManager::touchRecentChat(const QString &chatId, bool isGroup, const ChatRecord &record)
+{
+    // 别人发来的消息计入未读
+    QString chatName = isGroup ? "群聊 " + chatId : chatId; // 这里可以后续优化为显示名称
+    bool unread = record.fromUserId != m_currentUserId;
+    const RecentChatsIndex::Entry &entry = m_recentChats.touch(chatId, isGroup, chatName,
+                                                               record.content, record.timestamp, unread);
+    emit recentChatUpdated(chatId, isGroup, entry.lastMessage, entry.unreadCount);
+    scheduleRecentChatsFlush();
+}
+
+void ChatHistoryManager::scheduleRecentChatsFlush()
+{
+    m_recentChatsDirty = true;
+    if (!m_recentChatsTimer.isActive()) {
+        m_recentChatsTimer.start();
     }
-    
-    // 创建或更新聊天对象
-    QJsonObject chatObj;
-    chatObj["chatId"] = chatId;
-    chatObj["chatName"] = chatName;
-    chatObj["lastMessage"] = lastMessage;
-    chatObj["lastMessageTime"] = QDateTime::currentMSecsSinceEpoch();
-    chatObj["isGroup"] = isGroup;
-    chatObj["unreadCount"] = 0; // 这里可以后续实现未读计数
-    
-    if (existingIndex >= 0) {
-        // 更新现有聊天
-        chats[existingIndex] = chatObj;
-    } else {
-        // 添加新聊天到开头
-        chats.prepend(chatObj);
+}
+
+void ChatHistoryManager::flushRecentChats()
+{
+    m_recentChatsTimer.stop();
+    if (!m_recentChatsDirty) {
+        return;
     }
-    
-    // 限制最近聊天数量
-    while (chats.size() > 50) {
-        chats.removeLast();
+    m_recentChatsDirty = false;
+
+    ChatHistoryWorker *worker = m_worker;
+    QJsonArray chats = m_recentChats.toJson();
+    postToWorker([worker, chats]() {
+        worker->saveRecentChats(chats);
+    });
+}
+
+QString ChatHistoryManager::getPrivateChatKey(const QString &otherUserId) const
+{
+    return QString("private_chats/%1").arg(otherUserId);
+}
+
+QString ChatHistoryManager::getGroupChatKey(const QString &groupId) const
+{
+    return QString("group_chats/group_%1").arg(groupId);
+}
+
+ChatRecord ChatHistoryManager::createMessageRecord(const QString &fromUserId, const QString &content,
+                                                  const QString &messageId, qint64 timestamp) const
+{
+    ChatRecord record;
+    record.fromUserId = fromUserId;
+    record.content = content;
+    // 消息ID是日志和ids.idx中的键，缺失时生成不会重复的ID
+    record.messageId = messageId.isEmpty() ? QUuid::createUuid().toString(QUuid::WithoutBraces) : messageId;
+    record.timestamp = timestamp == 0 ? QDateTime::currentMSecsSinceEpoch() : timestamp;
+    record.isRead = false;
+    record.recalled = false;
+
+    return record;
+}
+
+QJsonArray ChatHistoryManager::recordsToJsonArray(const QList<ChatRecord> &records) const
+{
+    QJsonArray result;
+    for (const ChatRecord &record : records) {
+        result.append(record.toJson());
     }
-    
-    recentChatsObj["chats"] = chats;
-    saveJsonObject(filePath, recentChatsObj);
+    return result;
 }
 
 bool ChatHistoryManager::ensureDirectoryExists(const QString &dirPath)
@@ -0,0 +1,544 @@
+#include "include/ChatHistoryWorker.h"
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDateTime>
+#include <QJsonParseError>
+
+ChatHistoryWorker::ChatHistoryWorker(QObject *parent)
+    : QObject(parent)
+    , m_logStore(std::make_unique<ChatLogStore>())
+    , m_searchIndex(std::make_unique<ChatSearchIndex>())
+    , m_writeFailed(false)
+{
+    // 追加合并定时器，随工作对象一起移动到工作线程
+    m_flushTimer = std::make_unique<QTimer>(this);
+    m_flushTimer->setSingleShot(true);
+    m_flushTimer->setInterval(kWriteCoalesceMs);
+    connect(m_flushTimer.get(), &QTimer::timeout,
+            this, &ChatHistoryWorker::flushPendingWrites);
+
+    // 组提交定时器，合并多次写入的磁盘同步
+    m_commitTimer = std::make_unique<QTimer>(this);
+    m_commitTimer->setSingleShot(true);
+    m_commitTimer->setInterval(kGroupCommitMs);
+    connect(m_commitTimer.get(), &QTimer::timeout,
+            this, &ChatHistoryWorker::commitPendingWrites);
+}
+
+ChatHistoryWorker::~ChatHistoryWorker()
+{
+    // 退出前写入并同步尚未落盘的消息
+    commitPendingWrites();
+}
+
+int ChatHistoryWorker::initialize(const QString &userDataDir)
+{
+    // 切换用户前提交上一个用户的写入
+    commitPendingWrites();
+    m_journal.close();
+    m_writeFailed = false;
+    m_userDataDir = userDataDir;
+    
+    if (!ensureDirectoryExists(m_userDataDir)) {
+        qWarning() << "无法创建用户数据目录:" << m_userDataDir;
+        return -1;
+    }
+    
+    // 创建子目录
+    ensureDirectoryExists(QDir(m_userDataDir).filePath("private_chats"));
+    ensureDirectoryExists(QDir(m_userDataDir).filePath("group_chats"));
+    
+    // 打开分段日志存储，并迁移旧版JSON聊天文件
+    m_logStore->setRootDir(m_userDataDir);
+    m_logStore->recover();
+    m_searchIndex->open(QDir(m_userDataDir).filePath("search"));
+    migrateLegacyHistory();
+
+    // 重放上次未提交的消息，连同迁移的数据一起同步到磁盘
+    replayJournal();
+    commitPendingWrites();
+
+    // 为还没有索引的历史记录(旧数据或索引丢失)补建索引
+    indexBacklog();
+    
+    return loadOfflineMessages().size();
+}
+
+void ChatHistoryWorker::appendRecord(const QString &chatKey, const QString &chatId, const ChatRecord &record)
+{
+    // 先写预写日志，进程在合并窗口内退出也不会丢失
+    m_journal.append(chatKey, chatId, record);
+    queueRecord(chatKey, chatId, record);
+    scheduleCommit();
+}
+
+void ChatHistoryWorker::queueRecord(const QString &chatKey, const QString &chatId, const ChatRecord &record)
+{
+    PendingChat &pending = m_pendingWrites[chatKey];
+    pending.chatId = chatId;
+    pending.isGroup = record.isGroup;
+    pending.records.append(record);
+    
+    if (!m_flushTimer->isActive()) {
+        m_flushTimer->start();
+    }
+}
+
+void ChatHistoryWorker::flushPendingWrites()
+{
+    if (m_pendingWrites.isEmpty()) {
+        return;
+    }
+    
+    m_flushTimer->stop();
+    QHash<QString, PendingChat> pendingWrites;
+    pendingWrites.swap(m_pendingWrites);
+    
+    int flushedCount = 0;
+    for (auto it = pendingWrites.constBegin(); it != pendingWrites.constEnd(); ++it) {
+        const PendingChat &pending = it.value();
+        
+        // 同一会话的多条消息一次写入
+        quint32 firstRecord = m_logStore->recordCount(it.key());
+        if (!m_logStore->append(it.key(), pending.records)) {
+            qWarning() << "保存聊天消息失败:" << it.key() << "消息数量:" << pending.records.size();
+            // 放回队列，下次提交时重试，预写日志保留到写入成功为止
+            m_pendingWrites.insert(it.key(), pending);
+            continue;
+        }
+        flushedCount += pending.records.size();
+        m_searchIndex->addRecords(it.key(), firstRecord, pending.records);
+    }
+    
+    m_writeFailed = !m_pendingWrites.isEmpty();
+    if (m_writeFailed) {
+        scheduleCommit();
+    }
+
+    if (flushedCount > 0) {
+        qDebug() << "聊天消息已批量保存，数量:" << flushedCount;
+        emit recordsFlushed(flushedCount);
+    }
+}
+
+void ChatHistoryWorker::commitPendingWrites()
+{
+    m_commitTimer->stop();
+
+    // 每次组提交先把预写日志同步到磁盘，掉电后也能重放
+    if (!m_journal.sync()) {
+        qWarning() << "同步预写日志失败";
+    }
+    flushPendingWrites();
+
+    if (!m_logStore->sync()) {
+        return;
+    }
+
+    // 全部写入已持久化，预写日志中的条目不再需要
+    if (!m_writeFailed) {
+        m_journal.reset();
+    }
+}
+
+QList<ChatRecord> ChatHistoryWorker::readMessages(const QString &chatKey, int count, int offset)
+{
+    // 读之前先落盘，保证能读到刚追加的消息
+    flushPendingWrites();
+    return m_logStore->readTail(chatKey, count, offset);
+}
+
+HistoryPage ChatHistoryWorker::readPage(const QString &chatKey, const HistoryCursor &cursor, int count)
+{
+    flushPendingWrites();
+    return m_logStore->readPage(chatKey, cursor, count);
+}
+
+QVariantList ChatHistoryWorker::searchMessages(const QString &query, int limit)
+{
+    flushPendingWrites();
+
+    // 撤回的消息仍在索引中，多取一些候选再按记录过滤
+    QVariantList results;
+    const QList<ChatSearchIndex::Hit> hits = m_searchIndex->search(query, limit * 2);
+    for (const ChatSearchIndex::Hit &hit : hits) {
+        if (results.size() >= limit) {
+            break;
+        }
+
+        const QList<ChatRecord> records = m_logStore->readRecords(hit.chatKey, hit.record, hit.record + 1);
+        if (records.isEmpty() || records.first().recalled) {
+            continue;
+        }
+
+        const ChatRecord &record = records.first();
+        bool isGroup = hit.chatKey.startsWith("group_chats/");
+        QVariantMap result;
+        result["type"] = isGroup ? "group" : "private";
+        result["chatId"] = isGroup ? hit.chatKey.mid(QString("group_chats/group_").size())
+                                   : hit.chatKey.mid(QString("private_chats/").size());
+        result["messageId"] = record.messageId;
+        result["fromUserId"] = record.fromUserId;
+        result["content"] = record.content;
+        result["timestamp"] = record.timestamp;
+        results.append(result);
+    }
+    return results;
+}
+
+bool ChatHistoryWorker::markMessageAsRead(const QString &chatKey, const QString &messageId)
+{
+    // 消息可能还在合并队列中，先落盘再按ID索引定位
+    flushPendingWrites();
+    scheduleCommit();
+    return m_logStore->updateFlags(chatKey, messageId, ChatLogStore::kFlagRead);
+}
+
+bool ChatHistoryWorker::recallMessage(const QString &chatKey, const QString &messageId)
+{
+    flushPendingWrites();
+    scheduleCommit();
+    return m_logStore->updateFlags(chatKey, messageId, ChatLogStore::kFlagRecalled);
+}
+
+void ChatHistoryWorker::saveOfflineMessage(const QJsonObject &messageData)
+{
+    QString filePath = getOfflineMessagesFilePath();
+    QJsonArray offlineMessages = loadJsonArray(filePath);
+    
+    // 添加时间戳
+    QJsonObject msgObj = messageData;
+    msgObj["receivedAt"] = QDateTime::currentMSecsSinceEpoch();
+    
+    offlineMessages.append(msgObj);
+    
+    if (saveJsonArray(filePath, offlineMessages)) {
+        qDebug() << "离线消息已保存";
+    }
+}
+
+QJsonArray ChatHistoryWorker::loadOfflineMessages()
+{
+    QString filePath = getOfflineMessagesFilePath();
+    return loadJsonArray(filePath);
+}
+
+void ChatHistoryWorker::clearOfflineMessages()
+{
+    QString filePath = getOfflineMessagesFilePath();
+    QJsonArray emptyArray;
+    saveJsonArray(filePath, emptyArray);
+    qDebug() << "离线消息已清空";
+}
+
+QJsonArray ChatHistoryWorker::loadRecentChats()
+{
+    QString filePath = getRecentChatsFilePath();
+    QJsonObject recentChatsObj = loadJsonObject(filePath);
+    return recentChatsObj["chats"].toArray();
+}
+
+void ChatHistoryWorker::saveRecentChats(const QJsonArray &chats)
+{
+    QJsonObject recentChatsObj;
+    recentChatsObj["chats"] = chats;
+    saveJsonObject(getRecentChatsFilePath(), recentChatsObj);
+}
+
+QJsonObject ChatHistoryWorker::loadContactList(const QString &listName)
+{
+    return loadJsonObject(getContactListFilePath(listName));
+}
+
+void ChatHistoryWorker::saveContactList(const QString &listName, const QJsonObject &list)
+{
+    saveJsonObject(getContactListFilePath(listName), list);
+}
+
+void ChatHistoryWorker::clearChatHistory(const QString &chatKey)
+{
+    // 先提交其他会话的写入，避免预写日志重放时恢复已清空的会话
+    m_pendingWrites.remove(chatKey);
+    commitPendingWrites();
+    m_logStore->clear(chatKey);
+    m_searchIndex->removeChat(chatKey);
+}
+
+void ChatHistoryWorker::clearAllHistory()
+{
+    m_pendingWrites.clear();
+    m_commitTimer->stop();
+    m_writeFailed = false;
+    m_journal.reset();
+    m_searchIndex->clear();
+    
+    // 关闭所有会话日志后清空聊天文件夹
+    m_logStore->closeAll();
+    
+    const QStringList chatDirs = {"private_chats", "group_chats"};
+    for (const QString &subDir : chatDirs) {
+        QString dirPath = QDir(m_userDataDir).filePath(subDir);
+        QDir(dirPath).removeRecursively();
+        ensureDirectoryExists(dirPath);
+    }
+    
+    // 清空最近聊天
+    QJsonObject emptyObj;
+    emptyObj["chats"] = QJsonArray();
+    saveJsonObject(getRecentChatsFilePath(), emptyObj);
+}
+
+void ChatHistoryWorker::setRecordFormat(ChatLogStore::RecordFormat format)
+{
+    m_logStore->setRecordFormat(format);
+}
+
+int ChatHistoryWorker::convertHistory(ChatLogStore::RecordFormat format)
+{
+    flushPendingWrites();
+
+    // 逐个会话重写，返回成功转换的会话数量
+    int converted = 0;
+    const QStringList chatDirs = {"private_chats", "group_chats"};
+    for (const QString &subDir : chatDirs) {
+        QDir dir(QDir(m_userDataDir).filePath(subDir));
+        const QStringList chatNames = dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+        for (const QString &chatName : chatNames) {
+            if (chatName.endsWith(".converting") || chatName.endsWith(".old")) {
+                continue;
+            }
+            if (m_logStore->convert(subDir + "/" + chatName, format)) {
+                ++converted;
+            }
+        }
+    }
+
+    m_logStore->setRecordFormat(format);
+    qDebug() << "聊天记录格式转换完成，会话数:" << converted;
+    return converted;
+}
+
+// 私有方法实现
+
+QString ChatHistoryWorker::getJournalFilePath() const
+{
+    return QDir(m_userDataDir).filePath("journal.wal");
+}
+
+QString ChatHistoryWorker::getOfflineMessagesFilePath() const
+{
+    return QDir(m_userDataDir).filePath("offline_messages.json");
+}
+
+QString ChatHistoryWorker::getRecentChatsFilePath() const
+{
+    return QDir(m_userDataDir).filePath("recent_chats.json");
+}
+
+QString ChatHistoryWorker::getContactListFilePath(const QString &listName) const
+{
+    return QDir(m_userDataDir).filePath(QString("contacts_%1.json").arg(listName));
+}
+
+void ChatHistoryWorker::scheduleCommit()
+{
+    if (!m_commitTimer->isActive()) {
+        m_commitTimer->start();
+    }
+}
+
+void ChatHistoryWorker::replayJournal()
+{
+    const QList<ChatJournal::Entry> entries = m_journal.open(getJournalFilePath());
+    if (entries.isEmpty()) {
+        return;
+    }
+
+    // 已写入分段日志的条目按消息ID跳过，其余重新排队
+    int replayed = 0;
+    for (const ChatJournal::Entry &entry : entries) {
+        if (m_logStore->findRecord(entry.chatKey, entry.record.messageId) >= 0) {
+            continue;
+        }
+        queueRecord(entry.chatKey, entry.chatId, entry.record);
+        ++replayed;
+    }
+
+    qDebug() << "从预写日志恢复消息:" << replayed << "/" << entries.size();
+}
+
+void ChatHistoryWorker::indexBacklog()
+{
+    int indexed = 0;
+    const QStringList chatDirs = {"private_chats", "group_chats"};
+    for (const QString &subDir : chatDirs) {
+        QDir dir(QDir(m_userDataDir).filePath(subDir));
+        const QStringList chatNames = dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+        for (const QString &chatName : chatNames) {
+            QString chatKey = subDir + "/" + chatName;
+            quint32 recordCount = m_logStore->recordCount(chatKey);
+            quint32 start = m_searchIndex->indexedCount(chatKey);
+
+            // 索引比记录还多说明会话被清空或重建过，整体重建
+            if (start > recordCount) {
+                m_searchIndex->removeChat(chatKey);
+                start = 0;
+            }
+
+            while (start < recordCount) {
+                quint32 end = qMin<quint32>(recordCount, start + kIndexBatchSize);
+                QList<ChatRecord> records = m_logStore->readRecords(chatKey, start, end);
+                if (records.size() != static_cast<qsizetype>(end - start)
+                    || !m_searchIndex->addRecords(chatKey, start, records)) {
+                    qWarning() << "补建搜索索引失败:" << chatKey;
+                    break;
+                }
+                indexed += records.size();
+                start = end;
+            }
+        }
+    }
+
+    if (indexed > 0) {
+        qDebug() << "已为历史消息补建搜索索引，数量:" << indexed;
+    }
+}
+
+QJsonArray ChatHistoryWorker::loadJsonArray(const QString &filePath) const
+{
+    qDebug() << "尝试加载JSON数组文件:" << filePath;
+    
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qDebug() << "文件不存在或无法打开:" << filePath;
+        return QJsonArray(); // 返回空数组
+    }
+    
+    QByteArray data = file.readAll();
+    qDebug() << "文件大小:" << data.size() << "字节";
+    
+    if (data.isEmpty()) {
+        qDebug() << "文件为空:" << filePath;
+        return QJsonArray();
+    }
+    
+    QJsonParseError error;
+    QJsonDocument doc = QJsonDocument::fromJson(data, &error);
+    
+    if (error.error != QJsonParseError::NoError) {
+        qWarning() << "解析JSON文件失败:" << filePath << error.errorString();
+        preserveCorruptFile(filePath);
+        return QJsonArray();
+    }
+    
+    QJsonArray result = doc.array();
+    qDebug() << "成功加载JSON数组，元素数量:" << result.size();
+    return result;
+}
+
+bool ChatHistoryWorker::saveJsonArray(const QString &filePath, const QJsonArray &array)
+{
+    // 确保目录存在
+    QFileInfo fileInfo(filePath);
+    ensureDirectoryExists(fileInfo.absolutePath());
+    
+    return writeFileAtomically(filePath, QJsonDocument(array).toJson());
+}
+
+QJsonObject ChatHistoryWorker::loadJsonObject(const QString &filePath) const
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QJsonObject(); // 返回空对象
+    }
+    
+    QByteArray data = file.readAll();
+    QJsonParseError error;
+    QJsonDocument doc = QJsonDocument::fromJson(data, &error);
+    
+    if (error.error != QJsonParseError::NoError) {
+        qWarning() << "解析JSON文件失败:" << filePath << error.errorString();
+        preserveCorruptFile(filePath);
+        return QJsonObject();
+    }
+    
+    return doc.object();
+}
+
+bool ChatHistoryWorker::saveJsonObject(const QString &filePath, const QJsonObject &object)
+{
+    // 确保目录存在
+    QFileInfo fileInfo(filePath);
+    ensureDirectoryExists(fileInfo.absolutePath());
+    
+    return writeFileAtomically(filePath, QJsonDocument(object).toJson());
+}
+
+bool ChatHistoryWorker::writeFileAtomically(const QString &filePath, const QByteArray &data)
+{
+    // 写入临时文件并同步后替换目标文件，中途崩溃不会留下截断的文件
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "无法写入文件:" << filePath << file.errorString();
+        return false;
+    }
+
+    if (file.write(data) != data.size() || !file.commit()) {
+        qWarning() << "写入文件失败:" << filePath << file.errorString();
+        return false;
+    }
+    return true;
+}
+
+void ChatHistoryWorker::preserveCorruptFile(const QString &filePath)
+{
+    // 保留损坏的文件供排查，避免下一次保存把它覆盖
+    QString backupPath = filePath + ".corrupt";
+    QFile::remove(backupPath);
+    if (QFile::rename(filePath, backupPath)) {
+        qWarning() << "损坏的文件已另存为:" << backupPath;
+    }
+}
+
+bool ChatHistoryWorker::ensureDirectoryExists(const QString &dirPath)
+{
+    QDir dir;
+    if (!dir.exists(dirPath)) {
+        return dir.mkpath(dirPath);
+    }
+    return true;
+}
+
+void ChatHistoryWorker::migrateLegacyHistory()
+{
+    // 旧版本每个会话一个JSON数组文件，迁移到分段日志后重命名为 *.json.migrated
+    const QStringList chatDirs = {"private_chats", "group_chats"};
+    for (const QString &subDir : chatDirs) {
+        QDir dir(QDir(m_userDataDir).filePath(subDir));
+        const QStringList jsonFiles = dir.entryList(QStringList() << "*.json", QDir::Files);
+        
+        for (const QString &fileName : jsonFiles) {
+            QString chatKey = subDir + "/" + QFileInfo(fileName).completeBaseName();
+            QJsonArray messages = loadJsonArray(dir.filePath(fileName));
+            
+            QList<ChatRecord> records;
+            records.reserve(messages.size());
+            for (const auto &value : messages) {
+                if (value.isObject()) {
+                    records.append(ChatRecord::fromJson(value.toObject()));
+                }
+            }
+            
+            // 上次迁移中断时日志可能只写了一部分，整体重写
+            if (m_logStore->replace(chatKey, records)) {
+                dir.rename(fileName, fileName + ".migrated");
+                qDebug() << "已迁移聊天记录:" << fileName << "消息数量:" << records.size();
+            } else {
+                qWarning() << "迁移聊天记录失败:" << fileName;
+            }
+        }
+    }
+}
@@ -0,0 +1,120 @@
+#include "include/ChatJournal.h"
+#include <QDebug>
+#include <QJsonDocument>
+#include <QtEndian>
+
+namespace {
+
+// 条目头: 负载长度(小端32位) + 负载的CRC-16校验(小端16位)
+constexpr int kEntryHeaderSize = 6;
+
+} // namespace
+
+ChatJournal::~ChatJournal()
+{
+    close();
+}
+
+QList<ChatJournal::Entry> ChatJournal::open(const QString &filePath)
+{
+    close();
+
+    QList<Entry> entries;
+    QByteArray data;
+    {
+        QFile existing(filePath);
+        if (existing.open(QIODevice::ReadOnly)) {
+            data = existing.readAll();
+        }
+    }
+
+    // 读取完整且校验通过的条目，遇到损坏处停止
+    qsizetype pos = 0;
+    while (pos + kEntryHeaderSize <= data.size()) {
+        const char *header = data.constData() + pos;
+        quint32 length = qFromLittleEndian<quint32>(header);
+        quint16 checksum = qFromLittleEndian<quint16>(header + 4);
+        if (length > static_cast<quint32>(data.size() - pos - kEntryHeaderSize)) {
+            break;
+        }
+
+        QByteArrayView payload(header + kEntryHeaderSize, length);
+        if (qChecksum(payload) != checksum) {
+            break;
+        }
+
+        QJsonObject object = QJsonDocument::fromJson(payload.toByteArray()).object();
+        Entry entry;
+        entry.chatKey = object.value("chatKey").toString();
+        entry.chatId = object.value("chatId").toString();
+        entry.record = ChatRecord::fromJson(object.value("record").toObject());
+        if (!entry.chatKey.isEmpty()) {
+            entries.append(entry);
+        }
+        pos += kEntryHeaderSize + length;
+    }
+
+    if (pos < data.size()) {
+        qWarning() << "预写日志末尾存在不完整的条目，已丢弃:" << filePath << "字节:" << data.size() - pos;
+        QFile::resize(filePath, pos);
+    }
+
+    m_file.setFileName(filePath);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qWarning() << "无法打开预写日志:" << filePath << m_file.errorString();
+    }
+    m_entryCount = entries.size();
+    return entries;
+}
+
+void ChatJournal::close()
+{
+    if (m_file.isOpen()) {
+        m_file.close();
+    }
+    m_entryCount = 0;
+}
+
+bool ChatJournal::append(const QString &chatKey, const QString &chatId, const ChatRecord &record)
+{
+    if (!m_file.isOpen()) {
+        return false;
+    }
+
+    QJsonObject object;
+    object["chatKey"] = chatKey;
+    object["chatId"] = chatId;
+    object["record"] = record.toJson();
+    QByteArray payload = QJsonDocument(object).toJson(QJsonDocument::Compact);
+
+    QByteArray entry(kEntryHeaderSize, Qt::Uninitialized);
+    qToLittleEndian(static_cast<quint32>(payload.size()), entry.data());
+    qToLittleEndian(static_cast<quint16>(qChecksum(payload)), entry.data() + 4);
+    entry.append(payload);
+
+    if (m_file.write(entry) != entry.size() || !m_file.flush()) {
+        qWarning() << "写入预写日志失败:" << m_file.fileName() << m_file.errorString();
+        return false;
+    }
+    ++m_entryCount;
+    return true;
+}
+
+bool ChatJournal::sync()
+{
+    return !m_file.isOpen() || ChatLogStore::syncToDisk(m_file);
+}
+
+bool ChatJournal::reset()
+{
+    if (!m_file.isOpen() || m_entryCount == 0) {
+        return true;
+    }
+
+    if (!m_file.resize(0)) {
+        qWarning() << "清空预写日志失败:" << m_file.fileName() << m_file.errorString();
+        return false;
+    }
+    m_entryCount = 0;
+    return true;
+}
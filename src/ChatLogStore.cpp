@@ -0,0 +1,1181 @@
+#include "include/ChatLogStore.h"
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QStringList>
+#include <QJsonDocument>
+#include <QCryptographicHash>
+#include <QtEndian>
+#include <array>
+#include <map>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+
+// 分段文件头: "SQLG" + 版本号 + 记录格式 + 2字节保留
+const char kSegmentMagic[4] = {'S', 'Q', 'L', 'G'};
+constexpr quint8 kSegmentVersion = 1;
+constexpr int kSegmentHeaderSize = 8;
+constexpr int kSegmentFormatOffset = 5;
+
+// 每条记录在分段中的帧头为4字节长度
+constexpr int kFrameHeaderSize = 4;
+
+// 索引项: 分段号 + 负载偏移 + 负载长度，均为小端32位
+constexpr int kIndexEntrySize = 12;
+
+const char kIndexFileName[] = "records.idx";
+
+// 消息ID索引项: 记录序号(小端32位) + 键长度(1字节) + 键(ID的UTF-8字节，过长时为摘要)
+const char kIdIndexFileName[] = "ids.idx";
+constexpr int kIdEntryHeaderSize = 5;
+constexpr int kMaxIdKeySize = 255;
+
+// 索引中保存的ID键，超过255字节的ID改存其摘要，内存和磁盘使用同一个键
+QByteArray idIndexKey(const QString &messageId)
+{
+    QByteArray id = messageId.toUtf8();
+    if (id.size() <= kMaxIdKeySize) {
+        return id;
+    }
+    return '\x01' + QCryptographicHash::hash(id, QCryptographicHash::Sha1).toHex();
+}
+
+// 状态增量项: 记录序号(小端32位) + 标志(1字节)
+const char kFlagsFileName[] = "flags.log";
+constexpr int kFlagsEntrySize = 5;
+
+// 会话内字符串字典(用户ID、群ID)，每项为varint长度 + UTF-8字节，序号即引用值
+const char kDictionaryFileName[] = "strings.dict";
+
+// 二进制记录:
+//   版本(1字节) 标志(1字节) 时间戳(varint) 消息ID(varint长度+字节)
+//   发送者(varint字典序号) 目标(varint字典序号) 内容(varint长度+字节) CRC32(小端4字节)
+constexpr quint8 kBinaryRecordVersion = 1;
+constexpr quint8 kBinaryFlagGroup = 0x04;
+constexpr int kBinaryRecordMinSize = 2 + 4;
+
+QString segmentFileName(quint32 segment)
+{
+    return QString("seg_%1.log").arg(segment, 6, 10, QChar('0'));
+}
+
+void appendUInt32(QByteArray &buffer, quint32 value)
+{
+    char bytes[4];
+    qToLittleEndian(value, bytes);
+    buffer.append(bytes, 4);
+}
+
+void appendVarint(QByteArray &buffer, quint64 value)
+{
+    while (value >= 0x80) {
+        buffer.append(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    buffer.append(static_cast<char>(value));
+}
+
+bool readVarint(const char *&cursor, const char *end, quint64 *value)
+{
+    quint64 result = 0;
+    for (int shift = 0; cursor < end && shift < 64; shift += 7) {
+        quint8 byte = static_cast<quint8>(*cursor++);
+        result |= static_cast<quint64>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+void appendString(QByteArray &buffer, const QString &text)
+{
+    QByteArray utf8 = text.toUtf8();
+    appendVarint(buffer, static_cast<quint64>(utf8.size()));
+    buffer.append(utf8);
+}
+
+bool readString(const char *&cursor, const char *end, QString *text)
+{
+    quint64 length = 0;
+    if (!readVarint(cursor, end, &length) || length > static_cast<quint64>(end - cursor)) {
+        return false;
+    }
+    *text = QString::fromUtf8(cursor, static_cast<qsizetype>(length));
+    cursor += length;
+    return true;
+}
+
+quint32 crc32(const char *data, qsizetype size)
+{
+    static const std::array<quint32, 256> table = [] {
+        std::array<quint32, 256> result{};
+        for (quint32 i = 0; i < 256; ++i) {
+            quint32 value = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                value = (value & 1) ? 0xEDB88320u ^ (value >> 1) : value >> 1;
+            }
+            result[i] = value;
+        }
+        return result;
+    }();
+
+    quint32 crc = 0xFFFFFFFFu;
+    for (qsizetype i = 0; i < size; ++i) {
+        crc = table[(crc ^ static_cast<quint8>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+QByteArray segmentHeader(quint8 format)
+{
+    QByteArray header(kSegmentMagic, 4);
+    header.append(static_cast<char>(kSegmentVersion));
+    header.append(static_cast<char>(format));
+    header.append(2, '\0');
+    return header;
+}
+
+} // namespace
+
+struct ChatLogStore::ChatLog
+{
+    QString dirPath;
+    QFile indexFile;
+    QFile segmentFile;
+    quint32 recordCount = 0;
+    quint32 activeSegment = 0;
+    qint64 activeSegmentSize = 0;
+    bool dirty = false;                 // 有尚未同步到磁盘的写入
+    quint64 lastUsed = 0;               // 最近一次openLog()的序号，用于淘汰
+
+    // 只读映射的分段，关闭文件时自动解除映射
+    struct MappedSegment {
+        std::unique_ptr<QFile> file;
+        const char *data = nullptr;
+        qint64 size = 0;
+    };
+    std::map<quint32, MappedSegment> mappedSegments;
+    ChatLogStore::RecordFormat activeFormat = ChatLogStore::RecordFormat::Json;
+    QHash<quint32, ChatLogStore::RecordFormat> segmentFormats;
+
+    // 按需加载的字符串字典
+    bool dictionaryLoaded = false;
+    QStringList dictionary;
+    QHash<QString, quint32> dictionaryIndex;
+
+    // 按需加载的消息ID索引和状态增量
+    bool idIndexLoaded = false;
+    QHash<QString, quint32> idIndex;
+    bool flagsLoaded = false;
+    QHash<quint32, quint8> flags;
+};
+
+// ChatRecord
+
+QJsonObject ChatRecord::toJson() const
+{
+    QJsonObject object;
+    object["fromUserId"] = fromUserId;
+    object["content"] = content;
+    object["messageId"] = messageId;
+    object["timestamp"] = timestamp;
+    object["isRead"] = isRead;
+    object["recalled"] = recalled;
+    if (isGroup) {
+        object["groupId"] = targetId;
+        object["type"] = "group";
+    } else {
+        object["toUserId"] = targetId;
+        object["type"] = "private";
+    }
+    return object;
+}
+
+ChatRecord ChatRecord::fromJson(const QJsonObject &object)
+{
+    ChatRecord record;
+    record.isGroup = object["type"].toString() == "group";
+    record.messageId = object["messageId"].toString();
+    record.fromUserId = object["fromUserId"].toString();
+    record.targetId = record.isGroup ? object["groupId"].toString() : object["toUserId"].toString();
+    record.content = object["content"].toString();
+    record.timestamp = object["timestamp"].toVariant().toLongLong();
+    record.isRead = object["isRead"].toBool();
+    record.recalled = object["recalled"].toBool();
+    return record;
+}
+
+// ChatLogStore
+
+ChatLogStore::ChatLogStore(const QString &rootDir)
+    : m_rootDir(rootDir)
+    , m_recordFormat(RecordFormat::Binary)
+    , m_useCounter(0)
+{
+}
+
+ChatLogStore::~ChatLogStore()
+{
+    closeAll();
+}
+
+void ChatLogStore::setRootDir(const QString &rootDir)
+{
+    if (m_rootDir != rootDir) {
+        closeAll();
+        m_rootDir = rootDir;
+    }
+}
+
+bool ChatLogStore::append(const QString &chatKey, const ChatRecord &record)
+{
+    return append(chatKey, QList<ChatRecord>{record});
+}
+
+bool ChatLogStore::append(const QString &chatKey, const QList<ChatRecord> &records)
+{
+    if (records.isEmpty()) {
+        return true;
+    }
+
+    ChatLog *log = openLog(chatKey, true);
+    if (!log) {
+        return false;
+    }
+
+    // 格式设置变化后从新分段开始使用新格式
+    if (log->activeFormat != m_recordFormat && !rollSegment(log)) {
+        return false;
+    }
+
+    QByteArray dictionaryData;
+    QByteArray segmentData;
+    QByteArray indexData;
+    indexData.reserve(records.size() * kIndexEntrySize);
+
+    // 新的字典项必须先于引用它们的记录落盘
+    auto writeDictionary = [&]() {
+        if (dictionaryData.isEmpty()) {
+            return true;
+        }
+        QFile dictionaryFile(QDir(log->dirPath).filePath(kDictionaryFileName));
+        if (!dictionaryFile.open(QIODevice::WriteOnly | QIODevice::Append)
+            || dictionaryFile.write(dictionaryData) != dictionaryData.size()) {
+            qWarning() << "写入字符串字典失败:" << dictionaryFile.fileName() << dictionaryFile.errorString();
+            // 丢弃内存中未落盘的字典项，下次从文件重新加载
+            log->dictionaryLoaded = false;
+            log->dictionary.clear();
+            log->dictionaryIndex.clear();
+            return false;
+        }
+        dictionaryData.clear();
+        return true;
+    };
+
+    for (const ChatRecord &record : records) {
+        QByteArray payload = encodeRecord(log, record, &dictionaryData);
+        qint64 frameSize = kFrameHeaderSize + payload.size();
+        qint64 pendingSize = log->activeSegmentSize + segmentData.size();
+
+        // 当前分段写满时先落盘已有数据，再滚动到新分段
+        if (pendingSize + frameSize > kSegmentSizeLimit && pendingSize > kSegmentHeaderSize) {
+            if (!writeDictionary() || !writeSegment(log, segmentData) || !rollSegment(log)) {
+                return false;
+            }
+            segmentData.clear();
+            pendingSize = log->activeSegmentSize;
+        }
+
+        appendUInt32(segmentData, static_cast<quint32>(payload.size()));
+        segmentData.append(payload);
+
+        appendUInt32(indexData, log->activeSegment);
+        appendUInt32(indexData, static_cast<quint32>(pendingSize + kFrameHeaderSize));
+        appendUInt32(indexData, static_cast<quint32>(payload.size()));
+    }
+
+    if (!writeDictionary() || !writeSegment(log, segmentData)) {
+        return false;
+    }
+
+    // 索引在数据之后写入，索引项存在即代表对应记录完整
+    if (log->indexFile.write(indexData) != indexData.size()) {
+        qWarning() << "写入记录索引失败:" << log->indexFile.fileName() << log->indexFile.errorString();
+        return false;
+    }
+    log->indexFile.flush();
+
+    quint32 firstRecord = log->recordCount;
+    log->recordCount += static_cast<quint32>(records.size());
+    log->dirty = true;
+
+    // 消息ID索引最后写入，缺失的部分在下次加载时根据记录补齐
+    appendIdIndex(log, firstRecord, records);
+    return true;
+}
+
+QList<ChatRecord> ChatLogStore::readTail(const QString &chatKey, int count, int offset)
+{
+    ChatLog *log = openLog(chatKey, false);
+    if (!log || count <= 0) {
+        return QList<ChatRecord>();
+    }
+
+    qint64 end = qMax<qint64>(0, static_cast<qint64>(log->recordCount) - qMax(0, offset));
+    qint64 start = qMax<qint64>(0, end - count);
+    return readRange(log, start, end);
+}
+
+QList<ChatRecord> ChatLogStore::readAll(const QString &chatKey)
+{
+    ChatLog *log = openLog(chatKey, false);
+    if (!log) {
+        return QList<ChatRecord>();
+    }
+    return readRange(log, 0, log->recordCount);
+}
+
+QList<ChatRecord> ChatLogStore::readRecords(const QString &chatKey, qint64 start, qint64 end)
+{
+    ChatLog *log = openLog(chatKey, false);
+    if (!log) {
+        return QList<ChatRecord>();
+    }
+    return readRange(log, qMax<qint64>(0, start), qMin<qint64>(end, log->recordCount));
+}
+
+HistoryPage ChatLogStore::readPage(const QString &chatKey, const HistoryCursor &cursor, int count)
+{
+    HistoryPage page;
+    ChatLog *log = openLog(chatKey, false);
+    if (!log || count <= 0) {
+        return page;
+    }
+
+    // 定位游标对应的记录序号，页在其之前结束
+    qint64 end = log->recordCount;
+    if (!cursor.messageId.isEmpty()) {
+        qint64 recordNumber = findRecord(chatKey, cursor.messageId);
+        if (recordNumber >= 0) {
+            end = recordNumber;
+        } else if (cursor.timestamp > 0) {
+            end = lowerBoundByTimestamp(log, cursor.timestamp);
+        } else {
+            qWarning() << "分页游标指向的消息不存在:" << chatKey << cursor.messageId;
+            return page;
+        }
+    } else if (cursor.timestamp > 0) {
+        end = lowerBoundByTimestamp(log, cursor.timestamp);
+    }
+
+    qint64 start = qMax<qint64>(0, end - count);
+    page.records = readRange(log, start, end);
+    page.hasMore = start > 0;
+    if (!page.records.isEmpty()) {
+        page.nextCursor.messageId = page.records.first().messageId;
+        page.nextCursor.timestamp = page.records.first().timestamp;
+    }
+    return page;
+}
+
+quint32 ChatLogStore::recordCount(const QString &chatKey)
+{
+    ChatLog *log = openLog(chatKey, false);
+    return log ? log->recordCount : 0;
+}
+
+qint64 ChatLogStore::findRecord(const QString &chatKey, const QString &messageId)
+{
+    ChatLog *log = openLog(chatKey, false);
+    if (!log || !loadIdIndex(log)) {
+        return -1;
+    }
+
+    auto it = log->idIndex.constFind(QString::fromUtf8(idIndexKey(messageId)));
+    return it != log->idIndex.constEnd() ? static_cast<qint64>(it.value()) : -1;
+}
+
+bool ChatLogStore::updateFlags(const QString &chatKey, const QString &messageId, quint8 flags)
+{
+    qint64 recordNumber = findRecord(chatKey, messageId);
+    if (recordNumber < 0) {
+        return false;
+    }
+
+    ChatLog *log = openLog(chatKey, false);
+    loadFlags(log);
+
+    quint32 record = static_cast<quint32>(recordNumber);
+    quint8 merged = log->flags.value(record) | flags;
+    if (merged == log->flags.value(record)) {
+        return true; // 状态未变化
+    }
+
+    QByteArray entry;
+    appendUInt32(entry, record);
+    entry.append(static_cast<char>(merged));
+
+    QFile flagsFile(QDir(log->dirPath).filePath(kFlagsFileName));
+    if (!flagsFile.open(QIODevice::WriteOnly | QIODevice::Append) || flagsFile.write(entry) != entry.size()) {
+        qWarning() << "写入消息状态失败:" << flagsFile.fileName() << flagsFile.errorString();
+        return false;
+    }
+
+    log->flags.insert(record, merged);
+    log->dirty = true;
+    return true;
+}
+
+bool ChatLogStore::exists(const QString &chatKey) const
+{
+    return m_logs.contains(chatKey) || QFileInfo::exists(QDir(chatDirPath(chatKey)).filePath(kIndexFileName));
+}
+
+bool ChatLogStore::replace(const QString &chatKey, const QList<ChatRecord> &records)
+{
+    clear(chatKey);
+    return append(chatKey, records);
+}
+
+void ChatLogStore::clear(const QString &chatKey)
+{
+    m_logs.remove(chatKey);
+
+    QDir dir(chatDirPath(chatKey));
+    if (dir.exists() && !dir.removeRecursively()) {
+        qWarning() << "无法删除会话目录:" << dir.path();
+    }
+}
+
+void ChatLogStore::closeAll()
+{
+    sync();
+    m_logs.clear();
+}
+
+bool ChatLogStore::sync()
+{
+    bool synced = true;
+    for (auto it = m_logs.constBegin(); it != m_logs.constEnd(); ++it) {
+        synced = syncLog(it.value().get()) && synced;
+    }
+    return synced;
+}
+
+void ChatLogStore::recover()
+{
+    if (m_rootDir.isEmpty()) {
+        return;
+    }
+
+    // convert()先把原目录改名为.old，再把.converting改名为原目录
+    const QStringList chatDirs = {"private_chats", "group_chats"};
+    for (const QString &subDir : chatDirs) {
+        QDir dir(QDir(m_rootDir).filePath(subDir));
+        const QStringList names = dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+        for (const QString &name : names) {
+            QString path = dir.filePath(name);
+            if (name.endsWith(".converting")) {
+                qWarning() << "清理未完成的格式转换:" << path;
+                QDir(path).removeRecursively();
+            } else if (name.endsWith(".old")) {
+                QString originalPath = path.chopped(4);
+                if (QFileInfo::exists(originalPath)) {
+                    QDir(path).removeRecursively();
+                } else {
+                    qWarning() << "格式转换中断，恢复原会话目录:" << originalPath;
+                    QDir().rename(path, originalPath);
+                }
+            }
+        }
+    }
+}
+
+bool ChatLogStore::syncToDisk(QFile &file)
+{
+    if (!file.isOpen() || !file.flush()) {
+        return false;
+    }
+#ifdef Q_OS_WIN
+    return _commit(file.handle()) == 0;
+#else
+    return ::fsync(file.handle()) == 0;
+#endif
+}
+
+bool ChatLogStore::convert(const QString &chatKey, RecordFormat format)
+{
+    ChatLog *log = openLog(chatKey, false);
+    if (!log) {
+        return false;
+    }
+
+    // 读出时已合并状态增量，新日志不再需要flags.log
+    QList<ChatRecord> records = readRange(log, 0, log->recordCount);
+    quint32 expectedCount = log->recordCount;
+    if (records.size() != static_cast<qsizetype>(expectedCount)) {
+        qWarning() << "会话存在无法读取的记录，放弃转换:" << chatKey;
+        return false;
+    }
+
+    // 先写入临时目录，完成后再替换原目录
+    QString tempKey = chatKey + ".converting";
+    clear(tempKey);
+
+    RecordFormat previousFormat = m_recordFormat;
+    m_recordFormat = format;
+    bool written = append(tempKey, records);
+    m_recordFormat = previousFormat;
+
+    m_logs.remove(tempKey);
+    m_logs.remove(chatKey);
+    if (!written) {
+        clear(tempKey);
+        return false;
+    }
+
+    QString dirPath = chatDirPath(chatKey);
+    QString backupPath = dirPath + ".old";
+    QDir(backupPath).removeRecursively();
+    if (!QDir().rename(dirPath, backupPath)) {
+        qWarning() << "无法替换会话目录:" << dirPath;
+        clear(tempKey);
+        return false;
+    }
+    if (!QDir().rename(chatDirPath(tempKey), dirPath)) {
+        qWarning() << "无法替换会话目录，恢复原数据:" << dirPath;
+        QDir().rename(backupPath, dirPath);
+        return false;
+    }
+    QDir(backupPath).removeRecursively();
+    return true;
+}
+
+// 私有方法实现
+
+QString ChatLogStore::chatDirPath(const QString &chatKey) const
+{
+    return QDir(m_rootDir).filePath(chatKey);
+}
+
+ChatLogStore::ChatLog *ChatLogStore::openLog(const QString &chatKey, bool create)
+{
+    auto it = m_logs.constFind(chatKey);
+    if (it != m_logs.constEnd()) {
+        it.value()->lastUsed = ++m_useCounter;
+        return it.value().get();
+    }
+
+    if (m_rootDir.isEmpty()) {
+        qWarning() << "存储根目录未设置，无法打开会话:" << chatKey;
+        return nullptr;
+    }
+
+    QString dirPath = chatDirPath(chatKey);
+    QString indexPath = QDir(dirPath).filePath(kIndexFileName);
+    if (!QFileInfo::exists(indexPath)) {
+        if (!create) {
+            return nullptr;
+        }
+        if (!QDir().mkpath(dirPath)) {
+            qWarning() << "无法创建会话目录:" << dirPath;
+            return nullptr;
+        }
+    }
+
+    // 打开的会话过多时关闭最久未使用的一个，最近返回的会话调用方可能仍在使用，不淘汰
+    if (m_logs.size() >= kMaxOpenLogs) {
+        evictLeastRecentlyUsed();
+    }
+
+    auto log = std::make_shared<ChatLog>();
+    log->dirPath = dirPath;
+    log->indexFile.setFileName(indexPath);
+
+    // 丢弃不完整的索引项，以及数据没有完整落盘的索引项
+    qint64 indexSize = QFileInfo(indexPath).size();
+    if (indexSize % kIndexEntrySize != 0) {
+        indexSize -= indexSize % kIndexEntrySize;
+        QFile::resize(indexPath, indexSize);
+    }
+    recoverTail(log.get(), indexSize);
+    log->recordCount = static_cast<quint32>(indexSize / kIndexEntrySize);
+
+    if (!log->indexFile.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qWarning() << "无法打开记录索引:" << indexPath << log->indexFile.errorString();
+        return nullptr;
+    }
+
+    // 活动分段为最后一条记录所在的分段，其后未被索引的数据是中断的写入
+    quint32 activeSegment = 0;
+    qint64 committedSize = kSegmentHeaderSize;
+    if (log->recordCount > 0) {
+        QFile index(indexPath);
+        if (index.open(QIODevice::ReadOnly) && index.seek(indexSize - kIndexEntrySize)) {
+            QByteArray entry = index.read(kIndexEntrySize);
+            if (entry.size() == kIndexEntrySize) {
+                activeSegment = qFromLittleEndian<quint32>(entry.constData());
+                committedSize = static_cast<qint64>(qFromLittleEndian<quint32>(entry.constData() + 4))
+                                + qFromLittleEndian<quint32>(entry.constData() + 8);
+            }
+        }
+    }
+    QString activePath = QDir(dirPath).filePath(segmentFileName(activeSegment));
+    if (QFileInfo(activePath).size() > committedSize) {
+        qWarning() << "丢弃未提交的分段数据:" << activePath;
+        QFile::resize(activePath, committedSize);
+    }
+
+    if (!openSegment(log.get(), activeSegment)) {
+        return nullptr;
+    }
+
+    log->lastUsed = ++m_useCounter;
+    m_logs.insert(chatKey, log);
+    return log.get();
+}
+
+void ChatLogStore::evictLeastRecentlyUsed()
+{
+    auto victim = m_logs.end();
+    for (auto it = m_logs.begin(); it != m_logs.end(); ++it) {
+        if (it.value()->lastUsed == m_useCounter) {
+            continue;
+        }
+        if (victim == m_logs.end() || it.value()->lastUsed < victim.value()->lastUsed) {
+            victim = it;
+        }
+    }
+    if (victim == m_logs.end()) {
+        return;
+    }
+
+    syncLog(victim.value().get());
+    m_logs.erase(victim);
+}
+
+void ChatLogStore::recoverTail(ChatLog *log, qint64 &indexSize)
+{
+    if (indexSize == 0) {
+        return;
+    }
+
+    // 断电时索引可能先于数据落盘，从末尾丢弃超出分段文件长度的索引项
+    QFile index(log->indexFile.fileName());
+    if (!index.open(QIODevice::ReadOnly)) {
+        return;
+    }
+
+    qint64 validSize = indexSize;
+    QHash<quint32, qint64> segmentSizes;
+    while (validSize > 0 && index.seek(validSize - kIndexEntrySize)) {
+        QByteArray entry = index.read(kIndexEntrySize);
+        if (entry.size() != kIndexEntrySize) {
+            break;
+        }
+        quint32 segment = qFromLittleEndian<quint32>(entry.constData());
+        qint64 end = static_cast<qint64>(qFromLittleEndian<quint32>(entry.constData() + 4))
+                     + qFromLittleEndian<quint32>(entry.constData() + 8);
+        if (!segmentSizes.contains(segment)) {
+            segmentSizes.insert(segment, QFileInfo(QDir(log->dirPath).filePath(segmentFileName(segment))).size());
+        }
+        if (end <= segmentSizes.value(segment)) {
+            break;
+        }
+        validSize -= kIndexEntrySize;
+    }
+    index.close();
+
+    if (validSize != indexSize) {
+        qWarning() << "丢弃数据不完整的记录:" << log->dirPath << "数量:" << (indexSize - validSize) / kIndexEntrySize;
+        QFile::resize(index.fileName(), validSize);
+        indexSize = validSize;
+    }
+}
+
+const char *ChatLogStore::mapSegment(ChatLog *log, quint32 segment, qint64 end)
+{
+    auto it = log->mappedSegments.find(segment);
+    if (it != log->mappedSegments.end() && it->second.size >= end) {
+        return it->second.data;
+    }
+
+    // 活动分段在映射之后可能继续增长，需要时按当前长度重新映射
+    if (it != log->mappedSegments.end()) {
+        log->mappedSegments.erase(it);
+    }
+
+    auto file = std::make_unique<QFile>(QDir(log->dirPath).filePath(segmentFileName(segment)));
+    if (!file->open(QIODevice::ReadOnly)) {
+        return nullptr;
+    }
+    qint64 size = file->size();
+    if (size < end || size == 0) {
+        return nullptr;
+    }
+    uchar *data = file->map(0, size);
+    if (!data) {
+        return nullptr;
+    }
+
+    // 限制同时映射的分段数，优先解除较早分段的映射
+    while (static_cast<int>(log->mappedSegments.size()) >= kMaxMappedSegments) {
+        log->mappedSegments.erase(log->mappedSegments.begin());
+    }
+
+    ChatLog::MappedSegment &mappedSegment = log->mappedSegments[segment];
+    mappedSegment.file = std::move(file);
+    mappedSegment.data = reinterpret_cast<const char *>(data);
+    mappedSegment.size = size;
+    return mappedSegment.data;
+}
+
+bool ChatLogStore::syncLog(ChatLog *log)
+{
+    if (!log->dirty) {
+        return true;
+    }
+
+    // 字典和分段先于索引落盘，索引项持久化时它引用的数据一定已持久化
+    auto syncPath = [log](const char *fileName) {
+        QFile file(QDir(log->dirPath).filePath(fileName));
+        if (!file.exists()) {
+            return true;
+        }
+        return file.open(QIODevice::WriteOnly | QIODevice::Append) && syncToDisk(file);
+    };
+
+    bool synced = syncPath(kDictionaryFileName)
+                  && syncToDisk(log->segmentFile)
+                  && syncToDisk(log->indexFile)
+                  && syncPath(kFlagsFileName);
+    if (!synced) {
+        qWarning() << "同步会话日志到磁盘失败:" << log->dirPath;
+        return false;
+    }
+    log->dirty = false;
+    return true;
+}
+
+bool ChatLogStore::openSegment(ChatLog *log, quint32 segment)
+{
+    if (log->segmentFile.isOpen()) {
+        // 滚动分段前同步旧分段，组提交只同步当前打开的分段
+        if (log->dirty) {
+            syncToDisk(log->segmentFile);
+        }
+        log->segmentFile.close();
+    }
+
+    QString segmentPath = QDir(log->dirPath).filePath(segmentFileName(segment));
+    qint64 existingSize = QFileInfo(segmentPath).size();
+    if (existingSize > 0 && existingSize < kSegmentHeaderSize) {
+        // 文件头写了一半，重新写入
+        QFile::resize(segmentPath, 0);
+        existingSize = 0;
+    }
+
+    log->segmentFile.setFileName(segmentPath);
+    if (!log->segmentFile.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qWarning() << "无法打开日志分段:" << segmentPath << log->segmentFile.errorString();
+        return false;
+    }
+
+    if (existingSize == 0) {
+        QByteArray header = segmentHeader(static_cast<quint8>(m_recordFormat));
+        if (log->segmentFile.write(header) != header.size()) {
+            qWarning() << "写入分段文件头失败:" << segmentPath;
+            return false;
+        }
+        log->segmentFile.flush();
+        existingSize = header.size();
+        log->segmentFormats.insert(segment, m_recordFormat);
+    }
+
+    log->activeSegment = segment;
+    log->activeSegmentSize = existingSize;
+    log->activeFormat = segmentFormat(log, segment);
+    return true;
+}
+
+bool ChatLogStore::rollSegment(ChatLog *log)
+{
+    return openSegment(log, log->activeSegment + 1);
+}
+
+bool ChatLogStore::writeSegment(ChatLog *log, const QByteArray &data)
+{
+    if (data.isEmpty()) {
+        return true;
+    }
+
+    if (log->segmentFile.write(data) != data.size()) {
+        qWarning() << "写入日志分段失败:" << log->segmentFile.fileName() << log->segmentFile.errorString();
+        return false;
+    }
+    log->segmentFile.flush();
+    log->activeSegmentSize += data.size();
+    return true;
+}
+
+QList<ChatRecord> ChatLogStore::readRange(ChatLog *log, qint64 start, qint64 end)
+{
+    QList<ChatRecord> records;
+    if (start >= end) {
+        return records;
+    }
+
+    // 读取该范围的索引项
+    QFile index(log->indexFile.fileName());
+    if (!index.open(QIODevice::ReadOnly) || !index.seek(start * kIndexEntrySize)) {
+        qWarning() << "无法读取记录索引:" << index.fileName();
+        return records;
+    }
+    QByteArray rawEntries = index.read((end - start) * kIndexEntrySize);
+
+    QList<IndexEntry> entries;
+    entries.reserve(rawEntries.size() / kIndexEntrySize);
+    for (qsizetype pos = 0; pos + kIndexEntrySize <= rawEntries.size(); pos += kIndexEntrySize) {
+        const char *raw = rawEntries.constData() + pos;
+        entries.append({qFromLittleEndian<quint32>(raw),
+                        qFromLittleEndian<quint32>(raw + 4),
+                        qFromLittleEndian<quint32>(raw + 8)});
+    }
+
+    records.reserve(entries.size());
+    loadFlags(log);
+
+    // 同一分段内连续的记录一次读出
+    qsizetype groupStart = 0;
+    while (groupStart < entries.size()) {
+        qsizetype groupEnd = groupStart + 1;
+        while (groupEnd < entries.size() && entries[groupEnd].segment == entries[groupStart].segment) {
+            ++groupEnd;
+        }
+
+        const IndexEntry &first = entries[groupStart];
+        const IndexEntry &last = entries[groupEnd - 1];
+        RecordFormat format = segmentFormat(log, first.segment);
+        qint64 spanEnd = static_cast<qint64>(last.offset) + last.length;
+
+        // 优先直接在映射区域上解码，映射失败时退回到读取这一段
+        const char *spanData = nullptr;
+        qint64 spanSize = 0;
+        QByteArray fallback;
+        if (const char *mapped = mapSegment(log, first.segment, spanEnd)) {
+            spanData = mapped + first.offset;
+            spanSize = spanEnd - first.offset;
+        } else {
+            QFile segment(QDir(log->dirPath).filePath(segmentFileName(first.segment)));
+            if (segment.open(QIODevice::ReadOnly) && segment.seek(first.offset)) {
+                fallback = segment.read(spanEnd - first.offset);
+            }
+            spanData = fallback.constData();
+            spanSize = fallback.size();
+        }
+
+        for (qsizetype i = groupStart; i < groupEnd; ++i) {
+            qint64 relative = static_cast<qint64>(entries[i].offset) - first.offset;
+            if (relative + entries[i].length > spanSize) {
+                qWarning() << "日志分段数据不完整:" << log->dirPath << "分段:" << first.segment;
+                break;
+            }
+            ChatRecord record;
+            if (!decodeRecord(log, format, spanData + relative, entries[i].length, &record)) {
+                qWarning() << "记录校验失败，已跳过:" << log->dirPath << "分段:" << first.segment
+                           << "偏移:" << entries[i].offset;
+                continue;
+            }
+
+            // 合并增量状态
+            quint8 flags = log->flags.value(static_cast<quint32>(start + i));
+            if (flags & kFlagRead) {
+                record.isRead = true;
+            }
+            if (flags & kFlagRecalled) {
+                record.recalled = true;
+                record.content = "[消息已撤回]";
+            }
+            records.append(record);
+        }
+
+        groupStart = groupEnd;
+    }
+
+    return records;
+}
+
+qint64 ChatLogStore::lowerBoundByTimestamp(ChatLog *log, qint64 timestamp)
+{
+    // 记录按追加顺序存储，时间戳基本递增，二分查找只解码O(log n)条记录
+    qint64 low = 0;
+    qint64 high = log->recordCount;
+    while (low < high) {
+        qint64 middle = low + (high - low) / 2;
+        QList<ChatRecord> probe = readRange(log, middle, middle + 1);
+        if (probe.isEmpty()) {
+            break;
+        }
+        if (probe.first().timestamp < timestamp) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+bool ChatLogStore::loadIdIndex(ChatLog *log)
+{
+    if (log->idIndexLoaded) {
+        return true;
+    }
+
+    QFile idFile(QDir(log->dirPath).filePath(kIdIndexFileName));
+    QByteArray data;
+    if (idFile.exists()) {
+        if (!idFile.open(QIODevice::ReadOnly)) {
+            qWarning() << "无法读取消息ID索引:" << idFile.fileName();
+            return false;
+        }
+        data = idFile.readAll();
+        idFile.close();
+    }
+
+    // 解析索引项，记录序号必须逐条连续；不完整或不连续的项(写入失败留下的缺口或残片)
+    // 及其之后的内容截断，从该记录开始重建
+    log->idIndex.clear();
+    log->idIndex.reserve(log->recordCount);
+    quint32 indexedCount = 0;
+    qsizetype pos = 0;
+    while (pos + kIdEntryHeaderSize <= data.size()) {
+        quint32 record = qFromLittleEndian<quint32>(data.constData() + pos);
+        int length = static_cast<quint8>(data.at(pos + 4));
+        if (pos + kIdEntryHeaderSize + length > data.size() || record != indexedCount
+            || record >= log->recordCount) {
+            break;
+        }
+        log->idIndex.insert(QString::fromUtf8(data.constData() + pos + kIdEntryHeaderSize, length), record);
+        indexedCount = record + 1;
+        pos += kIdEntryHeaderSize + length;
+    }
+    if (pos != data.size()) {
+        QFile::resize(idFile.fileName(), pos);
+    }
+    log->idIndexLoaded = true;
+
+    // 补齐索引中缺失的记录(旧数据或上次写入中断)
+    if (indexedCount < log->recordCount) {
+        QList<ChatRecord> missing = readRange(log, indexedCount, log->recordCount);
+        appendIdIndex(log, indexedCount, missing);
+    }
+    return true;
+}
+
+bool ChatLogStore::appendIdIndex(ChatLog *log, quint32 firstRecord, const QList<ChatRecord> &records)
+{
+    QByteArray data;
+    for (qsizetype i = 0; i < records.size(); ++i) {
+        QByteArray id = idIndexKey(records[i].messageId);
+        quint32 record = firstRecord + static_cast<quint32>(i);
+        appendUInt32(data, record);
+        data.append(static_cast<char>(id.size()));
+        data.append(id);
+
+        if (log->idIndexLoaded) {
+            log->idIndex.insert(QString::fromUtf8(id), record);
+        }
+    }
+
+    QFile idFile(QDir(log->dirPath).filePath(kIdIndexFileName));
+    if (!idFile.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qWarning() << "无法打开消息ID索引:" << idFile.fileName() << idFile.errorString();
+        log->idIndexLoaded = false;
+        return false;
+    }
+
+    // 写入失败时去掉写了一半的项，并在下次查询时重新加载，由加载时的补齐逻辑重建缺失部分
+    qint64 previousSize = idFile.size();
+    if (idFile.write(data) != data.size() || !idFile.flush()) {
+        qWarning() << "写入消息ID索引失败:" << idFile.fileName() << idFile.errorString();
+        idFile.resize(previousSize);
+        log->idIndexLoaded = false;
+        return false;
+    }
+    return true;
+}
+
+void ChatLogStore::loadFlags(ChatLog *log)
+{
+    if (log->flagsLoaded) {
+        return;
+    }
+    log->flagsLoaded = true;
+
+    QFile flagsFile(QDir(log->dirPath).filePath(kFlagsFileName));
+    if (!flagsFile.open(QIODevice::ReadOnly)) {
+        return;
+    }
+
+    // 同一记录的多次更新以最后一次为准
+    QByteArray data = flagsFile.readAll();
+    for (qsizetype pos = 0; pos + kFlagsEntrySize <= data.size(); pos += kFlagsEntrySize) {
+        quint32 record = qFromLittleEndian<quint32>(data.constData() + pos);
+        log->flags.insert(record, static_cast<quint8>(data.at(pos + 4)));
+    }
+}
+
+void ChatLogStore::loadDictionary(ChatLog *log)
+{
+    if (log->dictionaryLoaded) {
+        return;
+    }
+    log->dictionaryLoaded = true;
+
+    QFile dictionaryFile(QDir(log->dirPath).filePath(kDictionaryFileName));
+    if (!dictionaryFile.open(QIODevice::ReadOnly)) {
+        return;
+    }
+    QByteArray data = dictionaryFile.readAll();
+    dictionaryFile.close();
+
+    const char *cursor = data.constData();
+    const char *end = cursor + data.size();
+    QString text;
+    while (cursor < end) {
+        const char *entryStart = cursor;
+        if (!readString(cursor, end, &text)) {
+            // 截断写了一半的字典项
+            QFile::resize(dictionaryFile.fileName(), entryStart - data.constData());
+            break;
+        }
+        log->dictionaryIndex.insert(text, static_cast<quint32>(log->dictionary.size()));
+        log->dictionary.append(text);
+    }
+}
+
+quint32 ChatLogStore::internString(ChatLog *log, const QString &text, QByteArray *dictionaryData)
+{
+    loadDictionary(log);
+
+    auto it = log->dictionaryIndex.constFind(text);
+    if (it != log->dictionaryIndex.constEnd()) {
+        return it.value();
+    }
+
+    quint32 index = static_cast<quint32>(log->dictionary.size());
+    log->dictionary.append(text);
+    log->dictionaryIndex.insert(text, index);
+    appendString(*dictionaryData, text);
+    return index;
+}
+
+ChatLogStore::RecordFormat ChatLogStore::segmentFormat(ChatLog *log, quint32 segment)
+{
+    auto it = log->segmentFormats.constFind(segment);
+    if (it != log->segmentFormats.constEnd()) {
+        return it.value();
+    }
+
+    // 读取分段文件头中的格式字节
+    RecordFormat format = RecordFormat::Json;
+    QFile file(QDir(log->dirPath).filePath(segmentFileName(segment)));
+    if (file.open(QIODevice::ReadOnly)) {
+        QByteArray header = file.read(kSegmentHeaderSize);
+        if (header.size() == kSegmentHeaderSize && header.startsWith(QByteArray(kSegmentMagic, 4))) {
+            format = static_cast<RecordFormat>(header.at(kSegmentFormatOffset));
+        }
+    }
+    log->segmentFormats.insert(segment, format);
+    return format;
+}
+
+QByteArray ChatLogStore::encodeRecord(ChatLog *log, const ChatRecord &record, QByteArray *dictionaryData)
+{
+    if (log->activeFormat == RecordFormat::Json) {
+        return QJsonDocument(record.toJson()).toJson(QJsonDocument::Compact);
+    }
+
+    quint8 flags = 0;
+    if (record.isRead) {
+        flags |= kFlagRead;
+    }
+    if (record.recalled) {
+        flags |= kFlagRecalled;
+    }
+    if (record.isGroup) {
+        flags |= kBinaryFlagGroup;
+    }
+
+    QByteArray payload;
+    payload.reserve(32 + record.content.size() * 3);
+    payload.append(static_cast<char>(kBinaryRecordVersion));
+    payload.append(static_cast<char>(flags));
+    appendVarint(payload, static_cast<quint64>(qMax<qint64>(0, record.timestamp)));
+    appendString(payload, record.messageId);
+    appendVarint(payload, internString(log, record.fromUserId, dictionaryData));
+    appendVarint(payload, internString(log, record.targetId, dictionaryData));
+    appendString(payload, record.content);
+    appendUInt32(payload, crc32(payload.constData(), payload.size()));
+    return payload;
+}
+
+bool ChatLogStore::decodeRecord(ChatLog *log, RecordFormat format, const char *data, qsizetype size, ChatRecord *record)
+{
+    if (format == RecordFormat::Json) {
+        QJsonDocument document = QJsonDocument::fromJson(QByteArray::fromRawData(data, size));
+        if (!document.isObject()) {
+            return false;
+        }
+        *record = ChatRecord::fromJson(document.object());
+        return true;
+    }
+
+    if (size < kBinaryRecordMinSize) {
+        return false;
+    }
+
+    const char *end = data + size - 4;
+    if (qFromLittleEndian<quint32>(end) != crc32(data, size - 4)) {
+        return false;
+    }
+
+    const char *cursor = data;
+    if (static_cast<quint8>(*cursor++) != kBinaryRecordVersion) {
+        return false;
+    }
+    quint8 flags = static_cast<quint8>(*cursor++);
+
+    quint64 timestamp = 0;
+    quint64 fromIndex = 0;
+    quint64 targetIndex = 0;
+    if (!readVarint(cursor, end, &timestamp)
+        || !readString(cursor, end, &record->messageId)
+        || !readVarint(cursor, end, &fromIndex)
+        || !readVarint(cursor, end, &targetIndex)
+        || !readString(cursor, end, &record->content)) {
+        return false;
+    }
+
+    loadDictionary(log);
+    if (fromIndex >= static_cast<quint64>(log->dictionary.size())
+        || targetIndex >= static_cast<quint64>(log->dictionary.size())) {
+        return false;
+    }
+
+    record->fromUserId = log->dictionary.at(static_cast<qsizetype>(fromIndex));
+    record->targetId = log->dictionary.at(static_cast<qsizetype>(targetIndex));
+    record->timestamp = static_cast<qint64>(timestamp);
+    record->isRead = flags & kFlagRead;
+    record->recalled = flags & kFlagRecalled;
+    record->isGroup = flags & kBinaryFlagGroup;
+    return true;
+}
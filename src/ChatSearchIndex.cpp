@@ -0,0 +1,905 @@
+#include "include/ChatSearchIndex.h"
+#include <QDebug>
+#include <QDir>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <QtEndian>
+#include <algorithm>
+
+namespace {
+
+const char kTermsFileName[] = "terms.dict";
+const char kChatsFileName[] = "chats.dict";
+const char kPostingsFileName[] = "postings.log";
+const char kSegmentsFileName[] = "segments.dat";
+
+// 倒排日志块: 负载长度(小端32位) + 负载的CRC-16校验(小端16位) + 负载
+constexpr int kBlockHeaderSize = 6;
+
+// 块类型
+constexpr quint8 kBlockDocuments = 0;   // 会话 + 起始记录序号 + 每条记录的(词序号, 位置)列表
+constexpr quint8 kBlockRemoveChat = 1;  // 会话被清空
+constexpr quint8 kBlockCheckpoint = 2;  // segments.dat的有效长度 + 日志中第一个文档的序号
+constexpr quint8 kBlockChatState = 3;   // 会话 + 纪元号 + 已索引记录数
+
+// 段: 段头(负载长度、起始文档号、文档数、词数，均为小端32位) + 文档表 + 词目录 + 倒排数据
+// 文档表每项为(会话, 记录序号, 纪元号)，词目录每项为(词序号, 倒排偏移, 倒排长度)，
+// 倒排数据为每个词的(文档号差值, 位置)变长整数序列
+constexpr int kSegmentHeaderSize = 16;
+constexpr int kDocumentEntrySize = 12;
+constexpr int kTermEntrySize = 12;
+
+void appendVarint(QByteArray &buffer, quint64 value)
+{
+    while (value >= 0x80) {
+        buffer.append(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    buffer.append(static_cast<char>(value));
+}
+
+bool readVarint(const char *&cursor, const char *end, quint64 *value)
+{
+    quint64 result = 0;
+    for (int shift = 0; cursor < end && shift < 64; shift += 7) {
+        quint8 byte = static_cast<quint8>(*cursor++);
+        result |= static_cast<quint64>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool isCjk(char32_t ch)
+{
+    return (ch >= 0x4E00 && ch <= 0x9FFF)       // 中日韩统一表意文字
+        || (ch >= 0x3400 && ch <= 0x4DBF)       // 扩展A
+        || (ch >= 0x20000 && ch <= 0x2A6DF)     // 扩展B
+        || (ch >= 0xF900 && ch <= 0xFAFF)       // 兼容表意文字
+        || (ch >= 0x3040 && ch <= 0x30FF)       // 平假名、片假名
+        || (ch >= 0xAC00 && ch <= 0xD7AF);      // 谚文音节
+}
+
+QByteArray encodeBlock(const QByteArray &payload)
+{
+    QByteArray block(kBlockHeaderSize, Qt::Uninitialized);
+    qToLittleEndian(static_cast<quint32>(payload.size()), block.data());
+    qToLittleEndian(static_cast<quint16>(qChecksum(payload)), block.data() + 4);
+    block.append(payload);
+    return block;
+}
+
+void appendUInt32(QByteArray &buffer, quint32 value)
+{
+    char bytes[4];
+    qToLittleEndian(value, bytes);
+    buffer.append(bytes, 4);
+}
+
+bool postingLess(quint32 documentA, quint32 positionA, quint32 documentB, quint32 positionB)
+{
+    return documentA < documentB || (documentA == documentB && positionA < positionB);
+}
+
+} // namespace
+
+ChatSearchIndex::ChatSearchIndex()
+    : m_tailBase(0)
+    , m_segmentsSize(0)
+    , m_sortedTermsDirty(true)
+{
+}
+
+ChatSearchIndex::~ChatSearchIndex()
+{
+    close();
+}
+
+bool ChatSearchIndex::open(const QString &dirPath)
+{
+    close();
+
+    if (!QDir().mkpath(dirPath)) {
+        qWarning() << "无法创建搜索索引目录:" << dirPath;
+        return false;
+    }
+    m_dirPath = dirPath;
+
+    QStringList chatKeys;
+    if (!loadDictionary(QDir(dirPath).filePath(kTermsFileName), &m_terms)
+        || !loadDictionary(QDir(dirPath).filePath(kChatsFileName), &chatKeys)) {
+        return false;
+    }
+
+    m_termIds.reserve(m_terms.size());
+    for (qsizetype i = 0; i < m_terms.size(); ++i) {
+        m_termIds.insert(m_terms.at(i), static_cast<quint32>(i));
+    }
+    m_postings.resize(m_terms.size());
+
+    for (const QString &chatKey : chatKeys) {
+        m_chatIds.insert(chatKey, static_cast<quint32>(m_chats.size()));
+        m_chats.push_back({chatKey, 0, 0});
+    }
+
+    if (!loadPostings() || !loadSegments()) {
+        return false;
+    }
+
+    m_termsFile.setFileName(QDir(dirPath).filePath(kTermsFileName));
+    m_chatsFile.setFileName(QDir(dirPath).filePath(kChatsFileName));
+    m_postingsFile.setFileName(QDir(dirPath).filePath(kPostingsFileName));
+    for (QFile *file : {&m_termsFile, &m_chatsFile, &m_postingsFile}) {
+        if (!file->open(QIODevice::WriteOnly | QIODevice::Append)) {
+            qWarning() << "无法打开搜索索引文件:" << file->fileName() << file->errorString();
+            return false;
+        }
+    }
+
+    // 旧版本留下的日志可能包含全部文档，载入后立即整理成段
+    if (static_cast<qsizetype>(m_documents.size()) >= kSegmentDocuments) {
+        writeSegment();
+    }
+
+    qDebug() << "搜索索引已载入，消息数:" << documentCount() << "段数:" << m_segments.size()
+             << "词数:" << m_terms.size();
+    return true;
+}
+
+void ChatSearchIndex::close()
+{
+    m_termsFile.close();
+    m_chatsFile.close();
+    m_postingsFile.close();
+    m_segmentsFile.close();
+
+    m_terms.clear();
+    m_termIds.clear();
+    m_postings.clear();
+    m_documents.clear();
+    m_chats.clear();
+    m_chatIds.clear();
+    m_tailBase = 0;
+    m_segments.clear();
+    m_segmentsSize = 0;
+    m_sortedTerms.clear();
+    m_sortedTermsDirty = true;
+}
+
+void ChatSearchIndex::clear()
+{
+    QString dirPath = m_dirPath;
+    close();
+    if (dirPath.isEmpty()) {
+        return;
+    }
+
+    QDir(dirPath).removeRecursively();
+    open(dirPath);
+}
+
+quint32 ChatSearchIndex::indexedCount(const QString &chatKey) const
+{
+    auto it = m_chatIds.constFind(chatKey);
+    return it != m_chatIds.constEnd() ? m_chats[it.value()].indexedCount : 0;
+}
+
+bool ChatSearchIndex::addRecords(const QString &chatKey, quint32 firstRecord, const QList<ChatRecord> &records)
+{
+    if (!m_postingsFile.isOpen() || records.isEmpty()) {
+        return false;
+    }
+
+    QByteArray chatData;
+    QByteArray termData;
+    quint32 chat = chatId(chatKey, &chatData);
+
+    // 已经索引过的记录跳过
+    qsizetype skip = 0;
+    if (firstRecord < m_chats[chat].indexedCount) {
+        skip = qMin<qsizetype>(records.size(), m_chats[chat].indexedCount - firstRecord);
+    }
+    if (skip == records.size()) {
+        return true;
+    }
+
+    QByteArray payload;
+    payload.append(static_cast<char>(kBlockDocuments));
+    appendVarint(payload, chat);
+    appendVarint(payload, firstRecord + skip);
+    appendVarint(payload, static_cast<quint64>(records.size() - skip));
+
+    for (qsizetype i = skip; i < records.size(); ++i) {
+        const ChatRecord &record = records.at(i);
+        const QList<Token> tokens = tokenize(record.content);
+        appendVarint(payload, static_cast<quint64>(tokens.size()));
+
+        quint32 document = documentCount();
+        m_documents.push_back({chat, firstRecord + static_cast<quint32>(i), m_chats[chat].epoch});
+        for (const Token &token : tokens) {
+            quint32 term = termId(token.term, &termData);
+            m_postings[term].push_back({document, token.position});
+            appendVarint(payload, term);
+            appendVarint(payload, token.position);
+        }
+    }
+    m_chats[chat].indexedCount = firstRecord + static_cast<quint32>(records.size());
+
+    // 字典先于引用它们的倒排块写入
+    if ((!chatData.isEmpty() && m_chatsFile.write(chatData) != chatData.size())
+        || (!termData.isEmpty() && m_termsFile.write(termData) != termData.size())) {
+        qWarning() << "写入搜索索引字典失败:" << m_dirPath;
+        return false;
+    }
+    m_chatsFile.flush();
+    m_termsFile.flush();
+    if (!writeBlock(payload)) {
+        return false;
+    }
+
+    // 段写入失败时文档仍在postings.log中，下次再整理
+    if (static_cast<qsizetype>(m_documents.size()) >= kSegmentDocuments) {
+        writeSegment();
+    }
+    return true;
+}
+
+bool ChatSearchIndex::removeChat(const QString &chatKey)
+{
+    auto it = m_chatIds.constFind(chatKey);
+    if (it == m_chatIds.constEnd() || !m_postingsFile.isOpen()) {
+        return true;
+    }
+
+    // 旧文档的纪元号不再匹配，查询时被忽略
+    ChatState &state = m_chats[it.value()];
+    ++state.epoch;
+    state.indexedCount = 0;
+
+    QByteArray payload;
+    payload.append(static_cast<char>(kBlockRemoveChat));
+    appendVarint(payload, it.value());
+    return writeBlock(payload);
+}
+
+QList<ChatSearchIndex::Hit> ChatSearchIndex::search(const QString &query, int limit) const
+{
+    QList<Hit> hits;
+    const QList<Clause> clauses = parseQuery(query);
+    if (clauses.isEmpty() || limit <= 0) {
+        return hits;
+    }
+
+    // 读出每个子句中各词的倒排表，前缀词展开后合并
+    std::deque<std::vector<Posting>> loaded;
+    QList<QList<ClauseTerm>> clauseTerms;
+    const std::vector<Posting> *driver = nullptr;
+    for (const Clause &clause : clauses) {
+        QList<ClauseTerm> terms;
+        for (qsizetype i = 0; i < clause.tokens.size(); ++i) {
+            const Token &token = clause.tokens.at(i);
+            bool prefix = clause.prefix && i == clause.tokens.size() - 1;
+            const std::vector<Posting> *postings = lookup(token.term, prefix, loaded);
+            if (!postings || postings->empty()) {
+                return hits;
+            }
+            terms.append({postings, token.position});
+            if (!driver || postings->size() < driver->size()) {
+                driver = postings;
+            }
+        }
+        clauseTerms.append(terms);
+    }
+
+    // 以最短的倒排表驱动，从最新的消息开始逐条验证
+    qsizetype pos = static_cast<qsizetype>(driver->size()) - 1;
+    while (pos >= 0 && hits.size() < limit) {
+        quint32 document = (*driver)[pos].document;
+        while (pos >= 0 && (*driver)[pos].document == document) {
+            --pos;
+        }
+
+        Document doc;
+        if (!readDocument(document, &doc) || doc.chat >= m_chats.size()) {
+            continue;
+        }
+        const ChatState &chat = m_chats[doc.chat];
+        if (doc.epoch != chat.epoch) {
+            continue;
+        }
+
+        bool matched = true;
+        for (const QList<ClauseTerm> &terms : std::as_const(clauseTerms)) {
+            if (!matchesClause(terms, document)) {
+                matched = false;
+                break;
+            }
+        }
+        if (matched) {
+            hits.append({chat.chatKey, doc.record});
+        }
+    }
+    return hits;
+}
+
+QList<ChatSearchIndex::Token> ChatSearchIndex::tokenize(const QString &text, bool forQuery)
+{
+    QList<Token> tokens;
+    quint32 position = 0;
+    QString word;
+    std::vector<char32_t> run;
+
+    auto flushWord = [&]() {
+        if (!word.isEmpty()) {
+            tokens.append({word, position++});
+            word.clear();
+        }
+    };
+
+    // 连续的中日韩文字切分为单字和相邻双字，位置为首字的位置
+    auto flushRun = [&]() {
+        const qsizetype length = static_cast<qsizetype>(run.size());
+        for (qsizetype i = 0; i < length; ++i) {
+            if (!forQuery || length == 1) {
+                tokens.append({QString::fromUcs4(&run[i], 1), position + static_cast<quint32>(i)});
+            }
+            if (i + 1 < length) {
+                tokens.append({QString::fromUcs4(&run[i], 2), position + static_cast<quint32>(i)});
+            }
+        }
+        position += static_cast<quint32>(length);
+        run.clear();
+    };
+
+    const QList<uint> codePoints = text.toUcs4();
+    for (uint codePoint : codePoints) {
+        char32_t ch = static_cast<char32_t>(codePoint);
+        if (isCjk(ch)) {
+            flushWord();
+            run.push_back(ch);
+        } else if (QChar::isLetterOrNumber(ch)) {
+            flushRun();
+            char32_t lower = QChar::toLower(ch);
+            word.append(QString::fromUcs4(&lower, 1));
+        } else {
+            flushWord();
+            flushRun();
+        }
+    }
+    flushWord();
+    flushRun();
+    return tokens;
+}
+
+// 私有方法实现
+
+bool ChatSearchIndex::loadDictionary(const QString &filePath, QStringList *entries)
+{
+    QFile file(filePath);
+    if (!file.exists()) {
+        return true;
+    }
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "无法读取搜索索引字典:" << filePath << file.errorString();
+        return false;
+    }
+    QByteArray data = file.readAll();
+    file.close();
+
+    const char *begin = data.constData();
+    const char *cursor = begin;
+    const char *end = begin + data.size();
+    while (cursor < end) {
+        const char *entryStart = cursor;
+        quint64 length = 0;
+        if (!readVarint(cursor, end, &length) || length > static_cast<quint64>(end - cursor)) {
+            // 截断写了一半的字典项
+            QFile::resize(filePath, entryStart - begin);
+            break;
+        }
+        entries->append(QString::fromUtf8(cursor, static_cast<qsizetype>(length)));
+        cursor += length;
+    }
+    return true;
+}
+
+bool ChatSearchIndex::loadPostings()
+{
+    QString filePath = QDir(m_dirPath).filePath(kPostingsFileName);
+    QFile file(filePath);
+    if (!file.exists()) {
+        return true;
+    }
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "无法读取搜索索引:" << filePath << file.errorString();
+        return false;
+    }
+    QByteArray data = file.readAll();
+    file.close();
+
+    qsizetype pos = 0;
+    while (pos + kBlockHeaderSize <= data.size()) {
+        const char *header = data.constData() + pos;
+        quint32 length = qFromLittleEndian<quint32>(header);
+        if (length > static_cast<quint32>(data.size() - pos - kBlockHeaderSize)) {
+            break;
+        }
+        QByteArrayView payload(header + kBlockHeaderSize, length);
+        if (qChecksum(payload) != qFromLittleEndian<quint16>(header + 4)) {
+            break;
+        }
+        applyBlock(payload.data(), payload.size());
+        pos += kBlockHeaderSize + length;
+    }
+
+    if (pos < data.size()) {
+        qWarning() << "搜索索引末尾存在不完整的块，已丢弃:" << filePath;
+        QFile::resize(filePath, pos);
+    }
+    return true;
+}
+
+bool ChatSearchIndex::loadSegments()
+{
+    m_segmentsFile.setFileName(QDir(m_dirPath).filePath(kSegmentsFileName));
+    if (!m_segmentsFile.open(QIODevice::ReadWrite)) {
+        qWarning() << "无法打开搜索索引段文件:" << m_segmentsFile.fileName() << m_segmentsFile.errorString();
+        return false;
+    }
+
+    // 检查点之后写入的段属于尚未完成的整理，其文档仍在postings.log中
+    if (m_segmentsFile.size() > m_segmentsSize) {
+        m_segmentsFile.resize(m_segmentsSize);
+    } else if (m_segmentsFile.size() < m_segmentsSize) {
+        qWarning() << "搜索索引段文件不完整，缺失部分的消息无法搜索:" << m_segmentsFile.fileName();
+        m_segmentsSize = m_segmentsFile.size();
+    }
+
+    // 只读取段头和词目录，文档表和倒排数据留在磁盘上
+    qint64 offset = 0;
+    while (offset + kSegmentHeaderSize <= m_segmentsSize) {
+        m_segmentsFile.seek(offset);
+        const QByteArray header = m_segmentsFile.read(kSegmentHeaderSize);
+        if (header.size() != kSegmentHeaderSize) {
+            break;
+        }
+        const quint32 bodySize = qFromLittleEndian<quint32>(header.constData());
+        const quint32 termCount = qFromLittleEndian<quint32>(header.constData() + 12);
+
+        Segment segment;
+        segment.offset = offset;
+        segment.documentBase = qFromLittleEndian<quint32>(header.constData() + 4);
+        segment.documentCount = qFromLittleEndian<quint32>(header.constData() + 8);
+        const qint64 directoryOffset = offset + kSegmentHeaderSize
+                                     + qint64(segment.documentCount) * kDocumentEntrySize;
+        segment.dataOffset = directoryOffset + qint64(termCount) * kTermEntrySize;
+        if (offset + kSegmentHeaderSize + bodySize > m_segmentsSize
+            || segment.dataOffset > offset + kSegmentHeaderSize + bodySize) {
+            break;
+        }
+
+        m_segmentsFile.seek(directoryOffset);
+        const QByteArray directory = m_segmentsFile.read(qint64(termCount) * kTermEntrySize);
+        if (directory.size() != qsizetype(termCount) * kTermEntrySize) {
+            break;
+        }
+        segment.terms.reserve(termCount);
+        for (quint32 i = 0; i < termCount; ++i) {
+            const char *entry = directory.constData() + i * kTermEntrySize;
+            segment.terms.push_back({qFromLittleEndian<quint32>(entry),
+                                     qFromLittleEndian<quint32>(entry + 4),
+                                     qFromLittleEndian<quint32>(entry + 8)});
+        }
+        m_segments.push_back(std::move(segment));
+        offset += kSegmentHeaderSize + bodySize;
+    }
+
+    if (offset != m_segmentsSize) {
+        qWarning() << "搜索索引段文件损坏，已截断:" << m_segmentsFile.fileName();
+        m_segmentsFile.resize(offset);
+        m_segmentsSize = offset;
+    }
+    return true;
+}
+
+void ChatSearchIndex::applyBlock(const char *data, qsizetype size)
+{
+    const char *cursor = data;
+    const char *end = data + size;
+    if (cursor >= end) {
+        return;
+    }
+
+    quint8 type = static_cast<quint8>(*cursor++);
+    if (type == kBlockCheckpoint) {
+        quint64 segmentsSize = 0;
+        quint64 documentBase = 0;
+        if (readVarint(cursor, end, &segmentsSize) && readVarint(cursor, end, &documentBase)) {
+            m_segmentsSize = static_cast<qint64>(segmentsSize);
+            m_tailBase = static_cast<quint32>(documentBase);
+        }
+        return;
+    }
+
+    quint64 chat = 0;
+    if (!readVarint(cursor, end, &chat) || chat >= m_chats.size()) {
+        return;
+    }
+    ChatState &state = m_chats[chat];
+
+    if (type == kBlockRemoveChat) {
+        ++state.epoch;
+        state.indexedCount = 0;
+        return;
+    }
+    if (type == kBlockChatState) {
+        quint64 epoch = 0;
+        quint64 indexedCount = 0;
+        if (readVarint(cursor, end, &epoch) && readVarint(cursor, end, &indexedCount)) {
+            state.epoch = static_cast<quint32>(epoch);
+            state.indexedCount = static_cast<quint32>(indexedCount);
+        }
+        return;
+    }
+    if (type != kBlockDocuments) {
+        return;
+    }
+
+    quint64 firstRecord = 0;
+    quint64 count = 0;
+    if (!readVarint(cursor, end, &firstRecord) || !readVarint(cursor, end, &count)) {
+        return;
+    }
+
+    for (quint64 i = 0; i < count; ++i) {
+        quint64 tokenCount = 0;
+        if (!readVarint(cursor, end, &tokenCount)) {
+            return;
+        }
+
+        quint32 document = documentCount();
+        m_documents.push_back({static_cast<quint32>(chat), static_cast<quint32>(firstRecord + i), state.epoch});
+        for (quint64 t = 0; t < tokenCount; ++t) {
+            quint64 term = 0;
+            quint64 position = 0;
+            if (!readVarint(cursor, end, &term) || !readVarint(cursor, end, &position)
+                || term >= m_postings.size()) {
+                return;
+            }
+            m_postings[term].push_back({document, static_cast<quint32>(position)});
+        }
+        state.indexedCount = static_cast<quint32>(firstRecord + i + 1);
+    }
+}
+
+bool ChatSearchIndex::writeBlock(const QByteArray &payload)
+{
+    QByteArray block = encodeBlock(payload);
+    if (m_postingsFile.write(block) != block.size()) {
+        qWarning() << "写入搜索索引失败:" << m_postingsFile.fileName() << m_postingsFile.errorString();
+        return false;
+    }
+    m_postingsFile.flush();
+    return true;
+}
+
+bool ChatSearchIndex::writeSegment()
+{
+    Segment segment;
+    segment.offset = m_segmentsSize;
+    segment.documentBase = m_tailBase;
+    segment.documentCount = static_cast<quint32>(m_documents.size());
+
+    QByteArray documents;
+    documents.reserve(static_cast<qsizetype>(m_documents.size()) * kDocumentEntrySize);
+    for (const Document &doc : m_documents) {
+        appendUInt32(documents, doc.chat);
+        appendUInt32(documents, doc.record);
+        appendUInt32(documents, doc.epoch);
+    }
+
+    QByteArray directory;
+    QByteArray data;
+    for (size_t term = 0; term < m_postings.size(); ++term) {
+        const std::vector<Posting> &postings = m_postings[term];
+        if (postings.empty()) {
+            continue;
+        }
+        const quint32 offset = static_cast<quint32>(data.size());
+        quint32 previous = m_tailBase;
+        for (const Posting &posting : postings) {
+            appendVarint(data, posting.document - previous);
+            appendVarint(data, posting.position);
+            previous = posting.document;
+        }
+        const quint32 length = static_cast<quint32>(data.size()) - offset;
+        segment.terms.push_back({static_cast<quint32>(term), offset, length});
+        appendUInt32(directory, static_cast<quint32>(term));
+        appendUInt32(directory, offset);
+        appendUInt32(directory, length);
+    }
+
+    QByteArray header;
+    appendUInt32(header, static_cast<quint32>(documents.size() + directory.size() + data.size()));
+    appendUInt32(header, segment.documentBase);
+    appendUInt32(header, segment.documentCount);
+    appendUInt32(header, static_cast<quint32>(segment.terms.size()));
+    segment.dataOffset = segment.offset + header.size() + documents.size() + directory.size();
+
+    const QByteArray block = header + documents + directory + data;
+    if (!m_segmentsFile.seek(m_segmentsSize) || m_segmentsFile.write(block) != block.size()
+        || !m_segmentsFile.flush()) {
+        qWarning() << "写入搜索索引段失败:" << m_segmentsFile.fileName() << m_segmentsFile.errorString();
+        m_segmentsFile.resize(m_segmentsSize);
+        return false;
+    }
+
+    // 检查点记录新段之后，日志中的文档才可以丢弃
+    const qint64 previousSize = m_segmentsSize;
+    const quint32 previousBase = m_tailBase;
+    m_segmentsSize += block.size();
+    m_tailBase += segment.documentCount;
+    if (!rewriteLog()) {
+        m_segmentsSize = previousSize;
+        m_tailBase = previousBase;
+        m_segmentsFile.resize(m_segmentsSize);
+        return false;
+    }
+
+    m_segments.push_back(std::move(segment));
+    m_documents.clear();
+    for (std::vector<Posting> &postings : m_postings) {
+        postings.clear();
+        postings.shrink_to_fit();
+    }
+    return true;
+}
+
+bool ChatSearchIndex::rewriteLog()
+{
+    QByteArray data;
+    QByteArray checkpoint;
+    checkpoint.append(static_cast<char>(kBlockCheckpoint));
+    appendVarint(checkpoint, static_cast<quint64>(m_segmentsSize));
+    appendVarint(checkpoint, m_tailBase);
+    data.append(encodeBlock(checkpoint));
+
+    for (size_t chat = 0; chat < m_chats.size(); ++chat) {
+        const ChatState &state = m_chats[chat];
+        if (state.epoch == 0 && state.indexedCount == 0) {
+            continue;
+        }
+        QByteArray payload;
+        payload.append(static_cast<char>(kBlockChatState));
+        appendVarint(payload, chat);
+        appendVarint(payload, state.epoch);
+        appendVarint(payload, state.indexedCount);
+        data.append(encodeBlock(payload));
+    }
+
+    // 替换前关闭追加句柄，Windows上无法替换仍被打开的文件
+    const QString filePath = m_postingsFile.fileName();
+    m_postingsFile.close();
+    QSaveFile file(filePath);
+    bool ok = file.open(QIODevice::WriteOnly) && file.write(data) == data.size() && file.commit();
+    if (!ok) {
+        qWarning() << "重写搜索索引日志失败:" << filePath << file.errorString();
+    }
+
+    if (!m_postingsFile.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        qWarning() << "无法打开搜索索引文件:" << filePath << m_postingsFile.errorString();
+    }
+    return ok;
+}
+
+quint32 ChatSearchIndex::chatId(const QString &chatKey, QByteArray *dictionaryData)
+{
+    auto it = m_chatIds.constFind(chatKey);
+    if (it != m_chatIds.constEnd()) {
+        return it.value();
+    }
+
+    quint32 id = static_cast<quint32>(m_chats.size());
+    m_chatIds.insert(chatKey, id);
+    m_chats.push_back({chatKey, 0, 0});
+
+    QByteArray utf8 = chatKey.toUtf8();
+    appendVarint(*dictionaryData, static_cast<quint64>(utf8.size()));
+    dictionaryData->append(utf8);
+    return id;
+}
+
+quint32 ChatSearchIndex::termId(const QString &term, QByteArray *dictionaryData)
+{
+    auto it = m_termIds.constFind(term);
+    if (it != m_termIds.constEnd()) {
+        return it.value();
+    }
+
+    quint32 id = static_cast<quint32>(m_terms.size());
+    m_terms.append(term);
+    m_termIds.insert(term, id);
+    m_postings.emplace_back();
+    m_sortedTermsDirty = true;
+
+    QByteArray utf8 = term.toUtf8();
+    appendVarint(*dictionaryData, static_cast<quint64>(utf8.size()));
+    dictionaryData->append(utf8);
+    return id;
+}
+
+QList<ChatSearchIndex::Clause> ChatSearchIndex::parseQuery(const QString &query)
+{
+    // 引号内为短语，其余按空白分成多个子句，子句以*结尾表示最后一个词为前缀
+    QList<Clause> clauses;
+    auto addClause = [&clauses](QString text) {
+        Clause clause;
+        text = text.trimmed();
+        if (text.endsWith('*')) {
+            clause.prefix = true;
+            text.chop(1);
+        }
+        clause.tokens = tokenize(text, true);
+        if (clause.tokens.isEmpty()) {
+            return;
+        }
+        // 位置改为相对子句首词
+        quint32 base = clause.tokens.first().position;
+        for (Token &token : clause.tokens) {
+            token.position -= base;
+        }
+        // 只有单词结尾的子句才按前缀匹配
+        if (clause.prefix && isCjk(clause.tokens.last().term.toUcs4().value(0))) {
+            clause.prefix = false;
+        }
+        clauses.append(clause);
+    };
+
+    const QStringList quoted = query.split('"');
+    for (qsizetype i = 0; i < quoted.size(); ++i) {
+        if (i % 2 == 1) {
+            addClause(quoted.at(i));
+            continue;
+        }
+        const QStringList words = quoted.at(i).split(QRegularExpression("\\s+"), Qt::SkipEmptyParts);
+        for (const QString &word : words) {
+            addClause(word);
+        }
+    }
+    return clauses;
+}
+
+const std::vector<ChatSearchIndex::Posting> *ChatSearchIndex::lookup(
+    const QString &term, bool prefix, std::deque<std::vector<Posting>> &loaded) const
+{
+    if (!prefix) {
+        auto it = m_termIds.constFind(term);
+        if (it == m_termIds.constEnd()) {
+            return nullptr;
+        }
+        loaded.emplace_back();
+        readPostings(it.value(), loaded.back());
+        return &loaded.back();
+    }
+
+    if (m_sortedTermsDirty) {
+        m_sortedTerms = m_terms;
+        m_sortedTerms.sort();
+        m_sortedTermsDirty = false;
+    }
+
+    // 在有序词表中找出以term开头的词，合并它们的倒排表
+    std::vector<Posting> merged;
+    int expansions = 0;
+    for (auto it = std::lower_bound(m_sortedTerms.cbegin(), m_sortedTerms.cend(), term);
+         it != m_sortedTerms.cend() && it->startsWith(term) && expansions < kMaxPrefixExpansion;
+         ++it, ++expansions) {
+        readPostings(m_termIds.value(*it), merged);
+    }
+    if (expansions == 0) {
+        return nullptr;
+    }
+
+    std::sort(merged.begin(), merged.end(), [](const Posting &a, const Posting &b) {
+        return postingLess(a.document, a.position, b.document, b.position);
+    });
+    loaded.push_back(std::move(merged));
+    return &loaded.back();
+}
+
+void ChatSearchIndex::readPostings(quint32 term, std::vector<Posting> &postings) const
+{
+    // 段按文档号递增排列，依次读出后接上内存中的部分，结果仍然有序
+    for (const Segment &segment : m_segments) {
+        auto entry = std::lower_bound(segment.terms.begin(), segment.terms.end(), term,
+                                      [](const TermEntry &e, quint32 value) { return e.term < value; });
+        if (entry == segment.terms.end() || entry->term != term) {
+            continue;
+        }
+
+        if (!m_segmentsFile.seek(segment.dataOffset + entry->offset)) {
+            continue;
+        }
+        const QByteArray data = m_segmentsFile.read(entry->length);
+        const char *cursor = data.constData();
+        const char *end = cursor + data.size();
+        quint32 document = segment.documentBase;
+        quint64 delta = 0;
+        quint64 position = 0;
+        while (cursor < end && readVarint(cursor, end, &delta) && readVarint(cursor, end, &position)) {
+            document += static_cast<quint32>(delta);
+            postings.push_back({document, static_cast<quint32>(position)});
+        }
+    }
+
+    if (term < m_postings.size()) {
+        const std::vector<Posting> &tail = m_postings[term];
+        postings.insert(postings.end(), tail.begin(), tail.end());
+    }
+}
+
+bool ChatSearchIndex::readDocument(quint32 document, Document *doc) const
+{
+    if (document >= m_tailBase) {
+        if (document - m_tailBase >= m_documents.size()) {
+            return false;
+        }
+        *doc = m_documents[document - m_tailBase];
+        return true;
+    }
+
+    auto segment = std::upper_bound(m_segments.begin(), m_segments.end(), document,
+                                    [](quint32 value, const Segment &s) { return value < s.documentBase; });
+    if (segment == m_segments.begin()) {
+        return false;
+    }
+    --segment;
+    if (document - segment->documentBase >= segment->documentCount) {
+        return false;
+    }
+
+    const qint64 offset = segment->offset + kSegmentHeaderSize
+                        + qint64(document - segment->documentBase) * kDocumentEntrySize;
+    if (!m_segmentsFile.seek(offset)) {
+        return false;
+    }
+    const QByteArray entry = m_segmentsFile.read(kDocumentEntrySize);
+    if (entry.size() != kDocumentEntrySize) {
+        return false;
+    }
+    doc->chat = qFromLittleEndian<quint32>(entry.constData());
+    doc->record = qFromLittleEndian<quint32>(entry.constData() + 4);
+    doc->epoch = qFromLittleEndian<quint32>(entry.constData() + 8);
+    return true;
+}
+
+bool ChatSearchIndex::matchesClause(const QList<ClauseTerm> &terms, quint32 document)
+{
+    auto documentLess = [](const Posting &posting, quint32 value) { return posting.document < value; };
+
+    // 首词在该消息中的每个位置作为候选起点，其余词必须出现在对应的相对位置
+    const std::vector<Posting> &first = *terms.first().postings;
+    auto it = std::lower_bound(first.begin(), first.end(), document, documentLess);
+    for (; it != first.end() && it->document == document; ++it) {
+        if (it->position < terms.first().offset) {
+            continue;
+        }
+        quint32 start = it->position - terms.first().offset;
+
+        bool matched = true;
+        for (qsizetype i = 1; i < terms.size() && matched; ++i) {
+            const std::vector<Posting> &postings = *terms.at(i).postings;
+            quint32 position = start + terms.at(i).offset;
+            matched = std::binary_search(postings.begin(), postings.end(), Posting{document, position},
+                                         [](const Posting &a, const Posting &b) {
+                                             return postingLess(a.document, a.position, b.document, b.position);
+                                         });
+        }
+        if (matched) {
+            return true;
+        }
+    }
+    return false;
+}
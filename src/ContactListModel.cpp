@@ -0,0 +1,224 @@
+#include "include/ContactListModel.h"
+#include <QSet>
+
+ContactListModel::ContactListModel(const QString &keyField, const QStringList &fields, QObject *parent)
+    : QAbstractListModel(parent)
+    , m_keyField(keyField)
+    , m_fields(fields)
+{
+    if (!m_fields.contains(m_keyField)) {
+        m_fields.prepend(m_keyField);
+    }
+}
+
+int ContactListModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : static_cast<int>(m_rows.size());
+}
+
+QVariant ContactListModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_rows.size()) {
+        return QVariant();
+    }
+
+    int field = role - Qt::UserRole - 1;
+    if (field < 0 || field >= m_fields.size()) {
+        return QVariant();
+    }
+    return m_rows[index.row()].value(m_fields[field]);
+}
+
+QHash<int, QByteArray> ContactListModel::roleNames() const
+{
+    QHash<int, QByteArray> roles;
+    for (int i = 0; i < m_fields.size(); ++i) {
+        roles.insert(Qt::UserRole + 1 + i, m_fields[i].toUtf8());
+    }
+    return roles;
+}
+
+void ContactListModel::setContacts(const QVariantList &contacts)
+{
+    // 整理新快照，丢弃没有key或key重复的项
+    QList<QVariantMap> incoming;
+    QSet<QString> incomingKeys;
+    incoming.reserve(contacts.size());
+    incomingKeys.reserve(contacts.size());
+    for (const QVariant &contact : contacts) {
+        QVariantMap row = contact.toMap();
+        QString key = keyOf(row);
+        if (key.isEmpty() || incomingKeys.contains(key)) {
+            continue;
+        }
+        incomingKeys.insert(key);
+        incoming.append(std::move(row));
+    }
+
+    const qsizetype previousCount = m_rows.size();
+
+    // 删除新快照中不存在的行，连续的行合并为一次通知
+    for (qsizetype last = m_rows.size() - 1; last >= 0; --last) {
+        if (incomingKeys.contains(keyOf(m_rows[last]))) {
+            continue;
+        }
+        qsizetype first = last;
+        while (first > 0 && !incomingKeys.contains(keyOf(m_rows[first - 1]))) {
+            --first;
+        }
+        beginRemoveRows(QModelIndex(), static_cast<int>(first), static_cast<int>(last));
+        m_rows.remove(first, last - first + 1);
+        endRemoveRows();
+        last = first;
+    }
+
+    QSet<QString> present;
+    present.reserve(m_rows.size());
+    for (const QVariantMap &row : std::as_const(m_rows)) {
+        present.insert(keyOf(row));
+    }
+
+    // 此时剩余的行都在新快照中，按新顺序逐位对齐：
+    // [0, i)已与新快照一致，新增的行成段插入，位置不对的行移动过来，内容变化的行只通知变化的字段
+    qsizetype i = 0;
+    while (i < incoming.size()) {
+        const QString key = keyOf(incoming[i]);
+        if (!present.contains(key)) {
+            qsizetype end = i + 1;
+            while (end < incoming.size() && !present.contains(keyOf(incoming[end]))) {
+                ++end;
+            }
+            beginInsertRows(QModelIndex(), static_cast<int>(i), static_cast<int>(end - 1));
+            for (qsizetype k = i; k < end; ++k) {
+                m_rows.insert(k, incoming[k]);
+            }
+            endInsertRows();
+            i = end;
+            continue;
+        }
+
+        if (keyOf(m_rows[i]) != key) {
+            qsizetype from = i + 1;
+            while (keyOf(m_rows[from]) != key) {
+                ++from;
+            }
+            beginMoveRows(QModelIndex(), static_cast<int>(from), static_cast<int>(from),
+                          QModelIndex(), static_cast<int>(i));
+            m_rows.move(from, i);
+            endMoveRows();
+        }
+
+        if (m_rows[i] != incoming[i]) {
+            QList<int> roles = changedRoles(m_rows[i], incoming[i]);
+            m_rows[i] = incoming[i];
+            emit dataChanged(index(static_cast<int>(i)), index(static_cast<int>(i)), roles);
+        }
+        ++i;
+    }
+
+    if (m_rows.size() != previousCount) {
+        emit countChanged();
+    }
+}
+
+void ContactListModel::applyChanges(const QVariantList &changed, const QStringList &removed)
+{
+    if (changed.isEmpty() && removed.isEmpty()) {
+        return;
+    }
+
+    QHash<QString, qsizetype> changedRows;
+    changedRows.reserve(changed.size());
+    for (qsizetype i = 0; i < changed.size(); ++i) {
+        changedRows.insert(keyOf(changed[i].toMap()), i);
+    }
+    const QSet<QString> removedKeys(removed.begin(), removed.end());
+
+    // 合并出新快照后交给setContacts，由它计算需要通知的行
+    QVariantList merged;
+    merged.reserve(m_rows.size() + changed.size());
+    for (const QVariantMap &row : std::as_const(m_rows)) {
+        QString key = keyOf(row);
+        if (removedKeys.contains(key)) {
+            continue;
+        }
+        auto it = changedRows.find(key);
+        if (it != changedRows.end()) {
+            merged.append(changed[it.value()]);
+            changedRows.erase(it);
+        } else {
+            merged.append(row);
+        }
+    }
+    for (const QVariant &contact : changed) {
+        if (changedRows.contains(keyOf(contact.toMap()))) {
+            merged.append(contact);
+        }
+    }
+
+    setContacts(merged);
+}
+
+bool ContactListModel::setField(const QString &key, const QString &field, const QVariant &value)
+{
+    int row = rowOf(key);
+    int fieldIndex = static_cast<int>(m_fields.indexOf(field));
+    if (row < 0 || fieldIndex < 0 || field == m_keyField) {
+        return false;
+    }
+
+    QVariantMap &contact = m_rows[row];
+    if (contact.value(field) == value) {
+        return false;
+    }
+
+    contact.insert(field, value);
+    emit dataChanged(index(row), index(row), {Qt::UserRole + 1 + fieldIndex});
+    return true;
+}
+
+QVariantList ContactListModel::contacts() const
+{
+    QVariantList list;
+    list.reserve(m_rows.size());
+    for (const QVariantMap &row : m_rows) {
+        list.append(row);
+    }
+    return list;
+}
+
+QStringList ContactListModel::keys() const
+{
+    QStringList list;
+    list.reserve(m_rows.size());
+    for (const QVariantMap &row : m_rows) {
+        list.append(keyOf(row));
+    }
+    return list;
+}
+
+QVariantMap ContactListModel::get(int row) const
+{
+    return row >= 0 && row < m_rows.size() ? m_rows[row] : QVariantMap();
+}
+
+int ContactListModel::rowOf(const QString &key) const
+{
+    for (qsizetype row = 0; row < m_rows.size(); ++row) {
+        if (keyOf(m_rows[row]) == key) {
+            return static_cast<int>(row);
+        }
+    }
+    return -1;
+}
+
+QList<int> ContactListModel::changedRoles(const QVariantMap &before, const QVariantMap &after) const
+{
+    QList<int> roles;
+    for (int i = 0; i < m_fields.size(); ++i) {
+        if (before.value(m_fields[i]) != after.value(m_fields[i])) {
+            roles.append(Qt::UserRole + 1 + i);
+        }
+    }
+    return roles;
+}
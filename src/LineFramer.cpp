@@ -0,0 +1,138 @@
+#include "include/LineFramer.h"
+#include <QDebug>
+#include <QtEndian>
+#include <cstring>
+
+LineFramer::LineFramer(qsizetype maxFrameSize)
+    : m_head(0)
+    , m_scan(0)
+    , m_tail(0)
+    , m_maxFrameSize(maxFrameSize)
+    , m_error(false)
+{
+}
+
+qint64 LineFramer::readFrom(QIODevice *device)
+{
+    qint64 available = device->bytesAvailable();
+    if (available <= 0) {
+        return 0;
+    }
+
+    reserve(available);
+    qint64 bytesRead = device->read(m_buffer.data() + m_tail, available);
+    if (bytesRead > 0) {
+        m_tail += bytesRead;
+    }
+    return bytesRead;
+}
+
+void LineFramer::append(QByteArrayView data)
+{
+    if (data.isEmpty()) {
+        return;
+    }
+    reserve(data.size());
+    std::memcpy(m_buffer.data() + m_tail, data.data(), data.size());
+    m_tail += data.size();
+}
+
+bool LineFramer::nextFrame(QByteArrayView *frame)
+{
+    while (m_scan < m_tail) {
+        const char *base = m_buffer.constData();
+        const void *found = std::memchr(base + m_scan, '\n', m_tail - m_scan);
+        if (!found) {
+            m_scan = m_tail;
+            // 超长且没有分隔符的数据无法再组成合法帧，丢弃
+            if (m_tail - m_head > m_maxFrameSize) {
+                qWarning() << "接收的帧超过上限，已丢弃:" << m_tail - m_head << "字节";
+                discardPending();
+            }
+            return false;
+        }
+
+        qsizetype end = static_cast<const char *>(found) - base;
+        qsizetype start = m_head;
+        m_head = end + 1;
+        m_scan = m_head;
+
+        qsizetype length = end - start;
+        if (length > 0 && base[start + length - 1] == '\r') {
+            --length;
+        }
+        if (length == 0) {
+            continue; // 跳过空行
+        }
+
+        *frame = QByteArrayView(base + start, length);
+        return true;
+    }
+    return false;
+}
+
+bool LineFramer::nextSizedFrame(QByteArrayView *frame, bool *compressed)
+{
+    if (m_error || m_tail - m_head < kSizePrefixBytes) {
+        return false;
+    }
+
+    const char *base = m_buffer.constData();
+    quint32 length = qFromBigEndian<quint32>(base + m_head);
+    if (compressed) {
+        *compressed = (length & kCompressedFlag) != 0;
+        length &= ~kCompressedFlag;
+    }
+    if (length > static_cast<quint64>(m_maxFrameSize)) {
+        // 长度前缀错误后无法重新同步，交给调用方断开连接
+        qWarning() << "接收的帧超过上限:" << length << "字节";
+        m_error = true;
+        discardPending();
+        return false;
+    }
+    if (m_tail - m_head - kSizePrefixBytes < static_cast<qsizetype>(length)) {
+        return false;
+    }
+
+    *frame = QByteArrayView(base + m_head + kSizePrefixBytes, length);
+    m_head += kSizePrefixBytes + length;
+    m_scan = m_head;
+    return true;
+}
+
+QByteArrayView LineFramer::pending() const
+{
+    return QByteArrayView(m_buffer.constData() + m_head, m_tail - m_head);
+}
+
+void LineFramer::discardPending()
+{
+    m_head = m_scan = m_tail = 0;
+}
+
+void LineFramer::clear()
+{
+    discardPending();
+    m_error = false;
+    m_buffer.clear();
+}
+
+// 私有方法实现
+
+void LineFramer::reserve(qsizetype bytes)
+{
+    // 已消费的数据占缓冲区一半以上，或者没有未消费数据时，把剩余数据移到开头
+    if (m_head > 0 && (m_head == m_tail || m_head >= m_buffer.size() / 2)) {
+        qsizetype remaining = m_tail - m_head;
+        if (remaining > 0) {
+            std::memmove(m_buffer.data(), m_buffer.constData() + m_head, remaining);
+        }
+        m_scan -= m_head;
+        m_tail = remaining;
+        m_head = 0;
+    }
+
+    if (m_tail + bytes > m_buffer.size()) {
+        m_buffer.resize(qMax(m_tail + bytes, qMax<qsizetype>(m_buffer.size() * 2, kInitialCapacity)));
+    }
+}
@@ -17,6 +17,14 @@ Message::Message(MessageType type, const QVariantMap &data, QObject *parent)
 {
 }
 
+Message::Message(const NetMessage &message, QObject *parent)
+    : QObject(parent)
+    , m_type(message.type())
+    , m_data(message.toVariantMap())
+    , m_timestamp(QDateTime::currentDateTime())
+{
+}
+
 void Message::setType(MessageType type)
 {
     if (m_type != type) {
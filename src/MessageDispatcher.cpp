@@ -0,0 +1,54 @@
+#include "include/MessageDispatcher.h"
+#include <QDebug>
+
+int MessageDispatcher::indexOf(MessageType type)
+{
+    int index = static_cast<int>(type);
+    return index >= 0 && index < kTableSize ? index : -1;
+}
+
+bool MessageDispatcher::subscribe(MessageType type, QObject *receiver, Handler handler)
+{
+    int index = indexOf(type);
+    if (index < 0) {
+        qWarning() << "Message type outside dispatch table:" << static_cast<int>(type);
+        return false;
+    }
+
+    // 每种消息只交给一个处理方
+    Entry &entry = m_entries[index];
+    if (entry.receiver && entry.receiver != receiver) {
+        qWarning() << "Message type already has a handler:" << messageTypeToString(type);
+        return false;
+    }
+
+    entry.receiver = receiver;
+    entry.handler = std::move(handler);
+    return true;
+}
+
+void MessageDispatcher::unsubscribe(const QObject *receiver)
+{
+    for (Entry &entry : m_entries) {
+        if (entry.receiver == receiver) {
+            entry.receiver.clear();
+            entry.handler = nullptr;
+        }
+    }
+}
+
+bool MessageDispatcher::dispatch(const NetMessage &message) const
+{
+    int index = indexOf(message.type());
+    if (index < 0) {
+        return false;
+    }
+
+    const Entry &entry = m_entries[index];
+    if (!entry.receiver || !entry.handler) {
+        return false;
+    }
+
+    entry.handler(message);
+    return true;
+}
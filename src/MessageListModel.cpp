@@ -0,0 +1,212 @@
+#include "include/MessageListModel.h"
+#include <QDateTime>
+#include <QLocale>
+#include <algorithm>
+
+MessageListModel::MessageListModel(QObject *parent)
+    : QAbstractListModel(parent)
+{
+}
+
+int MessageListModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : static_cast<int>(m_items.size());
+}
+
+QVariant MessageListModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_items.size()) {
+        return QVariant();
+    }
+
+    const MessageItem &item = m_items[index.row()];
+    switch (role) {
+    case MessageIdRole:
+        return item.messageId;
+    case Qt::DisplayRole:
+    case TextRole:
+        return item.recalled ? QStringLiteral("[消息已撤回]") : item.content;
+    case IsOwnRole:
+        return !item.fromUserId.isEmpty() && item.fromUserId == m_currentUserId;
+    case TimestampRole:
+        // 与界面原有格式一致，例如 9:05 PM
+        return QLocale::c().toString(QDateTime::fromMSecsSinceEpoch(item.timestamp).time(),
+                                     QStringLiteral("h:mm AP"));
+    case TimestampMsRole:
+        return item.timestamp;
+    case StatusRole:
+        return item.status;
+    case FromUserIdRole:
+        return item.fromUserId;
+    case FromUsernameRole:
+        return item.fromUsername.isEmpty() ? item.fromUserId : item.fromUsername;
+    case RecalledRole:
+        return item.recalled;
+    default:
+        return QVariant();
+    }
+}
+
+QHash<int, QByteArray> MessageListModel::roleNames() const
+{
+    return {
+        {MessageIdRole, "messageId"},
+        {TextRole, "text"},
+        {IsOwnRole, "isOwn"},
+        {TimestampRole, "timestamp"},
+        {TimestampMsRole, "timestampMs"},
+        {StatusRole, "status"},
+        {FromUserIdRole, "fromUserId"},
+        {FromUsernameRole, "fromUsername"},
+        {RecalledRole, "recalled"},
+    };
+}
+
+void MessageListModel::setChat(const QString &type, const QString &chatId)
+{
+    if (m_chatType == type && m_chatId == chatId) {
+        return;
+    }
+
+    m_chatType = type;
+    m_chatId = chatId;
+    clear();
+    emit chatChanged();
+}
+
+bool MessageListModel::isShowing(const QString &type, const QString &chatId) const
+{
+    return !m_chatId.isEmpty() && m_chatType == type && m_chatId == chatId;
+}
+
+void MessageListModel::setCurrentUserId(const QString &userId)
+{
+    if (m_currentUserId == userId) {
+        return;
+    }
+
+    m_currentUserId = userId;
+    if (!m_items.isEmpty()) {
+        emit dataChanged(index(0), index(static_cast<int>(m_items.size()) - 1), {IsOwnRole});
+    }
+}
+
+MessageListModel::MessageItem MessageListModel::itemFromRecord(const ChatRecord &record)
+{
+    MessageItem item;
+    item.messageId = record.messageId;
+    item.fromUserId = record.fromUserId;
+    item.content = record.content;
+    item.timestamp = record.timestamp;
+    item.status = record.isRead ? QStringLiteral("read") : QStringLiteral("delivered");
+    item.recalled = record.recalled;
+    return item;
+}
+
+void MessageListModel::setRecords(const QList<ChatRecord> &records)
+{
+    QList<MessageItem> items;
+    items.reserve(records.size());
+    for (const ChatRecord &record : records) {
+        items.append(itemFromRecord(record));
+    }
+    std::stable_sort(items.begin(), items.end(), [](const MessageItem &a, const MessageItem &b) {
+        return a.timestamp < b.timestamp;
+    });
+
+    beginResetModel();
+    m_items = std::move(items);
+    endResetModel();
+    emit countChanged();
+}
+
+void MessageListModel::prependRecords(const QList<ChatRecord> &records)
+{
+    if (records.isEmpty()) {
+        return;
+    }
+
+    // 整页一次插入，视图只重新布局一次
+    QList<MessageItem> items;
+    items.reserve(records.size() + m_items.size());
+    for (const ChatRecord &record : records) {
+        items.append(itemFromRecord(record));
+    }
+
+    beginInsertRows(QModelIndex(), 0, static_cast<int>(records.size()) - 1);
+    items.append(std::move(m_items));
+    m_items = std::move(items);
+    endInsertRows();
+    emit countChanged();
+}
+
+void MessageListModel::appendMessage(const QString &messageId, const QString &fromUserId,
+                                     const QString &fromUsername, const QString &content,
+                                     qint64 timestamp, const QString &status)
+{
+    MessageItem item;
+    item.messageId = messageId;
+    item.fromUserId = fromUserId;
+    item.fromUsername = fromUsername;
+    item.content = content;
+    item.timestamp = timestamp;
+    item.status = status;
+
+    int row = static_cast<int>(m_items.size());
+    beginInsertRows(QModelIndex(), row, row);
+    m_items.append(std::move(item));
+    endInsertRows();
+    emit countChanged();
+}
+
+int MessageListModel::rowOf(const QString &messageId) const
+{
+    // 状态变化多发生在最新的消息上，从末尾开始查找
+    for (qsizetype row = m_items.size() - 1; row >= 0; --row) {
+        if (m_items[row].messageId == messageId) {
+            return static_cast<int>(row);
+        }
+    }
+    return -1;
+}
+
+bool MessageListModel::setStatus(const QString &messageId, const QString &status)
+{
+    int row = rowOf(messageId);
+    if (row < 0 || m_items[row].status == status) {
+        return false;
+    }
+
+    m_items[row].status = status;
+    emit dataChanged(index(row), index(row), {StatusRole});
+    return true;
+}
+
+bool MessageListModel::markRecalled(const QString &messageId)
+{
+    int row = rowOf(messageId);
+    if (row < 0 || m_items[row].recalled) {
+        return false;
+    }
+
+    m_items[row].recalled = true;
+    emit dataChanged(index(row), index(row), {TextRole, RecalledRole});
+    return true;
+}
+
+void MessageListModel::clear()
+{
+    if (m_items.isEmpty()) {
+        return;
+    }
+
+    beginResetModel();
+    m_items.clear();
+    endResetModel();
+    emit countChanged();
+}
+
+QString MessageListModel::firstMessageId() const
+{
+    return m_items.isEmpty() ? QString() : m_items.first().messageId;
+}
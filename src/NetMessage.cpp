@@ -0,0 +1,437 @@
+#include "include/NetMessage.h"
+#include <QDebug>
+#include <QJsonDocument>
+#include <QtEndian>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+// 二进制格式中值的类型标记
+enum class FieldTag : quint8 {
+    Null = 0,
+    String = 1,
+    Integer = 2,
+    Bool = 3,
+    Double = 4,
+    Bytes = 5,
+    List = 6,
+    Map = 7
+};
+
+constexpr int kMaxNestingDepth = 32;
+
+void writeVarint(QByteArray &out, quint64 value)
+{
+    while (value >= 0x80) {
+        out.append(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.append(static_cast<char>(value));
+}
+
+void writeBytes(QByteArray &out, QByteArrayView bytes)
+{
+    writeVarint(out, static_cast<quint64>(bytes.size()));
+    out.append(bytes.data(), bytes.size());
+}
+
+void writeValue(QByteArray &out, const QVariant &value, int depth);
+
+void writeMap(QByteArray &out, const QVariantMap &map, int depth)
+{
+    writeVarint(out, static_cast<quint64>(map.size()));
+    for (auto it = map.constBegin(); it != map.constEnd(); ++it) {
+        writeBytes(out, it.key().toUtf8());
+        writeValue(out, it.value(), depth + 1);
+    }
+}
+
+void writeValue(QByteArray &out, const QVariant &value, int depth)
+{
+    if (depth > kMaxNestingDepth) {
+        out.append(static_cast<char>(FieldTag::Null));
+        return;
+    }
+
+    switch (value.typeId()) {
+    case QMetaType::UnknownType:
+    case QMetaType::Nullptr:
+        out.append(static_cast<char>(FieldTag::Null));
+        break;
+    case QMetaType::Bool:
+        out.append(static_cast<char>(FieldTag::Bool));
+        out.append(value.toBool() ? '\1' : '\0');
+        break;
+    case QMetaType::Int:
+    case QMetaType::UInt:
+    case QMetaType::Long:
+    case QMetaType::LongLong:
+    case QMetaType::ULongLong: {
+        // zigzag编码，小的负数也只占很少字节
+        qint64 number = value.toLongLong();
+        out.append(static_cast<char>(FieldTag::Integer));
+        writeVarint(out, (static_cast<quint64>(number) << 1) ^ static_cast<quint64>(number >> 63));
+        break;
+    }
+    case QMetaType::Double:
+    case QMetaType::Float: {
+        out.append(static_cast<char>(FieldTag::Double));
+        char bytes[8];
+        qToLittleEndian(value.toDouble(), bytes);
+        out.append(bytes, sizeof(bytes));
+        break;
+    }
+    case QMetaType::QByteArray:
+        out.append(static_cast<char>(FieldTag::Bytes));
+        writeBytes(out, value.toByteArray());
+        break;
+    case QMetaType::QVariantList:
+    case QMetaType::QStringList:
+    case QMetaType::QJsonArray: {
+        const QVariantList list = value.toList();
+        out.append(static_cast<char>(FieldTag::List));
+        writeVarint(out, static_cast<quint64>(list.size()));
+        for (const QVariant &item : list) {
+            writeValue(out, item, depth + 1);
+        }
+        break;
+    }
+    case QMetaType::QVariantMap:
+    case QMetaType::QVariantHash:
+    case QMetaType::QJsonObject:
+        out.append(static_cast<char>(FieldTag::Map));
+        writeMap(out, value.toMap(), depth);
+        break;
+    default:
+        out.append(static_cast<char>(FieldTag::String));
+        writeBytes(out, value.toString().toUtf8());
+        break;
+    }
+}
+
+// 带边界检查的读取器，任何越界都会使ok变为false
+struct BinaryReader {
+    const char *data;
+    qsizetype size;
+    qsizetype pos = 0;
+    bool ok = true;
+
+    quint64 readVarint()
+    {
+        quint64 value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (pos >= size) {
+                ok = false;
+                return 0;
+            }
+            quint8 byte = static_cast<quint8>(data[pos++]);
+            value |= static_cast<quint64>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                return value;
+            }
+        }
+        ok = false;
+        return 0;
+    }
+
+    QByteArrayView readBytes()
+    {
+        quint64 length = readVarint();
+        if (!ok || length > static_cast<quint64>(size - pos)) {
+            ok = false;
+            return QByteArrayView();
+        }
+        QByteArrayView bytes(data + pos, static_cast<qsizetype>(length));
+        pos += static_cast<qsizetype>(length);
+        return bytes;
+    }
+
+    // 元素个数至少占一个字节，用剩余长度限制个数，避免恶意数据触发巨大分配
+    qsizetype readCount()
+    {
+        quint64 count = readVarint();
+        if (!ok || count > static_cast<quint64>(size - pos)) {
+            ok = false;
+            return 0;
+        }
+        return static_cast<qsizetype>(count);
+    }
+
+    QVariantMap readMap(int depth);
+
+    QVariant readValue(int depth)
+    {
+        if (pos >= size || depth > kMaxNestingDepth) {
+            ok = false;
+            return QVariant();
+        }
+
+        switch (static_cast<FieldTag>(data[pos++])) {
+        case FieldTag::Null:
+            return QVariant();
+        case FieldTag::String:
+            return QString::fromUtf8(readBytes());
+        case FieldTag::Integer: {
+            quint64 encoded = readVarint();
+            return static_cast<qint64>(encoded >> 1) ^ -static_cast<qint64>(encoded & 1);
+        }
+        case FieldTag::Bool:
+            if (pos >= size) {
+                ok = false;
+                return QVariant();
+            }
+            return data[pos++] != 0;
+        case FieldTag::Double: {
+            if (size - pos < 8) {
+                ok = false;
+                return QVariant();
+            }
+            double number = qFromLittleEndian<double>(data + pos);
+            pos += 8;
+            return number;
+        }
+        case FieldTag::Bytes:
+            return readBytes().toByteArray();
+        case FieldTag::List: {
+            qsizetype count = readCount();
+            QVariantList list;
+            list.reserve(count);
+            for (qsizetype i = 0; i < count && ok; ++i) {
+                list.append(readValue(depth + 1));
+            }
+            return list;
+        }
+        case FieldTag::Map:
+            return readMap(depth + 1);
+        }
+
+        ok = false;
+        return QVariant();
+    }
+};
+
+QVariantMap BinaryReader::readMap(int depth)
+{
+    QVariantMap map;
+    qsizetype count = readCount();
+    for (qsizetype i = 0; i < count && ok; ++i) {
+        QString key = QString::fromUtf8(readBytes());
+        QVariant value = readValue(depth + 1);
+        if (ok) {
+            map.insert(key, value);
+        }
+    }
+    return map;
+}
+
+} // namespace
+
+NetMessage::NetMessage()
+    : m_type(MessageType::ERROR)
+{
+}
+
+NetMessage::NetMessage(MessageType type, const QVariantMap &data)
+    : m_type(type)
+{
+    // 键仍然集中保存在m_raw中，值直接保存为QVariant
+    m_fields.reserve(data.size());
+    for (auto it = data.constBegin(); it != data.constEnd(); ++it) {
+        QByteArray key = it.key().toUtf8();
+        Field field;
+        field.keyOffset = static_cast<qint32>(m_raw.size());
+        field.keyLength = static_cast<qint32>(key.size());
+        field.typed = true;
+        field.value = it.value();
+        m_raw.append(key);
+        m_fields.append(field);
+    }
+}
+
+QVariant NetMessage::value(QByteArrayView key, const QVariant &defaultValue) const
+{
+    qsizetype index = findField(key);
+    return index < 0 ? defaultValue : fieldValue(m_fields[index]);
+}
+
+QString NetMessage::string(QByteArrayView key, const QString &defaultValue) const
+{
+    qsizetype index = findField(key);
+    return index < 0 ? defaultValue : stringAt(index);
+}
+
+QString NetMessage::stringAt(qsizetype index) const
+{
+    const Field &field = m_fields[index];
+    return field.typed ? field.value.toString() : QString::fromUtf8(rawValueOf(field));
+}
+
+QVariantMap NetMessage::toVariantMap() const
+{
+    QVariantMap data;
+    for (const Field &field : m_fields) {
+        data.insert(QString::fromUtf8(keyOf(field)), fieldValue(field));
+    }
+    return data;
+}
+
+QByteArray NetMessage::toText() const
+{
+    QByteArray out = QByteArray::number(static_cast<int>(m_type));
+    out.append(':');
+    for (qsizetype i = 0; i < m_fields.size(); ++i) {
+        const Field &field = m_fields[i];
+        if (i > 0) {
+            out.append(';');
+        }
+        out.append(keyOf(field));
+        out.append('=');
+        if (!field.typed) {
+            out.append(rawValueOf(field));
+            continue;
+        }
+
+        // 文本格式中列表和映射按服务器的约定编码为JSON字符串
+        int typeId = field.value.typeId();
+        if (typeId == QMetaType::QVariantList || typeId == QMetaType::QVariantMap
+            || typeId == QMetaType::QStringList) {
+            out.append(QJsonDocument::fromVariant(field.value).toJson(QJsonDocument::Compact));
+        } else {
+            out.append(field.value.toString().toUtf8());
+        }
+    }
+    return out;
+}
+
+bool NetMessage::fromText(QByteArrayView frame, NetMessage *message)
+{
+    qsizetype colon = frame.indexOf(':');
+    if (colon <= 0) {
+        qWarning() << "Invalid message format:" << frame.left(64);
+        return false;
+    }
+
+    bool ok;
+    int typeInt = frame.first(colon).toInt(&ok);
+    if (!ok) {
+        qWarning() << "Invalid message type:" << frame.first(colon);
+        return false;
+    }
+
+    message->m_type = static_cast<MessageType>(typeInt);
+    message->m_raw = frame.toByteArray();
+    message->m_fields.clear();
+
+    const char *base = message->m_raw.constData();
+    qsizetype pos = colon + 1;
+    qsizetype size = message->m_raw.size();
+    while (pos < size) {
+        const char *separator = static_cast<const char *>(std::memchr(base + pos, ';', size - pos));
+        qsizetype itemEnd = separator ? separator - base : size;
+
+        // 值中可能包含等号，只按第一个等号切分
+        const char *equals = static_cast<const char *>(std::memchr(base + pos, '=', itemEnd - pos));
+        if (equals) {
+            qsizetype keyStart = pos;
+            qsizetype keyEnd = equals - base;
+            while (keyStart < keyEnd && QChar::isSpace(static_cast<uchar>(base[keyStart]))) {
+                ++keyStart;
+            }
+            while (keyEnd > keyStart && QChar::isSpace(static_cast<uchar>(base[keyEnd - 1]))) {
+                --keyEnd;
+            }
+
+            Field field;
+            field.keyOffset = static_cast<qint32>(keyStart);
+            field.keyLength = static_cast<qint32>(keyEnd - keyStart);
+            field.valueOffset = static_cast<qint32>(equals - base + 1);
+            field.valueLength = static_cast<qint32>(itemEnd - field.valueOffset);
+            message->m_fields.append(field);
+        }
+        pos = itemEnd + 1;
+    }
+    return true;
+}
+
+QByteArray NetMessage::toBinary() const
+{
+    QByteArray out;
+    out.reserve(m_raw.size() + m_fields.size() * 4 + 8);
+    writeVarint(out, static_cast<quint64>(m_type));
+    writeVarint(out, static_cast<quint64>(m_fields.size()));
+    for (const Field &field : m_fields) {
+        writeBytes(out, keyOf(field));
+        if (field.typed) {
+            writeValue(out, field.value, 1);
+        } else {
+            out.append(static_cast<char>(FieldTag::String));
+            writeBytes(out, rawValueOf(field));
+        }
+    }
+    return out;
+}
+
+bool NetMessage::fromBinary(QByteArrayView payload, NetMessage *message)
+{
+    message->m_raw = payload.toByteArray();
+    message->m_fields.clear();
+
+    const char *base = message->m_raw.constData();
+    BinaryReader reader{base, message->m_raw.size()};
+    quint64 type = reader.readVarint();
+    qsizetype count = reader.readCount();
+    for (qsizetype i = 0; i < count && reader.ok; ++i) {
+        Field field;
+        QByteArrayView key = reader.readBytes();
+        field.keyOffset = static_cast<qint32>(key.data() - base);
+        field.keyLength = static_cast<qint32>(key.size());
+
+        // 字符串只记录位置，读取时再转换
+        if (reader.pos < reader.size && static_cast<FieldTag>(base[reader.pos]) == FieldTag::String) {
+            ++reader.pos;
+            QByteArrayView value = reader.readBytes();
+            field.valueOffset = static_cast<qint32>(value.data() - base);
+            field.valueLength = static_cast<qint32>(value.size());
+        } else {
+            field.typed = true;
+            field.value = reader.readValue(1);
+        }
+        message->m_fields.append(field);
+    }
+
+    if (!reader.ok || reader.pos != reader.size || type > static_cast<quint64>(std::numeric_limits<int>::max())) {
+        qWarning() << "Invalid binary message:" << payload.size() << "bytes";
+        return false;
+    }
+
+    message->m_type = static_cast<MessageType>(type);
+    return true;
+}
+
+// 私有方法实现
+
+qsizetype NetMessage::findField(QByteArrayView key) const
+{
+    for (qsizetype i = m_fields.size() - 1; i >= 0; --i) {
+        if (keyOf(m_fields[i]) == key) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+QByteArrayView NetMessage::keyOf(const Field &field) const
+{
+    return QByteArrayView(m_raw.constData() + field.keyOffset, field.keyLength);
+}
+
+QByteArrayView NetMessage::rawValueOf(const Field &field) const
+{
+    return QByteArrayView(m_raw.constData() + field.valueOffset, field.valueLength);
+}
+
+QVariant NetMessage::fieldValue(const Field &field) const
+{
+    return field.typed ? field.value : QVariant(QString::fromUtf8(rawValueOf(field)));
+}
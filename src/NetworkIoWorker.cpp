@@ -0,0 +1,573 @@
+#include "include/NetworkIoWorker.h"
+#include <QDebug>
+#include <QtEndian>
+
+NetworkIoWorker::NetworkIoWorker(InboundQueue *inbound, QObject *parent)
+    : QObject(parent)
+    , m_inbound(inbound)
+    , m_bytesSubmitted(0)
+    , m_bytesDelivered(0)
+    , m_wireFormat(static_cast<int>(WireFormat::Text))
+    , m_compression(false)
+    , m_queuedBytes(0)
+    , m_highWaterMark(0)
+    , m_readingStalled(false)
+    , m_wakePending(false)
+    , m_racing(false)
+    , m_racePort(0)
+    , m_lookupId(-1)
+{
+    m_clock.start();
+
+    // 定时器是工作对象的子对象，随工作对象一起移到工作线程
+    m_raceTimer = std::make_unique<QTimer>(this);
+    m_raceTimer->setSingleShot(true);
+    connect(m_raceTimer.get(), &QTimer::timeout,
+            this, &NetworkIoWorker::startNextAttempt);
+}
+
+NetworkIoWorker::~NetworkIoWorker()
+{
+    for (const auto &attempt : m_attempts) {
+        disconnect(attempt.get(), nullptr, this, nullptr);
+    }
+    if (m_socket && m_socket->state() == QAbstractSocket::ConnectedState) {
+        m_socket->disconnectFromHost();
+    }
+}
+
+void NetworkIoWorker::configureSocket(QTcpSocket *socket)
+{
+    socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+    socket->setSocketOption(QAbstractSocket::KeepAliveOption, 1);
+    // 限制套接字缓冲区，暂停读取时由TCP流量控制让服务器放慢发送
+    socket->setReadBufferSize(kSocketReadBufferSize);
+}
+
+void NetworkIoWorker::attachSocket(std::unique_ptr<QTcpSocket> socket)
+{
+    // 上一次连接的套接字可能还在自己的信号处理中，延迟释放
+    if (m_socket) {
+        disconnect(m_socket.get(), nullptr, this, nullptr);
+        m_socket.release()->deleteLater();
+    }
+
+    m_socket = std::move(socket);
+    disconnect(m_socket.get(), nullptr, this, nullptr);
+    connect(m_socket.get(), &QTcpSocket::disconnected,
+            this, &NetworkIoWorker::onSocketDisconnected);
+    connect(m_socket.get(), &QAbstractSocket::errorOccurred,
+            this, &NetworkIoWorker::onSocketError);
+    connect(m_socket.get(), &QTcpSocket::readyRead,
+            this, &NetworkIoWorker::onSocketReadyRead);
+    connect(m_socket.get(), &QTcpSocket::bytesWritten,
+            this, &NetworkIoWorker::onSocketBytesWritten);
+}
+
+void NetworkIoWorker::connectToHost(const QString &host, quint16 port)
+{
+    if (m_racing || (m_socket && m_socket->state() != QAbstractSocket::UnconnectedState)) {
+        qDebug() << "Connection already in progress";
+        return;
+    }
+
+    m_racing = true;
+    m_raceHost = host;
+    m_racePort = port;
+    m_raceQueue.clear();
+    m_raceTried.clear();
+    m_raceError.clear();
+
+    // IP地址直接连接，不需要解析
+    QHostAddress address(host);
+    if (!address.isNull()) {
+        qDebug() << "Using direct IP connection";
+        addCandidates({address});
+        return;
+    }
+
+    auto cached = m_dnsCache.constFind(raceKey());
+    if (cached != m_dnsCache.constEnd() && cached->expiresAt > m_clock.elapsed()) {
+        qDebug() << "Using cached addresses for" << host;
+        addCandidates(cached->addresses);
+        return;
+    }
+
+    // 缓存过期时先连接上次成功的地址，同时重新解析
+    auto preferred = m_preferredAddresses.constFind(raceKey());
+    if (preferred != m_preferredAddresses.constEnd()) {
+        addCandidates({*preferred});
+    }
+    qDebug() << "Resolving host:" << host;
+    m_lookupId = QHostInfo::lookupHost(host, this, &NetworkIoWorker::onHostLookedUp);
+}
+
+void NetworkIoWorker::onHostLookedUp(const QHostInfo &info)
+{
+    bool current = m_racing && info.lookupId() == m_lookupId;
+    if (info.lookupId() == m_lookupId) {
+        m_lookupId = -1;
+    }
+
+    QString key = info.hostName().toLower();
+    if (info.error() == QHostInfo::NoError && !info.addresses().isEmpty()) {
+        m_dnsCache.insert(key, ResolvedHost{info.addresses(), m_clock.elapsed() + kDnsCacheTtlMs});
+        qDebug() << "Resolved" << info.hostName() << "to" << info.addresses().size() << "addresses";
+        if (current) {
+            addCandidates(info.addresses());
+        }
+        return;
+    }
+
+    qWarning() << "Host lookup failed:" << info.errorString();
+    if (!current) {
+        return;
+    }
+    m_raceError = info.errorString();
+
+    // 解析失败时退回到过期的缓存结果
+    auto stale = m_dnsCache.constFind(key);
+    if (stale != m_dnsCache.constEnd()) {
+        addCandidates(stale->addresses);
+    }
+    finishRaceIfExhausted();
+}
+
+void NetworkIoWorker::addCandidates(const QList<QHostAddress> &addresses)
+{
+    // 按IPv6、IPv4交替排列，上次成功的地址排在最前
+    QHostAddress preferred = m_preferredAddresses.value(raceKey());
+    QList<QHostAddress> ipv6;
+    QList<QHostAddress> ipv4;
+    bool hasPreferred = false;
+    for (const QHostAddress &address : addresses) {
+        if (m_raceTried.contains(address) || m_raceQueue.contains(address)) {
+            continue;
+        }
+        if (!preferred.isNull() && address == preferred) {
+            hasPreferred = true;
+        } else if (address.protocol() == QAbstractSocket::IPv6Protocol) {
+            ipv6.append(address);
+        } else {
+            ipv4.append(address);
+        }
+    }
+
+    if (hasPreferred) {
+        m_raceQueue.append(preferred);
+    }
+    for (qsizetype i = 0; i < qMax(ipv6.size(), ipv4.size()); ++i) {
+        if (i < ipv6.size()) {
+            m_raceQueue.append(ipv6[i]);
+        }
+        if (i < ipv4.size()) {
+            m_raceQueue.append(ipv4[i]);
+        }
+    }
+
+    // 没有进行中的尝试时立即开始，否则等错开的定时器
+    if (m_attempts.empty()) {
+        startNextAttempt();
+    } else if (!m_raceTimer->isActive() && !m_raceQueue.isEmpty()) {
+        m_raceTimer->start(kConnectAttemptDelayMs);
+    }
+}
+
+void NetworkIoWorker::startNextAttempt()
+{
+    if (!m_racing) {
+        return;
+    }
+    if (m_raceQueue.isEmpty()) {
+        finishRaceIfExhausted();
+        return;
+    }
+
+    QHostAddress address = m_raceQueue.takeFirst();
+    m_raceTried.append(address);
+
+    // 套接字在工作线程中创建，事件也在工作线程中处理
+    auto socket = std::make_unique<QTcpSocket>();
+    configureSocket(socket.get());
+    QTcpSocket *attempt = socket.get();
+    connect(attempt, &QTcpSocket::connected, this, [this, attempt]() {
+        onAttemptConnected(attempt);
+    });
+    connect(attempt, &QAbstractSocket::errorOccurred, this, [this, attempt]() {
+        onAttemptFailed(attempt);
+    });
+    m_attempts.push_back(std::move(socket));
+
+    qDebug() << "Connecting to" << address.toString() << "port" << m_racePort;
+    attempt->connectToHost(address, m_racePort);
+
+    if (!m_raceQueue.isEmpty()) {
+        m_raceTimer->start(kConnectAttemptDelayMs);
+    }
+}
+
+std::unique_ptr<QTcpSocket> NetworkIoWorker::takeAttempt(QTcpSocket *socket)
+{
+    for (auto it = m_attempts.begin(); it != m_attempts.end(); ++it) {
+        if (it->get() == socket) {
+            std::unique_ptr<QTcpSocket> attempt = std::move(*it);
+            m_attempts.erase(it);
+            return attempt;
+        }
+    }
+    return nullptr;
+}
+
+void NetworkIoWorker::onAttemptConnected(QTcpSocket *socket)
+{
+    std::unique_ptr<QTcpSocket> winner = takeAttempt(socket);
+    if (!winner) {
+        return;
+    }
+
+    // 其余尝试全部放弃
+    cancelRace();
+    if (QHostAddress(m_raceHost).isNull()) {
+        m_preferredAddresses.insert(raceKey(), winner->peerAddress());
+    }
+    qDebug() << "Connected to" << winner->peerAddress().toString();
+
+    attachSocket(std::move(winner));
+    onSocketConnected();
+}
+
+void NetworkIoWorker::onAttemptFailed(QTcpSocket *socket)
+{
+    std::unique_ptr<QTcpSocket> attempt = takeAttempt(socket);
+    if (!attempt) {
+        return;
+    }
+
+    m_raceError = attempt->errorString();
+    qDebug() << "Connection attempt failed:" << m_raceError;
+    disconnect(attempt.get(), nullptr, this, nullptr);
+    attempt.release()->deleteLater();
+
+    // 失败后不再等待，立即尝试下一个地址
+    if (!m_raceQueue.isEmpty()) {
+        m_raceTimer->stop();
+        startNextAttempt();
+    } else {
+        finishRaceIfExhausted();
+    }
+}
+
+void NetworkIoWorker::finishRaceIfExhausted()
+{
+    if (!m_racing || !m_attempts.empty() || !m_raceQueue.isEmpty() || m_lookupId != -1) {
+        return;
+    }
+
+    // 全部地址都失败时丢弃缓存，下次重新解析
+    m_racing = false;
+    m_dnsCache.remove(raceKey());
+    m_preferredAddresses.remove(raceKey());
+    emit errorOccurred(m_raceError.isEmpty() ? QStringLiteral("无法连接到服务器") : m_raceError, true);
+}
+
+void NetworkIoWorker::cancelRace()
+{
+    m_racing = false;
+    if (m_lookupId != -1) {
+        QHostInfo::abortHostLookup(m_lookupId);
+        m_lookupId = -1;
+    }
+    m_raceTimer->stop();
+    m_raceQueue.clear();
+    for (auto &attempt : m_attempts) {
+        disconnect(attempt.get(), nullptr, this, nullptr);
+        attempt->abort();
+        attempt.release()->deleteLater();
+    }
+    m_attempts.clear();
+}
+
+void NetworkIoWorker::disconnectFromHost()
+{
+    // 主动断开时同时取消进行中的解析和连接竞速
+    if (m_racing) {
+        cancelRace();
+    }
+    if (!m_socket) {
+        return;
+    }
+    if (m_socket->state() == QAbstractSocket::ConnectedState) {
+        m_socket->disconnectFromHost();
+    } else if (m_socket->state() != QAbstractSocket::UnconnectedState) {
+        m_socket->abort();
+    }
+}
+
+void NetworkIoWorker::abortConnection()
+{
+    if (m_racing) {
+        cancelRace();
+        emit errorOccurred(QStringLiteral("连接已取消"), true);
+        return;
+    }
+    if (m_socket && m_socket->state() != QAbstractSocket::UnconnectedState) {
+        m_socket->abort();
+    }
+}
+
+void NetworkIoWorker::writeBatch(const QByteArray &data, const QList<Delivery> &deliveries)
+{
+    // 先计入待发字节数，调用方可以立即据此判断是否达到高水位
+    m_queuedBytes.fetchAndAddRelaxed(data.size());
+    QMetaObject::invokeMethod(this, [this, data, deliveries]() {
+        writeData(data, deliveries);
+    }, Qt::QueuedConnection);
+}
+
+void NetworkIoWorker::writeData(const QByteArray &data, const QList<Delivery> &deliveries)
+{
+    qint64 bytesWritten = -1;
+    if (m_socket && m_socket->state() == QAbstractSocket::ConnectedState) {
+        bytesWritten = m_socket->write(data);
+        if (bytesWritten == -1) {
+            qWarning() << "Failed to send messages:" << m_socket->errorString();
+        }
+    }
+
+    if (bytesWritten == -1) {
+        m_queuedBytes.fetchAndSubRelaxed(data.size());
+        QList<quint64> tickets;
+        for (const Delivery &delivery : deliveries) {
+            tickets.append(delivery.ticket);
+        }
+        if (!tickets.isEmpty()) {
+            emit deliveriesFinished(tickets, false);
+        }
+        return;
+    }
+
+    for (const Delivery &delivery : deliveries) {
+        m_pendingDeliveries.enqueue(PendingDelivery{m_bytesSubmitted + delivery.endOffset, delivery.ticket});
+    }
+    m_bytesSubmitted += bytesWritten;
+}
+
+void NetworkIoWorker::resumeReading()
+{
+    if (!m_readingStalled.loadAcquire()) {
+        return;
+    }
+
+    NetMessage message = std::move(*m_stalledMessage);
+    m_stalledMessage.reset();
+    m_readingStalled.storeRelease(false);
+    if (!pushMessage(std::move(message))) {
+        return;
+    }
+
+    // 先处理帧缓冲中剩余的帧，再读取暂停期间留在套接字中的数据
+    processReceivedFrames();
+    if (!m_readingStalled.loadAcquire() && m_socket && m_socket->bytesAvailable() > 0) {
+        onSocketReadyRead();
+    }
+}
+
+void NetworkIoWorker::onSocketConnected()
+{
+    // 新连接总是从文本格式开始
+    m_framer.clear();
+    m_wireFormat.storeRelease(static_cast<int>(WireFormat::Text));
+    m_compression.storeRelease(false);
+    failPendingDeliveries();
+
+    emit connected();
+    startNegotiation();
+}
+
+void NetworkIoWorker::onSocketDisconnected()
+{
+    failPendingDeliveries();
+    emit disconnected();
+}
+
+void NetworkIoWorker::onSocketError(QAbstractSocket::SocketError error)
+{
+    Q_UNUSED(error)
+    emit errorOccurred(m_socket->errorString(), m_socket->state() == QAbstractSocket::UnconnectedState);
+}
+
+void NetworkIoWorker::onSocketReadyRead()
+{
+    // 队列已满时数据留在套接字中，等消费者取出消息后再读
+    if (m_readingStalled.loadAcquire()) {
+        return;
+    }
+
+    m_framer.readFrom(m_socket.get());
+    processReceivedFrames();
+}
+
+void NetworkIoWorker::onSocketBytesWritten(qint64 bytes)
+{
+    m_bytesDelivered += bytes;
+    QList<quint64> delivered;
+    while (!m_pendingDeliveries.isEmpty() && m_pendingDeliveries.head().endOffset <= m_bytesDelivered) {
+        delivered.append(m_pendingDeliveries.dequeue().ticket);
+    }
+    if (!delivered.isEmpty()) {
+        emit deliveriesFinished(delivered, true);
+    }
+
+    // 从高水位之上降到之下时通知发送方继续
+    qint64 highWaterMark = m_highWaterMark.loadRelaxed();
+    qint64 before = m_queuedBytes.fetchAndSubRelaxed(bytes);
+    if (before >= highWaterMark && before - bytes < highWaterMark) {
+        emit writeBufferDrained();
+    }
+}
+
+void NetworkIoWorker::processReceivedFrames()
+{
+    // 协商响应之后的帧使用二进制格式，每一帧都重新判断
+    QByteArrayView frame;
+    bool compressed = false;
+    while (!m_readingStalled.loadAcquire() && nextFrame(&frame, &compressed)) {
+        processFrame(frame, compressed);
+    }
+
+    if (m_framer.hasError()) {
+        qWarning() << "Invalid frame received, closing connection";
+        m_socket->abort();
+        return;
+    }
+    if (m_readingStalled.loadAcquire() || wireFormat() != WireFormat::Text) {
+        return;
+    }
+
+    // 兼容不以换行结尾的服务器消息：剩余数据以"数字:"开头时立即处理
+    QByteArrayView pending = m_framer.pending();
+    qsizetype digits = 0;
+    while (digits < pending.size() && pending[digits] >= '0' && pending[digits] <= '9') {
+        ++digits;
+    }
+    if (digits > 0 && digits < pending.size() && pending[digits] == ':') {
+        processFrame(pending.trimmed());
+        m_framer.discardPending();
+    }
+}
+
+bool NetworkIoWorker::nextFrame(QByteArrayView *frame, bool *compressed)
+{
+    *compressed = false;
+    if (wireFormat() == WireFormat::Binary) {
+        return m_framer.nextSizedFrame(frame, compressed);
+    }
+    return m_framer.nextFrame(frame);
+}
+
+bool NetworkIoWorker::processFrame(QByteArrayView frame, bool compressed)
+{
+    NetMessage message;
+    bool parsed = false;
+    if (compressed) {
+        QByteArray payload;
+        parsed = inflateFrame(frame, &payload) && NetMessage::fromBinary(payload, &message);
+    } else if (wireFormat() == WireFormat::Binary) {
+        parsed = NetMessage::fromBinary(frame, &message);
+    } else {
+        parsed = NetMessage::fromText(frame.trimmed(), &message);
+    }
+
+    if (!parsed) {
+        qWarning() << "Failed to parse message:" << frame.size() << "bytes";
+        return true;
+    }
+
+    // 服务器在这条文本响应之后开始发送二进制帧，必须在解析下一帧之前切换
+    if (message.type() == MessageType::PROTOCOL_NEGOTIATE_RESPONSE && message.string("format") == "binary") {
+        m_wireFormat.storeRelease(static_cast<int>(WireFormat::Binary));
+        m_compression.storeRelease(message.string("compression") == "zlib");
+    }
+
+    return pushMessage(std::move(message));
+}
+
+bool NetworkIoWorker::pushMessage(NetMessage &&message)
+{
+    bool pushed = m_inbound->push(std::move(message));
+    if (!pushed) {
+        // 队列已满，保留这条消息并暂停读取
+        m_stalledMessage = std::move(message);
+        m_readingStalled.storeRelease(true);
+    }
+
+    // 只在消费者没有待处理的通知时发出信号，避免每条消息一个跨线程事件
+    if (m_wakePending.testAndSetOrdered(false, true)) {
+        emit messagesAvailable();
+    }
+    return pushed;
+}
+
+void NetworkIoWorker::appendBinaryFrame(QByteArray &out, const QByteArray &payload, bool compress)
+{
+    char prefix[LineFramer::kSizePrefixBytes];
+    if (compress && payload.size() >= kCompressionThreshold) {
+        // 压缩帧的内容为qCompress的输出：4字节大端原始长度 + zlib数据
+        QByteArray packed = qCompress(payload);
+        if (packed.size() < payload.size()) {
+            qToBigEndian<quint32>(static_cast<quint32>(packed.size()) | LineFramer::kCompressedFlag, prefix);
+            out.append(prefix, sizeof(prefix));
+            out.append(packed);
+            return;
+        }
+    }
+
+    qToBigEndian<quint32>(static_cast<quint32>(payload.size()), prefix);
+    out.append(prefix, sizeof(prefix));
+    out.append(payload);
+}
+
+bool NetworkIoWorker::inflateFrame(QByteArrayView frame, QByteArray *payload)
+{
+    // 先检查声明的原始长度，避免按伪造的长度分配内存
+    if (frame.size() < 4) {
+        return false;
+    }
+    quint32 size = qFromBigEndian<quint32>(frame.data());
+    if (size > kMaxInflatedFrameSize) {
+        qWarning() << "Compressed frame too large:" << size << "bytes";
+        return false;
+    }
+
+    *payload = qUncompress(reinterpret_cast<const uchar *>(frame.data()), frame.size());
+    return static_cast<quint32>(payload->size()) == size;
+}
+
+void NetworkIoWorker::startNegotiation()
+{
+    QVariantMap data;
+    data["version"] = 1;
+    data["formats"] = "binary,text";
+    data["compression"] = "zlib";
+    QByteArray frame = NetMessage(MessageType::PROTOCOL_NEGOTIATE, data).toText();
+    frame.append('\n');
+
+    m_queuedBytes.fetchAndAddRelaxed(frame.size());
+    writeData(frame, QList<Delivery>());
+}
+
+void NetworkIoWorker::failPendingDeliveries()
+{
+    // 已写入套接字但未发出的数据随连接一起丢失
+    m_queuedBytes.fetchAndSubRelaxed(m_bytesSubmitted - m_bytesDelivered);
+    m_bytesSubmitted = 0;
+    m_bytesDelivered = 0;
+
+    QList<quint64> tickets;
+    while (!m_pendingDeliveries.isEmpty()) {
+        tickets.append(m_pendingDeliveries.dequeue().ticket);
+    }
+    if (!tickets.isEmpty()) {
+        emit deliveriesFinished(tickets, false);
+    }
+}
@@ -1,55 +1,131 @@
 #include "include/NetworkManager.h"
 #include <QDebug>
-#include <QHostAddress>
+#include <QGuiApplication>
 #include <QMutexLocker>
-#include <QRegularExpression>
+#include <QMetaMethod>
+#include <QRandomGenerator>
+#include <algorithm>
+#include <limits>
 
 NetworkManager::NetworkManager(QObject *parent)
     : QObject(parent)
+    , m_inbound(kInboundQueueCapacity)
+    , m_worker(new NetworkIoWorker(&m_inbound))
     , m_serverHost("127.0.0.1")  // 直接使用IP地址而不是localhost
     , m_serverPort(8888)
+    , m_nextDeliveryTicket(1)
+    , m_sendHighWaterMark(kDefaultSendHighWaterMark)
+    , m_flushScheduled(false)
     , m_isConnected(false)
+    , m_connecting(false)
     , m_connectionStartTime(0)
+    , m_negotiating(false)
+    , m_nextRequestId(1)
+    , m_autoReconnect(true)
+    , m_manualDisconnect(false)
+    , m_reconnectAttempt(0)
+    , m_resuming(false)
+    , m_heartbeatBaseIntervalMs(kDefaultHeartbeatIntervalMs)
+    , m_heartbeatSeq(0)
+    , m_outstandingHeartbeat(0)
+    , m_heartbeatSentAt(0)
+    , m_missedHeartbeats(0)
+    , m_srtt(-1)
+    , m_rttVar(-1)
+    , m_appActive(true)
 {
+    m_clock.start();
     initializeComponents();
 }
 
 NetworkManager::~NetworkManager()
 {
-    if (m_socket && m_socket->state() == QAbstractSocket::ConnectedState) {
-        m_socket->disconnectFromHost();
-    }
+    m_manualDisconnect = true;
     stopHeartbeat();
+    
+    // 工作对象在线程结束时析构，析构时断开仍然有效的连接
+    m_ioThread.quit();
+    m_ioThread.wait();
+}
+
+template <typename Function>
+void NetworkManager::postToWorker(Function function)
+{
+    QMetaObject::invokeMethod(m_worker, std::move(function), Qt::QueuedConnection);
 }
 
 void NetworkManager::initializeComponents()
 {
-    // 初始化Socket
-    m_socket = std::make_unique<QTcpSocket>(this);
+    // 启动I/O线程，套接字在其中创建和读写
+    m_ioThread.setObjectName("NetworkIoWorker");
+    m_worker->setHighWaterMark(m_sendHighWaterMark);
+    m_worker->moveToThread(&m_ioThread);
+    connect(&m_ioThread, &QThread::finished, m_worker, &QObject::deleteLater);
+    connect(m_worker, &NetworkIoWorker::connected,
+            this, &NetworkManager::onWorkerConnected);
+    connect(m_worker, &NetworkIoWorker::disconnected,
+            this, &NetworkManager::onWorkerDisconnected);
+    connect(m_worker, &NetworkIoWorker::errorOccurred,
+            this, &NetworkManager::onWorkerError);
+    connect(m_worker, &NetworkIoWorker::deliveriesFinished,
+            this, &NetworkManager::onDeliveriesFinished);
+    connect(m_worker, &NetworkIoWorker::messagesAvailable,
+            this, &NetworkManager::scheduleDrain);
+    // 缓冲区有空间后继续发送积压的消息
+    connect(m_worker, &NetworkIoWorker::writeBufferDrained,
+            this, &NetworkManager::scheduleFlush);
+    m_ioThread.start();
     
-    // 优化TCP连接选项 - 更激进的优化
-    m_socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
-    m_socket->setSocketOption(QAbstractSocket::KeepAliveOption, 1);
-    
-    // 尝试禁用Nagle算法（如果支持）
-    #ifdef TCP_NODELAY
-    m_socket->setSocketOption(QAbstractSocket::LowDelayOption, 1);
-    #endif
-    
-    // 连接Socket信号
-    connect(m_socket.get(), &QTcpSocket::connected, 
-            this, &NetworkManager::onSocketConnected);
-    connect(m_socket.get(), &QTcpSocket::disconnected, 
-            this, &NetworkManager::onSocketDisconnected);
-    connect(m_socket.get(), QOverload<QAbstractSocket::SocketError>::of(&QAbstractSocket::errorOccurred),
-            this, &NetworkManager::onSocketError);
-    connect(m_socket.get(), &QTcpSocket::readyRead, 
-            this, &NetworkManager::onSocketReadyRead);
+    // 收到的消息每帧分发一次
+    m_drainTimer = std::make_unique<QTimer>(this);
+    m_drainTimer->setSingleShot(true);
+    m_drainTimer->setTimerType(Qt::PreciseTimer);
+    connect(m_drainTimer.get(), &QTimer::timeout,
+            this, &NetworkManager::drainInbound);
+    m_lastDrain.start();
     
     // 初始化心跳定时器
     m_heartbeatTimer = std::make_unique<QTimer>(this);
     connect(m_heartbeatTimer.get(), &QTimer::timeout, 
             this, &NetworkManager::sendHeartbeat);
+    
+    // 心跳响应超时
+    m_heartbeatTimeoutTimer = std::make_unique<QTimer>(this);
+    m_heartbeatTimeoutTimer->setSingleShot(true);
+    connect(m_heartbeatTimeoutTimer.get(), &QTimer::timeout,
+            this, &NetworkManager::onHeartbeatTimeout);
+    
+    // 应用不在前台时放慢心跳
+    if (auto *app = qobject_cast<QGuiApplication *>(QCoreApplication::instance())) {
+        m_appActive = app->applicationState() == Qt::ApplicationActive;
+        connect(app, &QGuiApplication::applicationStateChanged,
+                this, &NetworkManager::onApplicationStateChanged);
+    }
+    
+    // 协商超时说明服务器不支持，回退到文本格式
+    m_negotiationTimer = std::make_unique<QTimer>(this);
+    m_negotiationTimer->setSingleShot(true);
+    m_negotiationTimer->setInterval(kNegotiationTimeoutMs);
+    connect(m_negotiationTimer.get(), &QTimer::timeout, this, [this]() {
+        if (m_negotiating) {
+            qDebug() << "Protocol negotiation timed out, using text format";
+            finishNegotiation(WireFormat::Text);
+        } else if (m_resuming) {
+            finishResume(false, "恢复会话超时");
+        }
+    });
+    
+    // 重连定时器
+    m_reconnectTimer = std::make_unique<QTimer>(this);
+    m_reconnectTimer->setSingleShot(true);
+    connect(m_reconnectTimer.get(), &QTimer::timeout,
+            this, &NetworkManager::attemptReconnect);
+    
+    // 有请求等待响应时定期检查超时
+    m_requestTimer = std::make_unique<QTimer>(this);
+    m_requestTimer->setInterval(kRequestSweepIntervalMs);
+    connect(m_requestTimer.get(), &QTimer::timeout,
+            this, &NetworkManager::expireRequests);
 }
 
 bool NetworkManager::isConnected() const
@@ -73,41 +149,116 @@ void NetworkManager::setServerPort(int port)
     }
 }
 
+void NetworkManager::setSendHighWaterMark(qint64 bytes)
+{
+    m_sendHighWaterMark = qMax<qint64>(1, bytes);
+    m_worker->setHighWaterMark(m_sendHighWaterMark);
+    scheduleFlush();
+}
+
+int NetworkManager::queuedMessageCount() const
+{
+    QMutexLocker locker(&m_sendMutex);
+    return static_cast<int>(m_sendQueue.size());
+}
+
+QFuture<NetMessage> NetworkManager::request(MessageType type, const QVariantMap &data, MessageType responseType,
+                                            int timeoutMs)
+{
+    auto promise = std::make_shared<QPromise<NetMessage>>();
+    QFuture<NetMessage> future = promise->future();
+    promise->start();
+    
+    quint32 requestId = m_nextRequestId++;
+    if (m_nextRequestId == 0) {
+        m_nextRequestId = 1;
+    }
+    
+    qint64 deadline = m_clock.elapsed() + timeoutMs;
+    m_pendingRequests[requestId] = PendingRequest{responseType, deadline, promise};
+    if (!m_requestTimer->isActive()) {
+        m_requestTimer->start();
+    }
+    
+    QVariantMap requestData = data;
+    requestData["reqId"] = QString::number(requestId);
+    sendMessage(NetMessage(type, requestData));
+    return future;
+}
+
+bool NetworkManager::isReconnecting() const
+{
+    return m_reconnectTimer->isActive() || (m_reconnectAttempt > 0 && !m_isConnected);
+}
+
+void NetworkManager::setAutoReconnect(bool enabled)
+{
+    m_autoReconnect = enabled;
+    if (!enabled && m_reconnectTimer->isActive()) {
+        m_reconnectTimer->stop();
+        emit reconnectingChanged();
+    }
+}
+
+void NetworkManager::setSession(const QString &userId, const QString &token)
+{
+    m_sessionUserId = userId;
+    m_sessionToken = token;
+}
+
+void NetworkManager::clearSession()
+{
+    m_sessionUserId.clear();
+    m_sessionToken.clear();
+    m_lastMessageId.clear();
+}
+
 void NetworkManager::connectToServer()
 {
-    if (m_socket->state() == QAbstractSocket::ConnectedState) {
+    m_manualDisconnect = false;
+    m_reconnectTimer->stop();
+    
+    if (m_isConnected) {
         qDebug() << "Already connected to server";
         return;
     }
     
-    if (m_socket->state() == QAbstractSocket::ConnectingState) {
+    if (m_connecting) {
         qDebug() << "Connection already in progress";
         return;
     }    qDebug() << "Connecting to server:" << m_serverHost << ":" << m_serverPort;
     
     // 记录连接开始时间
     m_connectionStartTime = QDateTime::currentMSecsSinceEpoch();
+    m_connecting = true;
     
-    // 使用QHostAddress直接连接，避免DNS解析
-    QHostAddress address(m_serverHost);
-    if (address.isNull()) {
-        // 如果不是有效的IP地址，使用默认的connectToHost
-        qDebug() << "Using hostname connection";
-        m_socket->connectToHost(m_serverHost, static_cast<quint16>(m_serverPort));
-    } else {
-        // 直接使用IP地址连接，避免DNS查找
-        qDebug() << "Using direct IP connection";
-        m_socket->connectToHost(address, static_cast<quint16>(m_serverPort));
-    }
+    NetworkIoWorker *worker = m_worker;
+    QString host = m_serverHost;
+    quint16 port = static_cast<quint16>(m_serverPort);
+    postToWorker([worker, host, port]() {
+        worker->connectToHost(host, port);
+    });
 }
 
 void NetworkManager::disconnectFromServer()
 {
+    m_manualDisconnect = true;
+    if (m_reconnectTimer->isActive() || m_reconnectAttempt > 0) {
+        m_reconnectTimer->stop();
+        m_reconnectAttempt = 0;
+        emit reconnectingChanged();
+    }
     stopHeartbeat();
     
-    if (m_socket->state() == QAbstractSocket::ConnectedState) {
-        m_socket->disconnectFromHost();
-    }
+    // 主动断开时不再保留未发送的消息
+    failQueuedMessages();
+    
+    // 连接中(解析或竞速)时也要取消，否则连接仍会完成
+    m_connecting = false;
+    NetworkIoWorker *worker = m_worker;
+    postToWorker([worker]() {
+        worker->disconnectFromHost();
+    });
 }
 
 void NetworkManager::sendMessage(const Message *message)
@@ -117,29 +268,141 @@ void NetworkManager::sendMessage(const Message *message)
         return;
     }
     
+    sendMessage(message->toNetMessage());
+}
+
+void NetworkManager::sendMessage(MessageType type, const QVariantMap &data)
+{
+    sendMessage(NetMessage(type, data));
+}
+
+void NetworkManager::sendMessage(const NetMessage &message)
+{
+    sendMessage(message, DeliveryCallback());
+}
+
+void NetworkManager::sendMessage(const NetMessage &message, DeliveryCallback callback)
+{
     if (!m_isConnected) {
-        qWarning() << "Not connected to server, cannot send message";
-        return;
+        qDebug() << "Not connected to server, message queued:" << messageTypeToString(message.type());
+    }
+    
+    QueuedMessage dropped;
+    bool overflow = false;
+    {
+        QMutexLocker locker(&m_sendMutex);
+        m_sendQueue.enqueue(QueuedMessage{message, std::move(callback)});
+        // 长时间断线时丢弃最早的消息，避免队列无限增长
+        if (m_sendQueue.size() > kMaxQueuedMessages) {
+            dropped = m_sendQueue.dequeue();
+            overflow = true;
+        }
     }
     
-    QString messageString = message->toString() + "\n";
-    QByteArray data = messageString.toUtf8();
+    if (overflow) {
+        qWarning() << "Send queue full, dropping message:" << messageTypeToString(dropped.message.type());
+        if (dropped.callback) {
+            dropped.callback(false);
+        }
+    }
     
-    qint64 bytesWritten = m_socket->write(data);
-    if (bytesWritten == -1) {
-        qWarning() << "Failed to send message:" << m_socket->errorString();
+    scheduleFlush();
+}
+
+void NetworkManager::appendFrame(QByteArray &out, const NetMessage &message) const
+{
+    if (wireFormat() == WireFormat::Binary) {
+        NetworkIoWorker::appendBinaryFrame(out, message.toBinary(), m_worker->isCompressionEnabled());
+    } else {
+        out.append(message.toText());
+        out.append('\n');
+    }
+}
+
+void NetworkManager::writeFrame(const NetMessage &message)
+{
+    // 直接写入，不经过发送队列，只用于恢复会话、心跳等连接控制消息
+    QByteArray data;
+    appendFrame(data, message);
+    m_worker->writeBatch(data, QList<NetworkIoWorker::Delivery>());
+}
+
+void NetworkManager::scheduleFlush()
+{
+    // 同一轮事件循环中发送的消息在下一轮合并写入
+    if (m_flushScheduled) {
+        return;
+    }
+    m_flushScheduled = true;
+    QMetaObject::invokeMethod(this, &NetworkManager::sendQueuedMessages, Qt::QueuedConnection);
+}
+
+void NetworkManager::sendQueuedMessages()
+{
+    m_flushScheduled = false;
+    
+    // 断线和协商期间保留队列，连接可用后再发送
+    if (!m_isConnected || m_negotiating) {
         return;
     }
     
-    m_socket->flush();
-    qDebug() << "Message sent:" << message->toString();
-    emit messageSent(message);
+    QByteArray batch;
+    QList<NetworkIoWorker::Delivery> deliveries;
+    QList<QueuedMessage> written;
+    bool remaining = false;
+    {
+        QMutexLocker locker(&m_sendMutex);
+        // 未发出的数据超过高水位时暂停，等I/O线程通知缓冲区有空间后继续
+        qint64 budget = m_sendHighWaterMark - m_worker->queuedBytes();
+        while (!m_sendQueue.isEmpty() && batch.size() < budget) {
+            QueuedMessage queued = m_sendQueue.dequeue();
+            appendFrame(batch, queued.message);
+            if (queued.callback) {
+                quint64 ticket = m_nextDeliveryTicket++;
+                m_deliveryCallbacks.insert(ticket, queued.callback);
+                deliveries.append(NetworkIoWorker::Delivery{batch.size(), ticket});
+            }
+            written.append(std::move(queued));
+        }
+        remaining = !m_sendQueue.isEmpty();
+    }
+    
+    if (!batch.isEmpty()) {
+        m_worker->writeBatch(batch, deliveries);
+        for (const QueuedMessage &queued : std::as_const(written)) {
+            emit messageSent(queued.message);
+        }
+    }
+    
+    // 计算预算后I/O线程可能已发出部分数据，没有越过高水位就不会再收到通知
+    if (remaining && m_worker->queuedBytes() < m_sendHighWaterMark) {
+        scheduleFlush();
+    }
 }
 
-void NetworkManager::sendMessage(MessageType type, const QVariantMap &data)
+void NetworkManager::failQueuedMessages()
+{
+    QQueue<QueuedMessage> queue;
+    {
+        QMutexLocker locker(&m_sendMutex);
+        queue.swap(m_sendQueue);
+    }
+    
+    for (const QueuedMessage &queued : std::as_const(queue)) {
+        if (queued.callback) {
+            queued.callback(false);
+        }
+    }
+}
+
+void NetworkManager::onDeliveriesFinished(const QList<quint64> &tickets, bool delivered)
 {
-    auto message = std::make_unique<Message>(type, data, this);
-    sendMessage(message.get());
+    for (quint64 ticket : tickets) {
+        DeliveryCallback callback = m_deliveryCallbacks.take(ticket);
+        if (callback) {
+            callback(delivered);
+        }
+    }
 }
 
 void NetworkManager::startHeartbeat(int intervalMs)
@@ -148,22 +411,136 @@ void NetworkManager::startHeartbeat(int intervalMs)
         m_heartbeatTimer->stop();
     }
     
-    m_heartbeatTimer->setInterval(intervalMs);
+    m_heartbeatBaseIntervalMs = qMax(kMinHeartbeatIntervalMs, intervalMs);
+    m_outstandingHeartbeat = 0;
+    m_missedHeartbeats = 0;
+    updateHeartbeatInterval();
     m_heartbeatTimer->start();
-    qDebug() << "Heartbeat started with interval:" << intervalMs << "ms";
+    qDebug() << "Heartbeat started with interval:" << m_heartbeatTimer->interval() << "ms";
 }
 
 void NetworkManager::stopHeartbeat()
 {
+    m_heartbeatTimeoutTimer->stop();
+    m_outstandingHeartbeat = 0;
     if (m_heartbeatTimer->isActive()) {
         m_heartbeatTimer->stop();
         qDebug() << "Heartbeat stopped";
     }
 }
 
-void NetworkManager::onSocketConnected()
+void NetworkManager::updateHeartbeatInterval()
+{
+    int interval = m_heartbeatBaseIntervalMs;
+    if (!m_appActive) {
+        // 后台时只需维持连接，放慢心跳以节省电量和流量
+        interval = qMax(interval, qMin(interval * kIdleHeartbeatFactor, kMaxHeartbeatIntervalMs));
+    } else if (m_missedHeartbeats > 0 || (m_srtt >= 0 && m_rttVar * 2 > m_srtt)) {
+        // 网络不稳定时加快心跳，尽早发现断线
+        interval = qMax(kMinHeartbeatIntervalMs, interval / 2);
+    }
+    
+    if (m_heartbeatTimer->interval() != interval) {
+        // 修改运行中定时器的间隔会重新计时
+        m_heartbeatTimer->setInterval(interval);
+    }
+}
+
+int NetworkManager::heartbeatTimeoutMs() const
+{
+    // 与TCP重传超时相同的估算方式，还没有测量结果时使用上限
+    if (m_srtt < 0) {
+        return kMaxHeartbeatTimeoutMs;
+    }
+    return qBound(kMinHeartbeatTimeoutMs, m_srtt + 4 * m_rttVar, kMaxHeartbeatTimeoutMs);
+}
+
+void NetworkManager::resetRtt()
+{
+    if (m_srtt >= 0) {
+        m_srtt = -1;
+        m_rttVar = -1;
+        emit rttChanged();
+    }
+}
+
+void NetworkManager::handleHeartbeatResponse(const NetMessage &message)
+{
+    // 迟到的响应只说明连接仍然有效，不用于计算往返时间
+    QString seq = message.string("seq");
+    if (m_outstandingHeartbeat == 0 || (!seq.isEmpty() && seq.toUInt() != m_outstandingHeartbeat)) {
+        return;
+    }
+    
+    m_heartbeatTimeoutTimer->stop();
+    m_outstandingHeartbeat = 0;
+    
+    int sample = static_cast<int>(m_clock.elapsed() - m_heartbeatSentAt);
+    if (m_srtt < 0) {
+        m_srtt = sample;
+        m_rttVar = sample / 2;
+    } else {
+        m_rttVar = (3 * m_rttVar + qAbs(m_srtt - sample)) / 4;
+        m_srtt = (7 * m_srtt + sample) / 8;
+    }
+    emit rttChanged();
+    updateHeartbeatInterval();
+}
+
+void NetworkManager::onHeartbeatTimeout()
+{
+    if (!m_isConnected || m_outstandingHeartbeat == 0) {
+        return;
+    }
+    
+    ++m_missedHeartbeats;
+    m_outstandingHeartbeat = 0;
+    qWarning() << "Heartbeat timed out, missed:" << m_missedHeartbeats;
+    
+    // 半开连接不会报错，连续超时时主动断开，由断线处理安排重连
+    if (m_missedHeartbeats >= kMaxMissedHeartbeats) {
+        qWarning() << "Connection appears dead, reconnecting";
+        stopHeartbeat();
+        NetworkIoWorker *worker = m_worker;
+        postToWorker([worker]() {
+            worker->abortConnection();
+        });
+        return;
+    }
+    
+    // 不等下一个周期，立即再探测一次
+    updateHeartbeatInterval();
+    sendHeartbeat();
+}
+
+void NetworkManager::onApplicationStateChanged(Qt::ApplicationState state)
+{
+    bool active = state == Qt::ApplicationActive;
+    if (m_appActive == active) {
+        return;
+    }
+    
+    m_appActive = active;
+    if (m_heartbeatTimer->isActive()) {
+        updateHeartbeatInterval();
+    }
+    // 回到前台时立即确认连接状态
+    if (active && m_isConnected) {
+        sendHeartbeat();
+    }
+}
+
+void NetworkManager::onWorkerConnected()
 {
     m_isConnected = true;
+    m_connecting = false;
+    bool wasReconnecting = m_reconnectAttempt > 0;
+    m_reconnectAttempt = 0;
+
+    // I/O线程已发出协商请求，先进入协商状态再分发已排队的消息，
+    // 队列中可能已有协商响应
+    startNegotiation();
+    dispatchInbound(-1);
     
     // 计算连接时间
     if (m_connectionStartTime > 0) {
@@ -175,95 +552,394 @@ void NetworkManager::onSocketConnected()
         qDebug() << "Connected to server";
     }
     
-    // 清空消息缓冲
-    m_messageBuffer.clear();
-    
     emit connectedChanged();
     emit connected();
+    if (wasReconnecting) {
+        qDebug() << "Reconnected to server";
+        emit reconnectingChanged();
+        emit reconnected();
+    }
     
-    // 开始心跳
-    startHeartbeat();
+    // 开始心跳，保留调用方设置的基准间隔
+    startHeartbeat(m_heartbeatBaseIntervalMs);
 }
 
-void NetworkManager::onSocketDisconnected()
+void NetworkManager::onWorkerDisconnected()
 {
+    // 断开前收到的消息先分发，其中可能有等待中的响应
+    dispatchInbound(-1);
+    
     m_isConnected = false;
+    m_connecting = false;
     qDebug() << "Disconnected from server";
     
     stopHeartbeat();
+    m_negotiationTimer->stop();
+    m_negotiating = false;
+    m_resuming = false;
+    m_missedHeartbeats = 0;
+    resetRtt();
+    failPendingRequests("连接已断开");
+    
+    // 先安排重连，disconnected的处理方可以据此判断是否保留登录状态
+    scheduleReconnect();
     
     emit connectedChanged();
     emit disconnected();
 }
 
-void NetworkManager::onSocketError(QAbstractSocket::SocketError error)
+void NetworkManager::onWorkerError(const QString &error, bool unconnected)
 {
-    Q_UNUSED(error)
-    QString errorString = m_socket->errorString();
-    qWarning() << "Socket error:" << errorString;
+    qWarning() << "Socket error:" << error;
     
     m_isConnected = false;
+    
+    // 连接失败时不会收到disconnected，在这里安排下一次重连
+    if (unconnected) {
+        m_connecting = false;
+        scheduleReconnect();
+    }
+    
     emit connectedChanged();
-    emit connectionError(errorString);
+    emit connectionError(error);
 }
 
-void NetworkManager::onSocketReadyRead()
+void NetworkManager::scheduleDrain()
 {
-    QByteArray data = m_socket->readAll();
-    QString receivedData = QString::fromUtf8(data);
-    
-    // 将接收到的数据添加到缓冲区
-    m_messageBuffer += receivedData;
+    if (m_drainTimer->isActive()) {
+        return;
+    }
     
-    // 处理完整的消息（以换行符分隔）
-    processReceivedData(m_messageBuffer);
+    // 距上次分发不足一帧时等到下一帧，空闲后的第一条消息立即分发
+    qint64 delay = qMax<qint64>(0, kFrameIntervalMs - m_lastDrain.elapsed());
+    m_drainTimer->start(static_cast<int>(delay));
 }
 
-void NetworkManager::processReceivedData(const QString &data)
+void NetworkManager::drainInbound()
 {
-    QStringList messages = data.split('\n', Qt::KeepEmptyParts);
+    dispatchInbound(kDrainBudgetMs);
+}
+
+void NetworkManager::dispatchInbound(qint64 budgetMs)
+{
+    m_lastDrain.restart();
+    // 先清除通知标记，分发期间到达的消息会再次通知
+    m_worker->clearWakeup();
     
-    // 最后一个元素可能是不完整的消息，保留在缓冲区
-    if (!messages.isEmpty()) {
-        m_messageBuffer = messages.takeLast();
-        
-        // 处理完整的消息
-        for (const QString &messageString : messages) {
-            if (!messageString.trimmed().isEmpty()) {
-                processMessage(messageString.trimmed());
-            }
+    NetMessage message;
+    int dispatched = 0;
+    while (m_inbound.pop(&message)) {
+        processMessage(message);
+        // 每分发一批检查一次耗时，超出预算时剩余消息留到下一帧
+        if (budgetMs >= 0 && ++dispatched % 16 == 0 && m_lastDrain.elapsed() >= budgetMs) {
+            break;
         }
     }
+    message = NetMessage();
+    
+    // 队列腾出空间后让I/O线程继续读取
+    if (m_worker->isReadingStalled()) {
+        NetworkIoWorker *worker = m_worker;
+        postToWorker([worker]() {
+            worker->resumeReading();
+        });
+    }
+    if (!m_inbound.isEmpty()) {
+        scheduleDrain();
+    }
+}
+
+void NetworkManager::processMessage(const NetMessage &message)
+{
+    // 收到任何数据都说明连接有效
+    m_missedHeartbeats = 0;
+    
+    if (handleControlMessage(message) || completeRequest(message)) {
+        return;
+    }
     
-    // 如果缓冲区中的消息看起来是完整的（包含冒号且没有换行符），立即处理
-    if (!m_messageBuffer.isEmpty() && m_messageBuffer.contains(':') && !m_messageBuffer.contains('\n')) {
-        // 检查是否像一个完整的消息（数字:内容格式）
-        QRegularExpression messagePattern("^\\d+:");
-        if (messagePattern.match(m_messageBuffer).hasMatch()) {
-            processMessage(m_messageBuffer.trimmed());
-            m_messageBuffer.clear();
+    // 记录最后收到的聊天消息，恢复会话时只请求之后的消息
+    if (message.type() == MessageType::PRIVATE_CHAT || message.type() == MessageType::GROUP_CHAT) {
+        QString messageId = message.string("messageId");
+        if (!messageId.isEmpty()) {
+            m_lastMessageId = messageId;
         }
     }
+    
+    // 按类型交给唯一的订阅方，没有订阅方的消息才广播
+    if (m_dispatcher.dispatch(message)) {
+        return;
+    }
+    emit messageReceived(message);
+    
+    static const QMetaMethod objectSignal = QMetaMethod::fromSignal(&NetworkManager::messageObjectReceived);
+    if (isSignalConnected(objectSignal)) {
+        Message *object = new Message(message, this);
+        emit messageObjectReceived(object);
+        object->deleteLater();
+    }
+}
+
+void NetworkManager::startNegotiation()
+{
+    m_negotiating = true;
+    m_negotiationTimer->start();
 }
 
-void NetworkManager::processMessage(const QString &messageString)
+void NetworkManager::finishNegotiation(WireFormat format)
 {
-    qDebug() << "Message received:" << messageString;
+    if (!m_negotiating) {
+        return;
+    }
+    
+    m_negotiating = false;
+    m_negotiationTimer->stop();
+    qDebug() << "Wire format:" << (format == WireFormat::Binary ? "binary" : "text");
+    
+    // 有会话令牌时先恢复会话，队列中的消息要在认证之后发送
+    if (!m_sessionToken.isEmpty()) {
+        startResume();
+        return;
+    }
     
-    Message *message = Message::fromString(messageString, this);
-    if (message) {
-        emit messageReceived(message);
-        // 消息会在处理完成后由Qt的对象树自动删除
+    sendQueuedMessages();
+}
+
+void NetworkManager::startResume()
+{
+    m_resuming = true;
+    m_negotiationTimer->start();
+    
+    QVariantMap data;
+    data["userId"] = m_sessionUserId;
+    data["token"] = m_sessionToken;
+    data["lastMessageId"] = m_lastMessageId;
+    writeFrame(NetMessage(MessageType::SESSION_RESUME, data));
+    qDebug() << "Resuming session for user:" << m_sessionUserId << "after message:" << m_lastMessageId;
+}
+
+void NetworkManager::finishResume(bool resumed, const QString &reason)
+{
+    if (!m_resuming) {
+        return;
+    }
+    
+    m_resuming = false;
+    m_negotiationTimer->stop();
+    
+    if (resumed) {
+        qDebug() << "Session resumed";
+        emit sessionResumed();
+        sendQueuedMessages();
+        return;
+    }
+    
+    // 会话失效后队列中的消息没有认证，无法再发送
+    qWarning() << "Session resume failed:" << reason;
+    clearSession();
+    failQueuedMessages();
+    emit sessionResumeFailed(reason);
+}
+
+bool NetworkManager::handleControlMessage(const NetMessage &message)
+{
+    if (message.type() == MessageType::PROTOCOL_NEGOTIATE_RESPONSE) {
+        // I/O线程解析到这条响应时已切换接收格式，这里只结束协商
+        bool binary = message.string("format") == "binary";
+        finishNegotiation(binary ? WireFormat::Binary : WireFormat::Text);
+        return true;
+    }
+    
+    if (message.type() == MessageType::HEARTBEAT_RESPONSE) {
+        handleHeartbeatResponse(message);
+        return true;
+    }
+    
+    if (message.type() == MessageType::SESSION_RESUME_RESPONSE) {
+        finishResume(message.string("status") == "0", message.string("message"));
+        return true;
+    }
+    
+    // 旧服务器对未知请求返回不带reqId的错误，说明不支持协商；其他推送不影响协商
+    if (m_negotiating && message.type() == MessageType::ERROR && message.string("reqId").isEmpty()) {
+        finishNegotiation(WireFormat::Text);
+    } else if (m_resuming && message.type() == MessageType::ERROR) {
+        finishResume(false, message.string("message", "服务器不支持恢复会话"));
+    }
+    return false;
+}
+
+void NetworkManager::scheduleReconnect()
+{
+    if (!m_autoReconnect || m_manualDisconnect || m_reconnectTimer->isActive()) {
+        return;
+    }
+    
+    int delayMs;
+    if (m_reconnectAttempt >= kCircuitBreakerThreshold) {
+        // 熔断：连续失败过多，等待较长时间后只尝试一次，失败则继续等待
+        delayMs = kCircuitOpenMs;
+        qWarning() << "Reconnect failed" << m_reconnectAttempt << "times, pausing for" << delayMs << "ms";
     } else {
-        qWarning() << "Failed to parse message:" << messageString;
+        // 指数退避，在上限的一半到全部之间随机，避免大量客户端同时重连
+        int ceiling = qMin(kReconnectMaxDelayMs, kReconnectBaseDelayMs << m_reconnectAttempt);
+        delayMs = ceiling / 2 + QRandomGenerator::global()->bounded(ceiling / 2 + 1);
     }
+    
+    ++m_reconnectAttempt;
+    m_reconnectTimer->start(delayMs);
+    qDebug() << "Reconnect attempt" << m_reconnectAttempt << "in" << delayMs << "ms";
+    
+    emit reconnectingChanged();
+    emit reconnectScheduled(m_reconnectAttempt, delayMs);
+}
+
+void NetworkManager::attemptReconnect()
+{
+    if (m_manualDisconnect) {
+        return;
+    }
+    
+    qDebug() << "Reconnect attempt" << m_reconnectAttempt;
+    connectToServer();
+}
+
+bool NetworkManager::completeRequest(const NetMessage &message)
+{
+    auto it = m_pendingRequests.end();
+    QString requestId = message.string("reqId");
+    if (!requestId.isEmpty()) {
+        bool ok;
+        quint32 id = requestId.toUInt(&ok);
+        if (ok) {
+            it = m_pendingRequests.find(id);
+        }
+        // 已超时或已失败的请求的响应直接丢弃，不当作推送分发
+        if (it == m_pendingRequests.end()) {
+            qDebug() << "Dropping response for unknown request:" << requestId;
+            return true;
+        }
+    } else {
+        // 旧服务器不回传reqId，按发出顺序匹配
+        it = std::find_if(m_pendingRequests.begin(), m_pendingRequests.end(),
+                          [&message](const auto &entry) {
+                              return entry.second.responseType == message.type();
+                          });
+    }
+    
+    if (it == m_pendingRequests.end()) {
+        return false;
+    }
+    
+    std::shared_ptr<QPromise<NetMessage>> promise = it->second.promise;
+    m_pendingRequests.erase(it);
+    if (m_pendingRequests.empty()) {
+        m_requestTimer->stop();
+    }
+    
+    promise->addResult(message);
+    promise->finish();
+    return true;
+}
+
+void NetworkManager::expireRequests()
+{
+    qint64 now = m_clock.elapsed();
+    QList<std::shared_ptr<QPromise<NetMessage>>> expired;
+    QSet<quint32> expiredIds;
+    for (auto it = m_pendingRequests.begin(); it != m_pendingRequests.end();) {
+        if (it->second.deadline <= now) {
+            qWarning() << "Request timed out:" << it->first << messageTypeToString(it->second.responseType);
+            expired.append(it->second.promise);
+            expiredIds.insert(it->first);
+            it = m_pendingRequests.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    if (m_pendingRequests.empty()) {
+        m_requestTimer->stop();
+    }
+    removeQueuedRequests(expiredIds);
+    
+    // 先从表中移除再完成，回调中可以安全地发出新请求
+    NetMessage error = requestError("请求超时，请检查网络连接");
+    for (const auto &promise : std::as_const(expired)) {
+        promise->addResult(error);
+        promise->finish();
+    }
+}
+
+void NetworkManager::failPendingRequests(const QString &reason)
+{
+    std::map<quint32, PendingRequest> requests;
+    requests.swap(m_pendingRequests);
+    m_requestTimer->stop();
+    
+    QSet<quint32> requestIds;
+    for (const auto &entry : requests) {
+        requestIds.insert(entry.first);
+    }
+    removeQueuedRequests(requestIds);
+    
+    NetMessage error = requestError(reason);
+    for (auto &entry : requests) {
+        entry.second.promise->addResult(error);
+        entry.second.promise->finish();
+    }
+}
+
+void NetworkManager::removeQueuedRequests(const QSet<quint32> &requestIds)
+{
+    if (requestIds.isEmpty()) {
+        return;
+    }
+    
+    // 已经失败的请求不再发出，否则服务器会按过期的reqId再处理一次
+    QList<DeliveryCallback> callbacks;
+    {
+        QMutexLocker locker(&m_sendMutex);
+        m_sendQueue.removeIf([&](const QueuedMessage &queued) {
+            QString requestId = queued.message.string("reqId");
+            if (requestId.isEmpty() || !requestIds.contains(requestId.toUInt())) {
+                return false;
+            }
+            if (queued.callback) {
+                callbacks.append(queued.callback);
+            }
+            return true;
+        });
+    }
+    
+    for (const DeliveryCallback &callback : std::as_const(callbacks)) {
+        callback(false);
+    }
+}
+
+NetMessage NetworkManager::requestError(const QString &reason)
+{
+    QVariantMap data;
+    data["status"] = "-1";
+    data["message"] = reason;
+    return NetMessage(MessageType::ERROR, data);
 }
 
 void NetworkManager::sendHeartbeat()
 {
-    if (m_isConnected) {
-        QVariantMap data;
-        data["timestamp"] = QString::number(QDateTime::currentMSecsSinceEpoch());
-        sendMessage(MessageType::HEARTBEAT_REQUEST, data);
+    // 协商期间格式未定，协商结束后的下一次心跳再发
+    if (!m_isConnected || m_negotiating) {
+        return;
     }
+    
+    // 每次心跳使用新序号，服务器在响应中原样返回seq和timestamp
+    m_heartbeatSeq = m_heartbeatSeq == std::numeric_limits<quint32>::max() ? 1 : m_heartbeatSeq + 1;
+    m_outstandingHeartbeat = m_heartbeatSeq;
+    m_heartbeatSentAt = m_clock.elapsed();
+    
+    QVariantMap data;
+    data["seq"] = QString::number(m_heartbeatSeq);
+    data["timestamp"] = QString::number(QDateTime::currentMSecsSinceEpoch());
+    // 越过发送队列直接写出，往返时间不包含排队和高水位等待
+    writeFrame(NetMessage(MessageType::HEARTBEAT_REQUEST, data));
+    m_heartbeatTimeoutTimer->start(heartbeatTimeoutMs());
 }
\ No newline at end of file
@@ -0,0 +1,327 @@
+#include "include/ProtocolMessages.h"
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+namespace {
+
+template <typename Payload>
+struct FieldBinding {
+    const char *key;
+    QString Payload::*member;
+};
+
+// 遍历一次消息字段，按键名写入对应成员，键重复时以最后一个为准
+template <typename Payload, size_t N>
+Payload decodeFields(const NetMessage &message, const FieldBinding<Payload> (&bindings)[N])
+{
+    Payload payload;
+    for (qsizetype i = 0; i < message.fieldCount(); ++i) {
+        QByteArrayView key = message.keyAt(i);
+        for (const FieldBinding<Payload> &binding : bindings) {
+            if (key == QByteArrayView(binding.key)) {
+                payload.*binding.member = message.stringAt(i);
+                break;
+            }
+        }
+    }
+    return payload;
+}
+
+QJsonArray listField(const QVariant &value)
+{
+    // 二进制协议直接传输列表，文本协议中列表以JSON字符串传输
+    if (value.typeId() == QMetaType::QVariantList) {
+        return QJsonArray::fromVariantList(value.toList());
+    }
+    QJsonDocument doc = QJsonDocument::fromJson(value.toString().toUtf8());
+    return doc.isArray() ? doc.array() : QJsonArray();
+}
+
+// 服务器的用户id可能是数字或字符串
+QString idString(const QJsonValue &value)
+{
+    return value.isDouble() ? QString::number(value.toInteger()) : value.toString();
+}
+
+QVariantList userList(const QVariant &value)
+{
+    QVariantList users;
+    const QJsonArray array = listField(value);
+    users.reserve(array.size());
+    for (const auto &item : array) {
+        if (item.isObject()) {
+            QJsonObject obj = item.toObject();
+            QVariantMap userData;
+            userData["userId"] = idString(obj["id"]);
+            userData["username"] = obj["username"].toString();
+            userData["online"] = obj["online"].toBool();
+            users.append(userData);
+        }
+    }
+    return users;
+}
+
+QVariantList groupList(const QVariant &value)
+{
+    QVariantList groups;
+    const QJsonArray array = listField(value);
+    groups.reserve(array.size());
+    for (const auto &item : array) {
+        if (item.isObject()) {
+            QJsonObject obj = item.toObject();
+            QVariantMap groupData;
+            groupData["groupId"] = obj["group_id"].toString();
+            groupData["groupName"] = obj["group_name"].toString();
+            groupData["memberCount"] = obj["member_count"].toInt();
+            groups.append(groupData);
+        }
+    }
+    return groups;
+}
+
+// 增量字段：revision、delta、changed(与完整列表同格式)、removed(id列表)
+ListSyncInfo listSync(const NetMessage &message, QVariantList (*items)(const QVariant &))
+{
+    ListSyncInfo sync;
+    sync.revision = message.value("revision").toLongLong();
+    sync.isDelta = sync.revision > 0 && message.value("delta").toBool();
+    if (!sync.isDelta) {
+        return sync;
+    }
+
+    sync.changed = items(message.value("changed"));
+    const QJsonArray removed = listField(message.value("removed"));
+    sync.removed.reserve(removed.size());
+    for (const auto &id : removed) {
+        sync.removed.append(idString(id));
+    }
+    return sync;
+}
+
+QVariantList memberList(const QVariant &value)
+{
+    QVariantList members;
+    const QJsonArray array = listField(value);
+    members.reserve(array.size());
+    for (const auto &item : array) {
+        if (item.isObject()) {
+            QJsonObject obj = item.toObject();
+            QVariantMap memberData;
+            memberData["userId"] = obj["user_id"].toString();
+            memberData["username"] = obj["username"].toString();
+            memberData["role"] = obj["role"].toString();
+            members.append(memberData);
+        }
+    }
+    return members;
+}
+
+QVariantList historyList(const QVariant &value)
+{
+    QVariantList messages;
+    const QJsonArray array = listField(value);
+    messages.reserve(array.size());
+    for (const auto &item : array) {
+        if (item.isObject()) {
+            QJsonObject obj = item.toObject();
+            QVariantMap messageData;
+            messageData["messageId"] = obj["message_id"].toString();
+            messageData["fromUserId"] = obj["from_user_id"].toString();
+            messageData["fromUsername"] = obj["from_username"].toString();
+            messageData["content"] = obj["content"].toString();
+            messageData["timestamp"] = obj["timestamp"].toString();
+            messages.append(messageData);
+        }
+    }
+    return messages;
+}
+
+} // namespace
+
+LoginResponsePayload LoginResponsePayload::decode(const NetMessage &message)
+{
+    LoginResponsePayload payload;
+    for (qsizetype i = 0; i < message.fieldCount(); ++i) {
+        QByteArrayView key = message.keyAt(i);
+        if (key == "status") {
+            payload.status = message.stringAt(i);
+        } else if (key == "message") {
+            payload.message = message.stringAt(i);
+        } else if (key == "offlineMsgCount") {
+            payload.offlineMsgCount = message.stringAt(i).toInt();
+        }
+    }
+    return payload;
+}
+
+QString ErrorPayload::text() const
+{
+    if (!errorMsg.isEmpty()) {
+        return errorMsg;
+    }
+    return message.isEmpty() ? QStringLiteral("未知错误") : message;
+}
+
+ErrorPayload ErrorPayload::decode(const NetMessage &message)
+{
+    static const FieldBinding<ErrorPayload> bindings[] = {
+        {"errorMsg", &ErrorPayload::errorMsg},
+        {"message", &ErrorPayload::message},
+    };
+    return decodeFields(message, bindings);
+}
+
+PrivateChatPayload PrivateChatPayload::decode(const NetMessage &message)
+{
+    static const FieldBinding<PrivateChatPayload> bindings[] = {
+        {"fromUserId", &PrivateChatPayload::fromUserId},
+        {"fromUsername", &PrivateChatPayload::fromUsername},
+        {"content", &PrivateChatPayload::content},
+        {"messageId", &PrivateChatPayload::messageId},
+        {"timestamp", &PrivateChatPayload::timestamp},
+    };
+    return decodeFields(message, bindings);
+}
+
+GroupChatPayload GroupChatPayload::decode(const NetMessage &message)
+{
+    static const FieldBinding<GroupChatPayload> bindings[] = {
+        {"groupId", &GroupChatPayload::groupId},
+        {"fromUserId", &GroupChatPayload::fromUserId},
+        {"fromUsername", &GroupChatPayload::fromUsername},
+        {"content", &GroupChatPayload::content},
+        {"messageId", &GroupChatPayload::messageId},
+        {"timestamp", &GroupChatPayload::timestamp},
+    };
+    return decodeFields(message, bindings);
+}
+
+AddFriendResponsePayload AddFriendResponsePayload::decode(const NetMessage &message)
+{
+    static const FieldBinding<AddFriendResponsePayload> bindings[] = {
+        {"status", &AddFriendResponsePayload::status},
+        {"friendId", &AddFriendResponsePayload::friendId},
+        {"username", &AddFriendResponsePayload::username},
+        {"message", &AddFriendResponsePayload::message},
+    };
+    return decodeFields(message, bindings);
+}
+
+FriendRequestPayload FriendRequestPayload::decode(const NetMessage &message)
+{
+    static const FieldBinding<FriendRequestPayload> bindings[] = {
+        {"fromUserId", &FriendRequestPayload::fromUserId},
+        {"fromUsername", &FriendRequestPayload::fromUsername},
+    };
+    return decodeFields(message, bindings);
+}
+
+FriendAcceptedPayload FriendAcceptedPayload::decode(const NetMessage &message)
+{
+    static const FieldBinding<FriendAcceptedPayload> bindings[] = {
+        {"userId", &FriendAcceptedPayload::userId},
+        {"username", &FriendAcceptedPayload::username},
+    };
+    return decodeFields(message, bindings);
+}
+
+FriendRejectedPayload FriendRejectedPayload::decode(const NetMessage &message)
+{
+    return FriendRejectedPayload{message.string("userId")};
+}
+
+FriendListPayload FriendListPayload::decode(const NetMessage &message)
+{
+    ListSyncInfo sync = listSync(message, userList);
+    return FriendListPayload{sync.isDelta ? QVariantList() : userList(message.value("friends")), sync};
+}
+
+UserListPayload UserListPayload::decode(const NetMessage &message)
+{
+    ListSyncInfo sync = listSync(message, userList);
+    return UserListPayload{sync.isDelta ? QVariantList() : userList(message.value("users")), sync};
+}
+
+UserSearchPayload UserSearchPayload::decode(const NetMessage &message)
+{
+    UserSearchPayload payload;
+    payload.prefix = message.string("prefix");
+    payload.users = userList(message.value("users"));
+    payload.nextCursor = message.string("nextCursor");
+    return payload;
+}
+
+GroupListPayload GroupListPayload::decode(const NetMessage &message)
+{
+    ListSyncInfo sync = listSync(message, groupList);
+    return GroupListPayload{sync.isDelta ? QVariantList() : groupList(message.value("groups")), sync};
+}
+
+GroupCreatedPayload GroupCreatedPayload::decode(const NetMessage &message)
+{
+    static const FieldBinding<GroupCreatedPayload> bindings[] = {
+        {"groupId", &GroupCreatedPayload::groupId},
+        {"groupName", &GroupCreatedPayload::groupName},
+    };
+    return decodeFields(message, bindings);
+}
+
+GroupJoinedPayload GroupJoinedPayload::decode(const NetMessage &message)
+{
+    static const FieldBinding<GroupJoinedPayload> bindings[] = {
+        {"groupId", &GroupJoinedPayload::groupId},
+        {"groupName", &GroupJoinedPayload::groupName},
+    };
+    return decodeFields(message, bindings);
+}
+
+GroupLeftPayload GroupLeftPayload::decode(const NetMessage &message)
+{
+    return GroupLeftPayload{message.string("groupId")};
+}
+
+GroupMembersPayload GroupMembersPayload::decode(const NetMessage &message)
+{
+    GroupMembersPayload payload;
+    for (qsizetype i = 0; i < message.fieldCount(); ++i) {
+        QByteArrayView key = message.keyAt(i);
+        if (key == "groupId") {
+            payload.groupId = message.stringAt(i);
+        } else if (key == "members") {
+            payload.members = memberList(message.valueAt(i));
+        }
+    }
+    return payload;
+}
+
+ChatHistoryPayload ChatHistoryPayload::decode(const NetMessage &message)
+{
+    ChatHistoryPayload payload;
+    for (qsizetype i = 0; i < message.fieldCount(); ++i) {
+        QByteArrayView key = message.keyAt(i);
+        if (key == "type") {
+            payload.type = message.stringAt(i);
+        } else if (key == "targetId") {
+            payload.targetId = message.stringAt(i);
+        } else if (key == "messages") {
+            payload.messages = historyList(message.valueAt(i));
+        }
+    }
+    return payload;
+}
+
+MessageRecalledPayload MessageRecalledPayload::decode(const NetMessage &message)
+{
+    static const FieldBinding<MessageRecalledPayload> bindings[] = {
+        {"messageId", &MessageRecalledPayload::messageId},
+        {"type", &MessageRecalledPayload::type},
+        {"targetId", &MessageRecalledPayload::targetId},
+    };
+    return decodeFields(message, bindings);
+}
+
+MessageReadPayload MessageReadPayload::decode(const NetMessage &message)
+{
+    return MessageReadPayload{message.string("messageId")};
+}
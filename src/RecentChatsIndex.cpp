@@ -0,0 +1,134 @@
+#include "include/RecentChatsIndex.h"
+#include <QJsonObject>
+
+RecentChatsIndex::RecentChatsIndex(int maxChats)
+    : m_maxChats(qMax(1, maxChats))
+    , m_totalUnread(0)
+{
+}
+
+const RecentChatsIndex::Entry &RecentChatsIndex::touch(const QString &chatId, bool isGroup, const QString &chatName,
+                                                       const QString &lastMessage, qint64 time, bool unread)
+{
+    QString chatKey = key(chatId, isGroup);
+    auto it = m_positions.find(chatKey);
+    if (it == m_positions.end()) {
+        m_entries.push_front(Entry());
+        it = m_positions.insert(chatKey, m_entries.begin());
+    } else {
+        m_entries.splice(m_entries.begin(), m_entries, it.value());
+    }
+
+    Entry &entry = *it.value();
+    entry.chatId = chatId;
+    entry.chatName = chatName;
+    entry.lastMessage = lastMessage;
+    entry.lastMessageTime = time;
+    entry.isGroup = isGroup;
+    if (unread) {
+        ++entry.unreadCount;
+        ++m_totalUnread;
+    }
+
+    trim();
+    return entry;
+}
+
+bool RecentChatsIndex::markAllRead(const QString &chatId, bool isGroup)
+{
+    auto it = m_positions.constFind(key(chatId, isGroup));
+    if (it == m_positions.constEnd() || it.value()->unreadCount == 0) {
+        return false;
+    }
+    m_totalUnread -= it.value()->unreadCount;
+    it.value()->unreadCount = 0;
+    return true;
+}
+
+int RecentChatsIndex::unreadCount(const QString &chatId, bool isGroup) const
+{
+    auto it = m_positions.constFind(key(chatId, isGroup));
+    return it != m_positions.constEnd() ? it.value()->unreadCount : 0;
+}
+
+void RecentChatsIndex::remove(const QString &chatId, bool isGroup)
+{
+    auto it = m_positions.find(key(chatId, isGroup));
+    if (it == m_positions.end()) {
+        return;
+    }
+    m_totalUnread -= it.value()->unreadCount;
+    m_entries.erase(it.value());
+    m_positions.erase(it);
+}
+
+void RecentChatsIndex::clear()
+{
+    m_entries.clear();
+    m_positions.clear();
+    m_totalUnread = 0;
+}
+
+QJsonArray RecentChatsIndex::toJson(int count) const
+{
+    QJsonArray chats;
+    for (const Entry &entry : m_entries) {
+        if (count >= 0 && chats.size() >= count) {
+            break;
+        }
+
+        QJsonObject chatObj;
+        chatObj["chatId"] = entry.chatId;
+        chatObj["chatName"] = entry.chatName;
+        chatObj["lastMessage"] = entry.lastMessage;
+        chatObj["lastMessageTime"] = entry.lastMessageTime;
+        chatObj["isGroup"] = entry.isGroup;
+        chatObj["unreadCount"] = entry.unreadCount;
+        chats.append(chatObj);
+    }
+    return chats;
+}
+
+void RecentChatsIndex::merge(const QJsonArray &chats)
+{
+    // 磁盘上的会话都比本次运行中更新过的旧，按原顺序接在末尾
+    for (const auto &value : chats) {
+        QJsonObject chatObj = value.toObject();
+        QString chatId = chatObj.value("chatId").toString();
+        bool isGroup = chatObj.value("isGroup").toBool();
+        QString chatKey = key(chatId, isGroup);
+        if (chatId.isEmpty() || m_positions.contains(chatKey)) {
+            continue;
+        }
+
+        Entry entry;
+        entry.chatId = chatId;
+        entry.chatName = chatObj.value("chatName").toString();
+        entry.lastMessage = chatObj.value("lastMessage").toString();
+        entry.lastMessageTime = chatObj.value("lastMessageTime").toInteger();
+        entry.isGroup = isGroup;
+        entry.unreadCount = qMax(0, chatObj.value("unreadCount").toInt());
+        m_totalUnread += entry.unreadCount;
+
+        m_entries.push_back(entry);
+        m_positions.insert(chatKey, std::prev(m_entries.end()));
+    }
+    trim();
+}
+
+// 私有方法实现
+
+QString RecentChatsIndex::key(const QString &chatId, bool isGroup)
+{
+    return (isGroup ? QStringLiteral("group:") : QStringLiteral("private:")) + chatId;
+}
+
+void RecentChatsIndex::trim()
+{
+    while (static_cast<int>(m_entries.size()) > m_maxChats) {
+        const Entry &oldest = m_entries.back();
+        m_totalUnread -= oldest.unreadCount;
+        m_positions.remove(key(oldest.chatId, oldest.isGroup));
+        m_entries.pop_back();
+    }
+}
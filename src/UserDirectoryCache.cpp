@@ -0,0 +1,94 @@
+#include "include/UserDirectoryCache.h"
+#include <algorithm>
+
+UserDirectoryCache::UserDirectoryCache(int maxEntries)
+    : m_maxEntries(maxEntries)
+{
+}
+
+QString UserDirectoryCache::sortKey(const QVariantMap &user)
+{
+    return user.value("username").toString().toLower() + QChar(0x1f) + user.value("userId").toString();
+}
+
+qsizetype UserDirectoryCache::lowerBound(const QString &key) const
+{
+    auto it = std::lower_bound(m_entries.cbegin(), m_entries.cend(), key,
+                               [](const Entry &entry, const QString &value) { return entry.key < value; });
+    return it - m_entries.cbegin();
+}
+
+void UserDirectoryCache::insert(const QVariantList &users)
+{
+    // 超出上限时整体丢弃，之后按需重新从服务器取
+    if (m_entries.size() + users.size() > m_maxEntries) {
+        clear();
+    }
+
+    for (const QVariant &value : users) {
+        QVariantMap user = value.toMap();
+        QString userId = user.value("userId").toString();
+        if (userId.isEmpty()) {
+            continue;
+        }
+
+        QString key = sortKey(user);
+        auto existing = m_keysByUserId.constFind(userId);
+        if (existing != m_keysByUserId.cend()) {
+            qsizetype row = lowerBound(existing.value());
+            if (existing.value() == key) {
+                m_entries[row].user = std::move(user);
+                continue;
+            }
+            // 用户名变化，旧位置失效，之前完整的前缀也不再可靠
+            m_entries.remove(row);
+            m_completePrefixes.clear();
+        }
+
+        m_entries.insert(lowerBound(key), Entry{key, std::move(user)});
+        m_keysByUserId.insert(userId, key);
+    }
+}
+
+QVariantList UserDirectoryCache::search(const QString &prefix, int limit, const QString &after) const
+{
+    QVariantList result;
+    const QString lowerPrefix = prefix.toLower();
+
+    qsizetype row = lowerBound(after.isEmpty() ? lowerPrefix : std::max(after, lowerPrefix));
+    if (!after.isEmpty() && row < m_entries.size() && m_entries[row].key == after) {
+        ++row;
+    }
+
+    for (; row < m_entries.size() && result.size() < limit; ++row) {
+        if (!m_entries[row].key.startsWith(lowerPrefix)) {
+            break;
+        }
+        result.append(m_entries[row].user);
+    }
+    return result;
+}
+
+void UserDirectoryCache::markComplete(const QString &prefix)
+{
+    m_completePrefixes.insert(prefix.toLower());
+}
+
+bool UserDirectoryCache::isComplete(const QString &prefix) const
+{
+    // 较短前缀的结果完整时，其延长前缀的结果必然也完整
+    const QString lowerPrefix = prefix.toLower();
+    for (qsizetype length = lowerPrefix.size(); length >= 0; --length) {
+        if (m_completePrefixes.contains(lowerPrefix.left(length))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void UserDirectoryCache::clear()
+{
+    m_entries.clear();
+    m_keysByUserId.clear();
+    m_completePrefixes.clear();
+}